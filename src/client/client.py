@@ -33,6 +33,18 @@ import logging
 import struct
 import random
 import time
+import zlib
+import hashlib
+import mmap
+
+try:
+	# zstd is optional, zlib is used when it is not available
+	import zstandard
+except ImportError:
+	zstandard = None
+
+# wait for the reply without a timeout, as the server does for the requests with a timeout of 0
+FOREVER = -1
 
 class SLIP():
 	"""
@@ -115,6 +127,111 @@ class SLIP():
 
 		return slip
 
+class Journal():
+	"""
+	Reader of the files of recorded events written by the server, see
+	isabelJournal.h for the format. The file is mapped in memory and the
+	events are decoded one at a time, as they are iterated.
+	"""
+
+	MAGIC = b'ISABELEV'
+
+	def __init__(self,file_name):
+		"""
+		Map the file in memory.
+
+		@file_name 	the file written by the server
+
+		Raises IOError if the file cannot be read, or is not a file of events.
+		"""
+		self.file = open(file_name,'rb')
+		self.data = mmap.mmap(self.file.fileno(),0,access=mmap.ACCESS_READ)
+
+		if len(self.data) < 9 or self.data[0:8] != Journal.MAGIC or struct.unpack_from('B',self.data,8)[0] not in [1,2]:
+			self.close()
+			raise IOError('not a file of recorded events: ' + file_name)
+
+		# the first version has the time in milliseconds, and no jitter
+		self.version = struct.unpack_from('B',self.data,8)[0]
+
+	def close(self):
+		"""
+		Unmap the file.
+		"""
+		self.data.close()
+		self.file.close()
+
+	def varint(self,position):
+		"""
+		Decode a varint.
+
+		@position 	offset of the varint in the file
+
+		#returns tuple (value,position after the varint)
+		"""
+		value = 0
+		shift = 0
+		while True:
+			byte      = struct.unpack_from('B',self.data,position)[0]
+			value    |= (byte & 0x7F) << shift
+			position += 1
+			shift    += 7
+			if 0 == (byte & 0x80):
+				return (value,position)
+
+	def events(self):
+		"""
+		Iterate over the recorded events. A file cut short ends at its last
+		whole event.
+
+		#returns a generator of UserEvent
+		"""
+		position = 9
+		instant  = 0
+		names    = []
+
+		while position < len(self.data):
+			try:
+				header = struct.unpack_from('B',self.data,position)[0]
+				event  = protocol_pb2.UserEvent()
+				event.type = header & 0x07
+
+				(delta,position) = self.varint(position + 1)
+				instant += delta*1000 if 1 == self.version else delta
+				event.instant    = instant//1000
+				event.instant_us = instant
+
+				if header & 0x20:
+					(jitter,position) = self.varint(position)
+					event.jitter = (jitter >> 1) ^ -(jitter & 1)
+
+				if event.type in [protocol_pb2.UserEvent.MOUSE_MOVE_REL,protocol_pb2.UserEvent.MOUSE_MOVE_ABS]:
+					(x,position) = self.varint(position)
+					(y,position) = self.varint(position)
+					event.xpos = (x >> 1) ^ -(x & 1)
+					event.ypos = (y >> 1) ^ -(y & 1)
+				elif protocol_pb2.UserEvent.MOUSE_BUTTON == event.type:
+					(event.button,position) = self.varint(position)
+					event.press = (0 != (header & 0x08))
+				else:
+					if header & 0x10:
+						# a new key name, added to the dictionary
+						(length,position) = self.varint(position)
+						if position + length > len(self.data):
+							return
+						names.append(self.data[position:position + length].decode('utf-8'))
+						position += length
+						index = len(names) - 1
+					else:
+						(index,position) = self.varint(position)
+					event.key   = names[index]
+					event.press = (0 != (header & 0x08))
+			except (struct.error,IndexError):
+				# the last event was cut short
+				return
+
+			yield event
+
 class Client():
 	"""
 	Implementation of the client to the Isabel server
@@ -124,16 +241,35 @@ class Client():
 		"""
 		Definition of the class properties
 		"""
-		self.sock = None
-		self.slip = SLIP()
+		self.sock 	 = None
+		self.slip 	 = SLIP()
+		self.timeout = 0.5
+		self.rx 	 = bytearray()
+
+		# sequence of the last request sent, the server echoes it in each of the responses
+		self.sequence = 0
+
+		# sequence of the request that started the capture, echoed in each of the frames
+		self.capture_sequence = 0
+
+		# compression of the responses, None until negotiated with the server
+		self.compression = None
+
+		# byte count of the responses, before and after compression
+		self.bytes_raw 		= 0
+		self.bytes_received = 0
+
+		# files of the images stored on the server, by key, to upload them again if needed
+		self.images = {}
 	
-	def connect(self,host,port=4242,timeout=0.5):
+	def connect(self,host,port=4242,timeout=0.5,compression=True):
 		"""
 		Connect to the Isabel server on the given address.
 
 		@host   	address where the server is running
 		@port   	port number where the server is listening
 		@timeout 	how long to wait for a reply from the server, in seconds
+		@compression if True, ask the server to compress the large responses
 
 		#returns True if successfull, False otherwise
 		"""
@@ -145,7 +281,15 @@ class Client():
 			logging.info('[Client] connecting to server at (%s,%d)' %(host,port))
 			self.sock = socket.create_connection((host,port))
 			self.sock.settimeout(timeout)
+			self.timeout = timeout
+			self.rx 	 = bytearray()
+			self.compression = None
 			logging.info('[Client] connected to server')
+
+			if compression:
+				# older servers do not compress, which is not an error
+				self.negotiate()
+
 			return True
 		except socket.error as e:
 			logging.error('[Client] failed to connected: %s' % str(e))
@@ -174,58 +318,235 @@ class Client():
 		else:
 			logging.warn('[Client] not connected to the server')
 
-	def send(self,req):
+	def negotiate(self,threshold=1024):
+		"""
+		Ask the server to compress the responses sent on this connection.
+
+		@threshold  responses smaller than this, in bytes, are not compressed
+
+		#returns True if successfull, False otherwise
+		"""
+		methods = [protocol_pb2.Compressed.ZLIB]
+		if zstandard:
+			methods.insert(0,protocol_pb2.Compressed.ZSTD)
+
+		request = protocol_pb2.Request()
+		request.type 	  = protocol_pb2.Request.NEGOTIATE
+		request.threshold = threshold
+		request.compression.extend(methods)
+
+		# the reply to the negotiation itself is never compressed
+		self.compression = None
+		response = self.send(request)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.warning('[Client] the server does not support compression')
+			return False
+		else:
+			self.compression = response.compression
+			return True
+
+	def compression_ratio(self):
+		"""
+		Return how much the responses were compressed, so far.
+
+		#returns the ratio between the size of the responses and the bytes received
+		"""
+		if 0 == self.bytes_received:
+			return 1.0
+		else:
+			return float(self.bytes_raw)/self.bytes_received
+
+	def reply_timeout(self,timeout):
+		"""
+		Return how long to wait for the reply to a request that waits on the server.
+
+		@timeout 	how long the server waits, in seconds, 0 waits forever
+
+		#returns the time to wait, with some slack for the server to reply, or FOREVER
+		"""
+		if timeout:
+			return timeout + self.timeout
+		else:
+			return FOREVER
+
+	def send(self,req,timeout=None):
 		"""
 		Send the request to the server and wait for the reply.
 
-		@req 	protobuf Request object with the request
+		@req 		protobuf Request object with the request
+		@timeout 	how long to wait for the reply, in seconds, None for the connection default,
+					FOREVER to wait without a timeout
 
 		#returns reply from the server, as a protobuf Response, or None in case of error
+
+		If the server streams the reply in several responses, these are merged
+		into a single one. 
+		"""
+		responses = self.send_stream(req,timeout)
+		if not responses:
+			return None
+		else:
+			response = responses[0]
+			for chunk in responses[1:]:
+				response.MergeFrom(chunk)
+
+			return response
+
+	def send_stream(self,req,timeout=None,earlier=None):
+		"""
+		Send the request to the server and wait for all of the responses.
+
+		@req 		protobuf Request object with the request
+		@timeout 	how long to wait for each response, in seconds, None for the connection default,
+					FOREVER to wait without a timeout
+		@earlier 	sequence of an earlier request, whose responses still to come are also returned
+
+		#returns list with the protobuf Responses sent by the server, empty in case of error
 		"""
 		logging.info('[Client] sending request to the server')
 		if not self.sock:
 			logging.warn('[Client] not connected !')
-			return None
+			return []
 
 		try:
 			# encode the request using SLIP, then send it
-			message = self.slip.encode(bytearray(req.SerializeToString()))
-			self.sock.send(message)
+			sequence = self.stamp(req)
+			message  = self.slip.encode(bytearray(req.SerializeToString()))
+			self.sock.sendall(message)
 
-			# wait until all data is received (a timeout occurs)
+			# the server sets the field 'more' in all but the last response
 			logging.info('[Client] wait for the server reply')
-			reply = bytearray()
-			try:
-				while True:
-					reply.extend(bytearray(self.sock.recv(4096)))
-					if 0 == len(reply):
-						logging.error('[Client] nothing received from the server')
-						return None
-					elif self.slip.SLIP_END == reply[-1]:
-						# got the full packet, no need to wait any longer 
-						break
+			responses = []
+			while True:
+				response = self.receive_reply(sequence,timeout,earlier)
+				if not response:
+					return []
 
-			except socket.timeout:
-				# ignore the timeout
-				pass
+				responses.append(response)
+				if not response.more:
+					return responses
 
-			if len(reply) <= 2:
-				# invalid or incomplete response, ignore it
-				logging.error('[Client] response is too small')
-				return None 
-			else:
-				# parse and return the response, using the protobuf encoding
-				reply = self.slip.decode(reply)
-				if 0 < len(reply):
-					response = protocol_pb2.Response()
-					response.ParseFromString(str(reply))
-					return response
-				else:
-					logging.error('[Client] SLIP decoded response is too small')
-					return None 	
 		except socket.error as e:
 			logging.error('[Client] failed to communicate with the server: %s' % str(e))
+			return []
+
+	def stamp(self,req):
+		"""
+		Number the request, so that its responses are told apart from the late ones.
+
+		@req 		protobuf Request object with the request
+
+		#returns the sequence of the request
+		"""
+		# zero is left for the requests, and servers, without a sequence
+		self.sequence = self.sequence % 0xFFFFFFFF + 1
+		req.sequence  = self.sequence
+
+		return self.sequence
+
+	def receive_reply(self,sequence,timeout=None,earlier=None):
+		"""
+		Wait for the next response to the given request, dropping the late replies to
+		the earlier requests that timed out.
+
+		@sequence 	sequence of the request
+		@timeout 	how long to wait for the response, in seconds, None for the connection default,
+					FOREVER to wait without a timeout
+		@earlier 	sequence of an earlier request, whose responses are not dropped
+
+		#returns the protobuf Response, or None in case of error
+		"""
+		while True:
+			response = self.receive(timeout)
+
+			# older servers do not echo the sequence
+			if not response or not response.HasField('sequence') or response.sequence in (sequence,earlier):
+				return response
+
+			logging.warning('[Client] dropping a late reply from the server')
+
+	def receive(self,timeout=None):
+		"""
+		Wait for the next response from the server.
+
+		@timeout 	how long to wait for the response, in seconds, None for the connection default,
+					FOREVER to wait without a timeout
+
+		#returns the protobuf Response, or None in case of error
+		"""
+		if FOREVER == timeout:
+			self.sock.settimeout(None)
+		elif timeout:
+			self.sock.settimeout(timeout)
+
+		try:
+			while True:
+				# each response is delimited by SLIP_END, discard the empty ones
+				while 0 < len(self.rx) and self.slip.SLIP_END == self.rx[0]:
+					del self.rx[0]
+
+				end = self.rx.find(bytearray([self.slip.SLIP_END]))
+				if 0 < end:
+					packet  = self.rx[:end + 1]
+					self.rx = self.rx[end + 1:]
+					break
+
+				data = self.sock.recv(65536)
+				if 0 == len(data):
+					logging.error('[Client] connection closed by the server')
+					return None
+
+				self.rx.extend(bytearray(data))
+
+		except socket.timeout:
+			logging.error('[Client] timeout while waiting for the server reply')
 			return None
+		finally:
+			self.sock.settimeout(self.timeout)
+
+		# parse and return the response, using the protobuf encoding
+		reply = self.slip.decode(bytearray([self.slip.SLIP_END]) + packet)
+		if 0 < len(reply) and None != self.compression:
+			reply = self.decompress(reply)
+
+		if 0 < len(reply):
+			response = protocol_pb2.Response()
+			response.ParseFromString(str(reply))
+			return response
+		else:
+			logging.error('[Client] SLIP decoded response is too small')
+			return None 	
+
+	def decompress(self,packet):
+		"""
+		Unwrap a compressed response.
+
+		@packet  the serialized protobuf Compressed message
+
+		#returns bytearray with the serialized Response, empty in case of error
+		"""
+		frame = protocol_pb2.Compressed()
+		frame.ParseFromString(str(packet))
+
+		if protocol_pb2.Compressed.ZLIB == frame.method:
+			# skip the length header added by qCompress
+			reply = zlib.decompress(frame.payload[4:])
+		elif protocol_pb2.Compressed.ZSTD == frame.method and zstandard:
+			reply = zstandard.ZstdDecompressor().decompress(frame.payload,max_output_size=frame.length)
+		elif protocol_pb2.Compressed.NONE == frame.method:
+			reply = frame.payload
+		else:
+			logging.error('[Client] unknown compression method: %d' % frame.method)
+			return bytearray()
+
+		self.bytes_raw 		+= frame.length
+		self.bytes_received += len(frame.payload)
+
+		if len(reply) != frame.length:
+			logging.error('[Client] the decompressed response has the wrong size')
+			return bytearray()
+		else:
+			return bytearray(reply)
 
 	def fetch_object_tree(self):
 		"""
@@ -285,15 +606,68 @@ class Client():
 		else:
 			return True
 
-	def start_recording_user(self):
+	def fetch_model_data(self,obj,row=0,rows=0,column=0,columns=0,roles=[]):
+		"""
+		Request the server to read the contents of an item model.
+
+		@obj  		the identifier of the model, or of a view with a model
+		@row 		first row to read
+		@rows 		number of rows to read, 0 to read until the end of the model
+		@column 	first column to read
+		@columns 	number of columns to read, 0 to read until the last one
+		@roles 		the roles to read, either as numbers or as role names
+
+		#returns list of protobuf ModelData, with consecutive rows, None in case of error
+
+		The server might return less rows than requested, in that case the
+		field next_row of the last ModelData contains the first row of the next page.
+		"""
+		request = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.FETCH_MODEL_DATA
+		request.id   = obj
+
+		request.model.row 	  = row
+		request.model.rows 	  = rows
+		request.model.column  = column
+		request.model.columns = columns
+
+		for role in roles:
+			if isinstance(role,int):
+				request.model.roles.append(role)
+			else:
+				request.model.role_names.append(role)
+
+		# each response has the model values for a slice of the rows
+		responses = self.send_stream(request)
+		if not responses or responses[-1].error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to retrieve the model data')
+			return None
+		else:
+			return [response.model for response in responses]
+
+	def start_recording_user(self,qt_events=False,max_events=100000,record_file=None,path_tolerance=0):
 		"""
 		Start to record all of the user mouse and keyboard events
 
+		@qt_events 	 if True, record the Qt events, relative to their target objects,
+					 instead of the X11 ones
+		@max_events  the events kept on the server until drained, the oldest are dropped first
+		@record_file if set, the server writes the events to this file as they happen,
+					 read it with the class Journal
+		@path_tolerance if not 0, the recorded mouse paths are simplified within this
+					 distance, in pixels, so that they are replayed with fewer moves
+
 		#returns True if successfull, False otherwise
 		"""
 		request = protocol_pb2.Request()
 		request.type = protocol_pb2.Request.RECORD_USER 
 		request.start = True
+		request.qt_events = qt_events
+		request.max_events = max_events
+		if record_file:
+			request.record_file = record_file
+		if path_tolerance:
+			request.path_tolerance = path_tolerance
 		response = self.send(request)
 		if not response or response.error != protocol_pb2.Response.NO_ERROR:
 			logging.error('[Client] failed to record the user events')
@@ -321,6 +695,183 @@ class Client():
 
 			return result
 
+	def drain_recording_user(self):
+		"""
+		Return the user events recorded so far, without stopping the recording.
+		The server frees the events once returned, so long recordings do not
+		grow without bound.
+
+		#returns tuple (events,dropped), with the events and the number of those
+		 dropped since the previous drain, None in case of error
+		"""
+		request = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.DRAIN_EVENTS
+		response = self.send(request)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to drain the user events')
+			return None
+		else:
+			return ([event for event in response.events],response.dropped)
+
+	def simulate_event(self,event):
+		"""
+		Simulate a recorded user event. The events recorded from Qt are
+		delivered straight to their target object.
+
+		@event 	the UserEvent to simulate
+
+		#returns True if successfull, False otherwise
+		"""
+		request      = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.SIMULATE_USER
+		request.user.CopyFrom(event)
+
+		response = self.send(request)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to simulate the user event')
+			return False
+		else:
+			return True
+
+	def replay(self,steps=[],speed=1.0,timeout=60.0,record_file=None):
+		"""
+		Replay a sequence of user events on the server, which injects them
+		on its own timeline, at their recorded instants.
+
+		@steps 		 list with the UserEvent to replay, and the sync points built
+					 by sync_for() and sync_idle()
+		@speed 		 the speed multiplier, 0 replays the events as fast as possible
+		@timeout 	 how long the whole replay can take, in seconds, 0 waits forever
+		@record_file if set, replay this file recorded on the server instead of the steps
+
+		#returns the ReplayReport with how accurately the events were replayed, None in case of error
+		"""
+		request = protocol_pb2.Request()
+		request.type 	= protocol_pb2.Request.REPLAY
+		request.speed 	= speed
+		request.timeout = int(timeout*1000)
+		if record_file:
+			request.record_file = record_file
+
+		for step in steps:
+			if isinstance(step,protocol_pb2.UserEvent):
+				request.steps.add().event.CopyFrom(step)
+			else:
+				request.steps.add().CopyFrom(step)
+
+		# the response is only sent once the replay is over
+		response = self.send(request,self.reply_timeout(timeout))
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to replay the user events')
+			return None
+		else:
+			return response.replay
+
+	def sync_for(self,obj,name,value,op=protocol_pb2.Condition.EQUAL,timeout=5.0):
+		"""
+		Build a sync point of a replay, which waits until a property of the
+		given object satisfies a condition.
+
+		@obj  		the identifier of the object
+		@name 		name of the property to evaluate
+		@value 		the value, JSON encoded, to compare the property against
+		@op 		how to compare the property with the value
+		@timeout 	how long to wait, in seconds
+
+		#returns the ReplayStep to add to the steps of replay()
+		"""
+		step = protocol_pb2.ReplayStep()
+		step.id 	 = obj
+		step.timeout = int(timeout*1000)
+
+		step.condition.name  = name
+		step.condition.op    = op
+		step.condition.value = value
+
+		return step
+
+	def sync_idle(self,animations=False,timeout=5.0):
+		"""
+		Build a sync point of a replay, which waits until the application
+		has handled all of the pending events.
+
+		@animations if True, also wait for the running animations to stop
+		@timeout 	how long to wait, in seconds
+
+		#returns the ReplayStep to add to the steps of replay()
+		"""
+		step = protocol_pb2.ReplayStep()
+		step.idle 		= True
+		step.animations = animations
+		step.timeout 	= int(timeout*1000)
+
+		return step
+
+	def type_text(self,text,cadence=0.03,speed=1.0,timeout=60.0):
+		"""
+		Type a text on the server, which presses and releases the key of
+		each character on its own timeline. The characters must be on the
+		keyboard layout of the X11 server.
+
+		@text 		the text to type, newlines and tabs are typed as Return and Tab
+		@cadence 	time between two characters, in seconds
+		@speed 		the speed multiplier, 0 types the text as fast as possible
+		@timeout 	how long the typing can take, in seconds, 0 waits forever
+
+		#returns the ReplayReport with how accurately the keys were typed, None in case of error
+		"""
+		request = protocol_pb2.Request()
+		request.type 	= protocol_pb2.Request.TYPE_TEXT
+		request.text 	= text
+		request.cadence = int(cadence*1000)
+		request.speed 	= speed
+		request.timeout = int(timeout*1000)
+
+		# the response is only sent once the text is typed
+		response = self.send(request,self.reply_timeout(timeout))
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to type the text')
+			return None
+		else:
+			return response.replay
+
+	def pointer_path(self,waypoints,duration=0.5,button=0,smooth=False,move_interval=0.01,speed=1.0,timeout=60.0):
+		"""
+		Move the mouse on the server through the waypoints, at a constant
+		speed, optionally holding a button to drag along the path.
+
+		@waypoints 		list with the (x,y) absolute positions to move through
+		@duration 		how long the whole path takes, in seconds
+		@button 		the mouse button held from the first waypoint to the last, 0 for none
+		@smooth 		if True, curve through the waypoints instead of joining them with straight lines
+		@move_interval 	time between two mouse moves, in seconds
+		@speed 			the speed multiplier, 0 moves the mouse as fast as possible
+		@timeout 		how long the gesture can take, in seconds, 0 waits forever
+
+		#returns the ReplayReport with how accurately the mouse was moved, None in case of error
+		"""
+		request = protocol_pb2.Request()
+		request.type 		  = protocol_pb2.Request.POINTER_PATH
+		request.duration 	  = int(duration*1000)
+		request.button 		  = button
+		request.smooth 		  = smooth
+		request.move_interval = max(1,int(move_interval*1000))
+		request.speed 		  = speed
+		request.timeout 	  = int(timeout*1000)
+
+		for x,y in waypoints:
+			point   = request.waypoints.add()
+			point.x = x
+			point.y = y
+
+		# the response is only sent once the mouse reached the last waypoint
+		response = self.send(request,self.reply_timeout(timeout))
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to move the mouse along the path')
+			return None
+		else:
+			return response.replay
+
 	def simulate_keyboard(self,key,press):
 		"""
 		Simulate a key press or release
@@ -394,18 +945,26 @@ class Client():
 		else:
 			return True
 
-	def take_screenshot(self,name,win_id=0):
+	def take_screenshot(self,name,win_id=0,encoding=None,quality=-1,region=None,obj=None):
 		"""
 		Take a screenshot and save it to the file with the given name.
 
-		@name    file name where to save the screenshot
-		@win_id  identifier of the window from where to take the screenshot
+		@name    	file name where to save the screenshot
+		@win_id  	identifier of the window from where to take the screenshot
+		@encoding 	one of protocol_pb2.Image.Encoding, None for PNG
+		@quality 	the encoding quality, from 0 to 100, or -1 for the default
+		@region 	tuple (x,y,width,height), only take the screenshot of this region
+		@obj 		identifier of the widget, window or QtQuick item to take the screenshot of
 
 		#returns True if successfull, False otherwise
 
-		The file is saved locally, on the client side, in PNG format.
+		The file is saved locally, on the client side, in PNG format unless
+		another encoding is selected. Note that RAW images are saved as they 
+		are received, as 32 bits BGRA pixels without any header.
 		If window ID is zero, then the screenshot is taken on the whole screen. Otherwise
-		it is taken from the specified window ID (which is X11 specific)
+		it is taken from the specified window ID (which is X11 specific). If the object
+		is given, the window ID is ignored. The region is relative to either the window 
+		or the object.
 		"""
 		logging.info('[Client] taking a screenshot of the whole screen')
 
@@ -413,6 +972,16 @@ class Client():
 		request.type = protocol_pb2.Request.TAKE_SCREENSHOT
 		request.id   = win_id
 
+		if obj is not None:
+			request.object = obj
+
+		if region is not None:
+			request.region.x,request.region.y,request.region.width,request.region.height = region
+
+		if encoding is not None:
+			request.format.encoding = encoding
+			request.format.quality  = quality
+
 		response = self.send(request)
 		if not response or response.error != protocol_pb2.Response.NO_ERROR:
 			logging.error('[Client] failed to take screenshot')
@@ -420,10 +989,439 @@ class Client():
 
 		# got the screenshot, save it to a file
 		with open(name,'wb') as image:
-			image.write(response.image)
+			if encoding is None:
+				image.write(response.image)
+			else:
+				image.write(response.images[0].data)
+
+		return True
+
+	def take_digest(self,win_id=0,region=None,obj=None):
+		"""
+		Take a screenshot, but only return its hashes.
+
+		@win_id  	identifier of the window from where to take the screenshot
+		@region 	tuple (x,y,width,height), only take the screenshot of this region
+		@obj 		identifier of the widget, window or QtQuick item to take the screenshot of
+
+		#returns the protobuf Digest, None in case of error
+
+		The digest has the SHA-256 of the pixels, which only matches if the screenshots 
+		are identical, and the dHash and pHash perceptual hashes, which differ in few
+		bits for screenshots that look alike. Only a few bytes are transfered.
+		"""
+		request      = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.TAKE_SCREENSHOT
+		request.id   = win_id
+		request.digest = True
+
+		if obj is not None:
+			request.object = obj
+
+		if region is not None:
+			request.region.x,request.region.y,request.region.width,request.region.height = region
+
+		response = self.send(request)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to take the digest of the screenshot')
+			return None
+
+		return response.digest
+
+	def take_screenshots(self,win_ids=[],all_screens=False,encoding=protocol_pb2.Image.PNG,quality=-1,region=None):
+		"""
+		Take the screenshots of several windows, and of all of the screens, in a single request.
+
+		@win_ids 	list with the identifiers of the X11 windows
+		@all_screens if True, also take one screenshot of each screen
+		@encoding 	one of protocol_pb2.Image.Encoding
+		@quality 	the encoding quality, from 0 to 100, or -1 for the default
+		@region 	tuple (x,y,width,height), only take this region of each window
+
+		#returns list with the protobuf Images, the screens first, None in case of error
+
+		Each image has its position on the screen, and its size. The screenshots
+		are encoded in parallel by the server. 
+		"""
+		request      = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.TAKE_SCREENSHOT
+		request.all_screens 	= all_screens
+		request.format.encoding = encoding
+		request.format.quality  = quality
+		request.windows.extend(win_ids)
+
+		if region is not None:
+			request.region.x,request.region.y,request.region.width,request.region.height = region
+
+		response = self.send(request)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to take the screenshots')
+			return None
+
+		return list(response.images)
+
+	def take_delta_screenshot(self,win_id=0,tile_size=64,key_frame=False,encoding=protocol_pb2.Image.RAW,region=None,obj=None):
+		"""
+		Take a screenshot, returning only the tiles that changed since the previous one.
+
+		@win_id  	identifier of the window from where to take the screenshot
+		@tile_size 	the screenshot is split in square tiles of this size, in pixels
+		@key_frame 	if True, all of the tiles are returned
+		@encoding 	one of protocol_pb2.Image.Encoding, used for each tile
+		@region 	tuple (x,y,width,height), only take the screenshot of this region
+		@obj 		identifier of the widget, window or QtQuick item to take the screenshot of
+
+		#returns the response, with the frame geometry and the changed tiles, None in case of error
+
+		The server compares the tiles with those of the previous delta screenshot 
+		taken on this connection. All of the tiles are returned when the geometry
+		of the screenshot changes, in which case the field key_frame is set.
+		"""
+		request      = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.TAKE_SCREENSHOT
+		request.id   = win_id
+		request.format.encoding   = encoding
+		request.delta.tile_size   = tile_size
+		request.delta.key_frame   = key_frame
+
+		if obj is not None:
+			request.object = obj
+
+		if region is not None:
+			request.region.x,request.region.y,request.region.width,request.region.height = region
+
+		response = self.send(request)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to take the delta screenshot')
+			return None
+
+		return response
+
+	def start_capture(self,win_id=0,region=None,obj=None,fps=10,mode=protocol_pb2.Capture.DELTA,key_interval=50,
+					  tile_size=64,encoding=protocol_pb2.Image.QOI,directory=None,ring_size=600):
+		"""
+		Begin capturing the screen continuously, for instance to record a video of the test.
+
+		@win_id  	identifier of the window to capture, 0 for the whole screen
+		@region 	tuple (x,y,width,height), only capture this region
+		@obj 		identifier of the widget, window or QtQuick item to capture
+		@fps 		number of frames to grab per second
+		@mode 		protocol_pb2.Capture.DELTA to send only the tiles that changed, or FULL
+		@key_interval for DELTA, send all of the tiles every this many frames
+		@tile_size 	for DELTA, the size of the square tiles, in pixels
+		@encoding 	one of protocol_pb2.Image.Encoding, used for the frames
+		@directory 	if given, the frames are written to files in this directory of the server
+		@ring_size 	maximum number of frame files kept in the directory
+
+		#returns True if successfull, False otherwise
+
+		Unless the directory is given, the server pushes the frames on this 
+		connection, read them with next_frame() until stop_capture() is called.
+		The server drops frames, instead of slowing down the application, when 
+		they are not read fast enough, so use a dedicated connection.
+		"""
+		request 	  = protocol_pb2.Request()
+		request.type  = protocol_pb2.Request.CAPTURE
+		request.start = True
+		request.id 	  = win_id
+		request.format.encoding 	  = encoding
+		request.capture.fps 		  = fps
+		request.capture.mode 		  = mode
+		request.capture.key_interval  = key_interval
+		request.capture.tile_size 	  = tile_size
+		request.capture.ring_size 	  = ring_size
+
+		if directory is not None:
+			request.capture.directory = directory
+
+		if obj is not None:
+			request.object = obj
+
+		if region is not None:
+			request.region.x,request.region.y,request.region.width,request.region.height = region
+
+		if not self.sock:
+			logging.warn('[Client] not connected !')
+			return False
+
+		try:
+			self.capture_sequence = self.stamp(request)
+			self.sock.sendall(self.slip.encode(bytearray(request.SerializeToString())))
+		except socket.error as e:
+			logging.error('[Client] failed to communicate with the server: %s' % str(e))
+			return False
+
+		# the frames follow this response, do not wait for them
+		response = self.receive_reply(self.capture_sequence)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to start the capture')
+			return False
+
+		return True
+
+	def next_frame(self,timeout=None):
+		"""
+		Wait for the next frame of the capture.
+
+		@timeout 	how long to wait for the frame, in seconds, None for the connection default
+
+		#returns the response with the frame, None in case of error
+
+		The frame is sent as a delta screenshot, see take_delta_screenshot(). The
+		field elapsed is the time, in milliseconds, since the capture began and 
+		dropped the number of frames the server dropped so far. 
+		"""
+		response = self.receive_reply(self.capture_sequence,timeout)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] the capture was stopped')
+			return None
+
+		return response
 
+	def stop_capture(self):
+		"""
+		Stop capturing the screen.
+
+		#returns the list of frames not read yet, the last one with the number 
+		of frames captured and dropped, None in case of error
+		"""
+		request 	  = protocol_pb2.Request()
+		request.type  = protocol_pb2.Request.CAPTURE
+		request.start = False
+
+		# the frames already sent arrive before the final response
+		responses = self.send_stream(request,earlier=self.capture_sequence)
+		if not responses or responses[-1].error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to stop the capture')
+			return None
+
+		return responses
+
+	def find_image(self,file_name,win_id=0,region=None,obj=None,count=1):
+		"""
+		Find an image on the screen.
+
+		@file_name 	the PNG, or JPEG, file with the image to find
+		@win_id  	identifier of the window where to search
+		@region 	tuple (x,y,width,height), only search in this region
+		@obj 		identifier of the widget, window or QtQuick item where to search
+		@count 		maximum number of locations to return
+
+		#returns a list of tuples (x,y,width,height,score) with the best locations first, 
+				 None in case of error
+
+		The image is only uploaded the first time it is searched for, the server
+		keeps it under the SHA-1 of its contents. The score goes from 1 for a 
+		perfect match down to 0.
+		"""
+		with open(file_name,'rb') as image:
+			data = image.read()
+
+		request 	 = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.FIND_IMAGE
+		request.id 	 = win_id
+		request.count = count
+		request.image_key = hashlib.sha1(data).digest()
+
+		if obj is not None:
+			request.object = obj
+
+		if region is not None:
+			request.region.x,request.region.y,request.region.width,request.region.height = region
+
+		response = self.send(request)
+
+		if response and response.error == protocol_pb2.Response.UNKNOWN_IMAGE:
+			# the server does not have the image yet, the format is detected from the data
+			request.image.encoding = protocol_pb2.Image.PNG
+			request.image.data 	   = data
+
+			response = self.send(request)
+
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to find the image')
+			return None
+
+		return [(m.x,m.y,m.width,m.height,m.score) for m in response.matches]
+
+	def store_image(self,key,file_name):
+		"""
+		Keep an image on the server, for instance a baseline screenshot.
+
+		@key 		the name of the image on the server
+		@file_name 	the PNG, or JPEG, file with the image
+
+		#returns True if successfull, False otherwise
+		"""
+		with open(file_name,'rb') as image:
+			data = image.read()
+
+		request 	 = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.STORE_IMAGE
+		request.image_key = key
+		request.image.encoding = protocol_pb2.Image.PNG
+		request.image.data 	   = data
+
+		response = self.send(request)
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to store the image %s' % key)
+			return False
+
+		self.images[key] = file_name
 		return True
 
+	def compare_screenshot(self,key,win_id=0,region=None,obj=None,tolerance=0,ignore=[],diff_file=None):
+		"""
+		Compare a screenshot against an image stored on the server.
+
+		@key 		the name of the image on the server, see store_image()
+		@win_id  	identifier of the window to compare
+		@region 	tuple (x,y,width,height), only compare this region
+		@obj 		identifier of the widget, window or QtQuick item to compare
+		@tolerance 	pixels differ if a color channel differs by more than this
+		@ignore 	list of tuples (x,y,width,height), regions of the screenshot not compared
+		@diff_file 	if given, the PNG file where to save an image with the pixels that differ
+
+		#returns a tuple (mismatches,bounds), where bounds is a tuple (x,y,width,height),
+				 or None in case of error
+
+		When nothing differs, no image is transfered at all. If the server no 
+		longer has the image, it is uploaded again.
+		"""
+		request 	 = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.COMPARE_SCREENSHOT
+		request.id 	 = win_id
+		request.image_key = key
+		request.comparison.tolerance  = tolerance
+		request.comparison.diff_image = diff_file is not None
+
+		for (x,y,width,height) in ignore:
+			area = request.comparison.ignore.add()
+			area.x,area.y,area.width,area.height = x,y,width,height
+
+		if obj is not None:
+			request.object = obj
+
+		if region is not None:
+			request.region.x,request.region.y,request.region.width,request.region.height = region
+
+		response = self.send(request)
+
+		if response and response.error == protocol_pb2.Response.UNKNOWN_IMAGE and key in self.images:
+			if self.store_image(key,self.images[key]):
+				response = self.send(request)
+
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] failed to compare the screenshot with %s' % key)
+			return None
+
+		if diff_file is not None and len(response.images):
+			with open(diff_file,'wb') as image:
+				image.write(response.images[0].data)
+
+		bounds = response.difference.bounds
+		return (response.difference.mismatches,(bounds.x,bounds.y,bounds.width,bounds.height))
+
+	def wait_for(self,obj,name,value,op=protocol_pb2.Condition.EQUAL,timeout=5.0):
+		"""
+		Wait until a property of the given object satisfies a condition.
+
+		@obj  		the identifier of the object
+		@name 		name of the property to evaluate
+		@value 		the value, JSON encoded, to compare the property against
+		@op 		how to compare the property with the value
+		@timeout 	how long to wait, in seconds, 0 waits forever
+
+		#returns True if the condition was met, False otherwise
+
+		The condition is evaluated on the server side, as soon as the 
+		property changes, so there is no need to poll the object.
+		"""
+		request = protocol_pb2.Request()
+		request.type = protocol_pb2.Request.WAIT_FOR
+		request.id   = obj
+		request.timeout = int(timeout*1000)
+
+		request.condition.name  = name
+		request.condition.op    = op
+		request.condition.value = value
+
+		# give the server some slack to reply after the timeout
+		response = self.send(request,self.reply_timeout(timeout))
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] condition not met on the object property')
+			return False
+		else:
+			return True
+
+	def wait_idle(self,animations=False,timeout=5.0):
+		"""
+		Wait until the application has handled all of the pending events.
+
+		@animations if True, also wait for the running animations to stop
+		@timeout 	how long to wait, in seconds, 0 waits forever
+
+		#returns the time, in seconds, the application took to settle, None in case of error
+		"""
+		request = protocol_pb2.Request()
+		request.type 	   = protocol_pb2.Request.WAIT_IDLE
+		request.timeout    = int(timeout*1000)
+		request.animations = animations
+
+		# give the server some slack to reply after the timeout
+		response = self.send(request,self.reply_timeout(timeout))
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] the application did not become idle')
+			return None
+		else:
+			return response.elapsed*0.001
+
+	def wait_stable(self,win_id=0,region=None,obj=None,frames=3,interval=0.05,timeout=5.0,name=None,encoding=protocol_pb2.Image.PNG):
+		"""
+		Wait until the pixels on the screen stop changing.
+
+		@win_id 	identifier of the window to watch, 0 for the whole screen
+		@region 	tuple (x,y,width,height), only watch this region
+		@obj 		identifier of the widget, window or QtQuick item to watch
+		@frames 	number of consecutive identical grabs for the screen to be stable, at least 2
+		@interval 	time between grabs, in seconds
+		@timeout 	how long to wait, in seconds, 0 waits forever
+		@name 		if given, file name where to save the stable screenshot
+		@encoding 	one of protocol_pb2.Image.Encoding, used when saving the screenshot
+
+		#returns the time, in seconds, the screen took to settle, None in case of error
+
+		The server grabs the screen periodically and compares only a hash of the
+		pixels, so no screenshot is transfered while waiting. 
+		"""
+		request 		 = protocol_pb2.Request()
+		request.type 	 = protocol_pb2.Request.WAIT_STABLE
+		request.id 		 = win_id
+		request.frames 	 = frames
+		request.interval = int(interval*1000)
+		request.timeout  = int(timeout*1000)
+
+		if obj is not None:
+			request.object = obj
+
+		if region is not None:
+			request.region.x,request.region.y,request.region.width,request.region.height = region
+
+		if name is not None:
+			request.format.encoding = encoding
+
+		# give the server some slack to reply after the timeout
+		response = self.send(request,self.reply_timeout(timeout))
+		if not response or response.error != protocol_pb2.Response.NO_ERROR:
+			logging.error('[Client] the screen did not become stable')
+			return None
+
+		if name is not None:
+			with open(name,'wb') as image:
+				image.write(response.images[0].data)
+
+		return response.elapsed*0.001
+
 	def kill_app(self):
 		"""
 		Force Application Under Test to close.
@@ -30,8 +30,14 @@
 import client
 import tinydb
 import time
+import json
 import cv2
+import numpy
 import protocol_pb2
+import threading
+import logging
+
+from google.protobuf import text_format
 
 class Tester():
 	"""
@@ -63,6 +69,18 @@ class Tester():
 		"""
 		return self.client.disconnect()
 
+	def wait_idle(self,animations=False,timeout=5.0):
+		"""
+		Wait until the application has handled all of the pending events,
+		for instance after simulating the user input.
+
+		@animations if True, also wait for the running animations to stop
+		@timeout 	how long to wait, in seconds
+
+		#returns True if the application became idle in time, False otherwise
+		"""
+		return None != self.client.wait_idle(animations,timeout)
+
 class User(Tester):
 	"""
 	This class provides functionality to simulate a user interacting
@@ -128,16 +146,18 @@ class User(Tester):
 
 		return self.client.simulate_keyboard(symbol,False)
 
-	def start_record(self,delay=1.0):
+	def start_record(self,delay=1.0,qt_events=False):
 		"""
 		This function requests the server to begin recording the user.
 
-		@delay  how long to wait before begining to record the user 
+		@delay  	how long to wait before begining to record the user 
+		@qt_events 	if True, record the Qt events relative to their target
+					objects, so the replay does not depend on where the windows are
 
 		#returns True if successfull, False otherwise
 		"""
 		time.sleep(delay)
-		return self.client.start_recording_user()
+		return self.client.start_recording_user(qt_events)
 		
 	def stop_record(self,output):
 		"""
@@ -153,14 +173,22 @@ class User(Tester):
 			# an error occurred 
 			return False
 		else:
-			# save the events to file, in CSV format:
+			# save the events to file, in CSV format, the time in milliseconds
+			# with the microseconds as decimals:
 			# - for keyboard events     : time,type,key name, pressed
 			# - for mouse button events : time,type,button ID, pressed
 			# - for mouse move events   : time,type,xpos, ypos
+			# the Qt events, with their target object, do not fit in the CSV
+			# columns and are saved in the protobuf text format instead
 			with open(output,'w') as csv:
 				for event in events:
-					line = str(event.instant) + ',' + str(event.type) + ','
-					if protocol_pb2.UserEvent.KEYBOARD == event.type:
+					if event.HasField('instant_us'):
+						line = '%.3f' % (event.instant_us/1000.0) + ',' + str(event.type) + ','
+					else:
+						line = str(event.instant) + ',' + str(event.type) + ','
+					if event.HasField('path'):
+						line = text_format.MessageToString(event,as_one_line=True)
+					elif protocol_pb2.UserEvent.KEYBOARD == event.type:
 						line += event.key + ',' + str(event.press)
 					elif protocol_pb2.UserEvent.MOUSE_BUTTON == event.type:
 						line += str(event.button) + ',' + str(event.press)
@@ -185,75 +213,260 @@ class User(Tester):
 		else:
 			return False
 
-	def replay(self,events):
+	def replay(self,events,speed=1.0,timeout=0):
 		"""
 		Read the user events from a CSV formated file and replay them on
-		the server side.
+		the server side. The whole file is sent at once and the server
+		injects the events on its own timeline, so neither the network
+		nor this process delay them.
 
 		@events  the CSV file with the events to replay
+		@speed 	 the speed multiplier, 0 replays the events as fast as possible
+		@timeout how long the replay can take, in seconds, 0 waits forever
 
 		#returns True if successfull, False otherwise
 		"""
-		# load the events from file and replay them as they are being read
+		steps = []
+
+		# load the events from file
 		with open(events,'r') as csv:
-			line    = csv.readline().strip()
-			last_t0 = 0
-			while len(line) > 0:
+			for line in csv:
+				line   = line.strip()
 				fields = line.split(',')
-				ok     = False
-				start  = time.time()
+				event  = protocol_pb2.UserEvent()
+
+				if line.startswith('type:'):
+					text_format.Merge(line,event)
+				elif len(fields) == 4:
+					event.type 		 = int(fields[1])
+					event.instant_us = int(round(float(fields[0])*1000))
+					event.instant 	 = event.instant_us//1000
+
+					if event.type in [protocol_pb2.UserEvent.KEYBOARD,protocol_pb2.UserEvent.MOUSE_BUTTON]:
+						if protocol_pb2.UserEvent.KEYBOARD == event.type:
+							event.key 	 = fields[2]
+						else:
+							event.button = int(fields[2])
+						event.press = self.str2bool(fields[3])
+					elif event.type in [protocol_pb2.UserEvent.MOUSE_MOVE_REL,protocol_pb2.UserEvent.MOUSE_MOVE_ABS]:
+						event.xpos = int(fields[2])
+						event.ypos = int(fields[3])
+					else:
+						return False
+				elif 0 == len(line):
+					continue
+				else:
+					return False
 
-				if len(fields) == 4:
-					t0 = int(fields[0])
-					ev_type = int(fields[1])
-					
-					if protocol_pb2.UserEvent.KEYBOARD == ev_type:
-						press = self.str2bool(fields[3])
-						key   = fields[2]
-						ok    = self.client.simulate_keyboard(key,press)
-					elif protocol_pb2.UserEvent.MOUSE_BUTTON == ev_type:
-						button = int(fields[2])
-						press  = self.str2bool(fields[3])
-						ok     = self.client.simulate_mouse_button(button,press)
-					elif ev_type in [protocol_pb2.UserEvent.MOUSE_MOVE_REL,protocol_pb2.UserEvent.MOUSE_MOVE_ABS]:
-						xpos = int(fields[2])
-						ypos = int(fields[3])
-						ok   = self.client.simulate_mouse_move([xpos,ypos],ev_type == protocol_pb2.UserEvent.MOUSE_MOVE_REL) 
-
-				if not ok:
-					return False 
-
-				# wait for the next event, taking into account the elapsed time in
-				# communicating with the server
-				end = time.time()
-				if (end - start) < (t0 - last_t0)*0.001:
-					time.sleep((t0 - last_t0)*0.001 - (end - start))
-				
-				last_t0 = t0
-
-				# read the next event
-				line = csv.readline().strip()
-
-		return True		
+				steps.append(event)
+
+		report = self.client.replay(steps,speed,timeout)
+		if None == report:
+			return False
+
+		logging.info('[User] replayed %d events, %d us late on average, %d us at most' % (report.events,report.mean_late_us,report.max_late_us))
+		return True
 
 class Screen(Tester):
 	"""
 	This class provides the functionality to take screenshots and 
 	to further process the resulting images.
 	"""
-		
-	def take_screenshot(self,file_name,winid=0):
+
+	def __init__(self):
+		"""
+		Class properties initialization
+		"""
+		Tester.__init__(self)
+		self.frame 	 = None
+		self.digests = {}
+
+	def take_screenshot(self,file_name,winid=0,encoding=None,quality=-1,region=None):
 		"""
 		Request the server to take a screenshot of the entire screen.
 
 		@file_name  name of the image file where the screenshot is save, in PNG format
 		@winid      the X11 window on which to take the screenshot
+		@encoding 	one of protocol_pb2.Image.Encoding, None for PNG
+		@quality 	the encoding quality, from 0 to 100, or -1 for the default
+		@region 	tuple (x,y,width,height), only take the screenshot of this region
 
 		#returns True if successfull, False otherwise
 
 		If win_id is zero, then the screenshot includes all of the screen
 		"""
-		return self.client.take_screenshot(file_name,win_id=winid)
+		return self.client.take_screenshot(file_name,win_id=winid,encoding=encoding,quality=quality,region=region)
+
+	def take_object_screenshot(self,file_name,obj,encoding=None,quality=-1,region=None):
+		"""
+		Request the server to take a screenshot of a single object.
+
+		@file_name  name of the image file where the screenshot is save, in PNG format
+		@obj 		identifier of the widget, window or QtQuick item
+		@encoding 	one of protocol_pb2.Image.Encoding, None for PNG
+		@quality 	the encoding quality, from 0 to 100, or -1 for the default
+		@region 	tuple (x,y,width,height), relative to the object, only take the screenshot of this region
+
+		#returns True if successfull, False otherwise
+
+		Only the pixels of the object are grabbed, which is much faster than 
+		taking a screenshot of the whole screen and cropping it.
+		"""
+		return self.client.take_screenshot(file_name,encoding=encoding,quality=quality,region=region,obj=obj)
+
+	def take_screenshots(self,file_prefix,winids=[],all_screens=False):
+		"""
+		Request the server to take the screenshots of several windows, and screens, at once.
+
+		@file_prefix the screenshots are saved, in PNG format, as <file_prefix><n>.png
+		@winids 	 list with the X11 windows on which to take the screenshots
+		@all_screens if True, also take one screenshot of each screen
+
+		#returns list of tuples (file_name,x,y,width,height), with the geometry
+		of each screenshot, None in case of error
+		"""
+		images = self.client.take_screenshots(winids,all_screens)
+
+		if images is None:
+			return None
+
+		shots = []
+		for n, image in enumerate(images):
+			file_name = '%s%d.png' % (file_prefix,n)
+			with open(file_name,'wb') as output:
+				output.write(image.data)
+
+			shots.append((file_name,image.xpos,image.ypos,image.width,image.height))
+
+		return shots
+
+	def take_delta_screenshot(self,file_name,winid=0,tile_size=64,region=None):
+		"""
+		Request the server to take a screenshot, transfering only what changed.
+
+		@file_name  name of the image file where the screenshot is saved
+		@winid      the X11 window on which to take the screenshot
+		@tile_size 	size of the tiles in which the screenshot is split, in pixels
+		@region 	tuple (x,y,width,height), only take the screenshot of this region
+
+		#returns True if successfull, False otherwise
+
+		The server only sends the tiles that changed since the previous delta 
+		screenshot, and the whole screenshot is rebuilt here. This is much faster
+		than taking full screenshots when only a small part of the screen changes.
+		"""
+		response = self.client.take_delta_screenshot(winid,tile_size,self.frame is None,region=region)
+
+		if response is None:
+			return False
+
+		if not response.key_frame and self.frame is None:
+			return False
+
+		if response.key_frame:
+			self.frame = numpy.zeros((response.frame.height,response.frame.width,4),numpy.uint8)
+
+		# the raw tiles are in the same B,G,R,A order used by OpenCV
+		for tile in response.images:
+			pixels = numpy.frombuffer(tile.data,numpy.uint8).reshape((tile.height,tile.width,4))
+			self.frame[tile.ypos:tile.ypos + tile.height,tile.xpos:tile.xpos + tile.width] = pixels
+
+		return cv2.imwrite(file_name,self.frame)
+
+	def locate(self,needle,winid=0,region=None,count=1,threshold=0.95):
+		"""
+		Locate an image on the screen, without taking a screenshot.
+
+		@needle  	the file containing the image to search for
+		@winid      the X11 window where to search
+		@region 	tuple (x,y,width,height), only search in this region
+		@count 		maximum number of locations to return
+		@threshold 	minimum score of a location, 1 is a perfect match
+
+		#returns a list with the center (x,y) coordinates of the needle on 
+				 the screen, the best match first
+		"""
+		matches = self.client.find_image(needle,win_id=winid,region=region,count=count)
+
+		if matches is None:
+			return []
+
+		return [(x + w/2,y + h/2) for (x,y,w,h,score) in matches if score >= threshold]
+
+	def looks_same(self,name,winid=0,region=None,obj=None,max_distance=0):
+		"""
+		Verify if the screen looks the same as the last time it was checked under this name.
+
+		@name 		  the name under which the previous check is kept
+		@winid 		  the X11 window to check
+		@region 	  tuple (x,y,width,height), only check this region
+		@obj 		  identifier of the widget, window or QtQuick item to check
+		@max_distance how many bits of the perceptual hash can differ, 0 requires identical pixels
+
+		#returns True if it looks the same, or it is checked for the first time, False otherwise
+
+		Only the hashes of the screenshot are transfered, not the screenshot.
+		"""
+		digest = self.client.take_digest(winid,region,obj)
+
+		if digest is None:
+			return False
+
+		previous = self.digests.get(name)
+		self.digests[name] = digest
+
+		if previous is None:
+			return True
+		elif 0 == max_distance:
+			return previous.sha256 == digest.sha256
+		else:
+			return bin(previous.phash ^ digest.phash).count('1') <= max_distance
+
+	def store_baseline(self,name,file_name):
+		"""
+		Upload a baseline screenshot to the server, where it is kept.
+
+		@name 		the name of the baseline
+		@file_name 	the PNG file with the baseline
+
+		#returns True if successfull, False otherwise
+		"""
+		return self.client.store_image(name,file_name)
+
+	def matches_baseline(self,name,winid=0,region=None,tolerance=0,ignore=[],max_mismatches=0,diff_file=None):
+		"""
+		Compare the screen against a baseline kept on the server.
+
+		@name 			the name of the baseline, see store_baseline()
+		@winid      	the X11 window to compare
+		@region 		tuple (x,y,width,height), only compare this region
+		@tolerance 		pixels differ if a color channel differs by more than this
+		@ignore 		list of tuples (x,y,width,height), regions not compared
+		@max_mismatches how many pixels are allowed to differ
+		@diff_file 		if given, the PNG file where to save an image with the pixels that differ
+
+		#returns True if the screen matches the baseline, False otherwise
+		"""
+		result = self.client.compare_screenshot(name,win_id=winid,region=region,tolerance=tolerance,ignore=ignore,diff_file=diff_file)
+
+		if result is None:
+			return False
+
+		return result[0] <= max_mismatches
+
+	def wait_stable(self,winid=0,region=None,frames=3,timeout=5.0,file_name=None):
+		"""
+		Wait until the screen stops changing, for instance at the end of an animation.
+
+		@winid      the X11 window to watch
+		@region 	tuple (x,y,width,height), only watch this region
+		@frames 	number of consecutive identical grabs for the screen to be stable
+		@timeout 	how long to wait, in seconds
+		@file_name 	if given, the PNG file where to save the stable screenshot
+
+		#returns True if the screen became stable in time, False otherwise
+		"""
+		return None != self.client.wait_stable(win_id=winid,region=region,frames=frames,timeout=timeout,name=file_name)
 
 	def find(self,needle,screen):
 		"""
@@ -275,6 +488,112 @@ class Screen(Tester):
 
 		return location
 
+class Video(Tester):
+	"""
+	This class records a video of the application under test, for instance
+	to find out why a test fails only sometimes. It uses its own connection
+	to the server, so it can be used while running the test.
+	"""
+
+	def __init__(self):
+		"""
+		Class properties initialization
+		"""
+		Tester.__init__(self)
+		self.thread  = None
+		self.stopped = threading.Event()
+		self.frames  = 0
+		self.dropped = 0
+
+	def start(self,file_name,fps=10,winid=0,region=None):
+		"""
+		Begin recording the video, in the background.
+
+		@file_name  name of the video file, in the MJPG format
+		@fps 		number of frames to record per second
+		@winid      the X11 window to record
+		@region 	tuple (x,y,width,height), only record this region
+
+		#returns True if successfull, False otherwise
+
+		Only the tiles of the screen that changed are sent by the server, which 
+		drops frames instead of slowing down the application. The video timing 
+		follows the time at which each frame was grabbed.
+		"""
+		if not self.client.start_capture(winid,region,fps=fps,encoding=protocol_pb2.Image.RAW):
+			return False
+
+		self.stopped.clear()
+		self.thread = threading.Thread(target=self.record,args=(file_name,fps))
+		self.thread.start()
+
+		return True
+
+	def stop(self):
+		"""
+		Stop recording the video.
+
+		#returns the number of frames recorded and dropped, None in case of error
+		"""
+		if self.thread is None:
+			return None
+
+		self.stopped.set()
+		self.thread.join()
+		self.thread = None
+
+		return (self.frames,self.dropped)
+
+	def record(self,file_name,fps):
+		"""
+		Read the frames and write them to the video file, runs in the background.
+
+		@file_name  name of the video file
+		@fps 		number of frames per second
+		"""
+		writer  = None
+		frame 	= None
+		written = 0
+
+		while True:
+			if self.stopped.is_set():
+				responses = self.client.stop_capture() or []
+			else:
+				response  = self.client.next_frame(1.0)
+				responses = [response] if response else []
+
+			for response in responses:
+				if response.key_frame:
+					frame = numpy.zeros((response.frame.height,response.frame.width,4),numpy.uint8)
+
+				if frame is None:
+					continue
+
+				# the raw tiles are in the same B,G,R,A order used by OpenCV
+				for tile in response.images:
+					pixels = numpy.frombuffer(tile.data,numpy.uint8).reshape((tile.height,tile.width,4))
+					frame[tile.ypos:tile.ypos + tile.height,tile.xpos:tile.xpos + tile.width] = pixels
+
+				if writer is None:
+					fourcc = cv2.VideoWriter_fourcc(*'MJPG')
+					writer = cv2.VideoWriter(file_name,fourcc,fps,(frame.shape[1],frame.shape[0]))
+
+				# repeat the frame to fill in for the dropped ones
+				instant = int(response.elapsed*fps/1000.0) + 1
+				while written < instant:
+					writer.write(cv2.cvtColor(frame,cv2.COLOR_BGRA2BGR))
+					written += 1
+
+				self.dropped = response.dropped
+
+			if self.stopped.is_set():
+				if responses:
+					self.frames = responses[-1].frame_number
+				break
+
+		if writer is not None:
+			writer.release()
+
 class Application(Tester):
 	"""
 	This class provides the functionalities to list the objects in
@@ -386,6 +705,52 @@ class Application(Tester):
 			# all done 
 			return True
 
+	def model_data(self,obj,roles=[],row=0,rows=0):
+		"""
+		Read the contents of an item model, page by page.
+
+		@obj        identifier of the model, or of a view with a model
+		@roles 		the roles to read, as numbers or names, by default the display role
+		@row 		first row to read
+		@rows 		number of rows to read, 0 to read until the end of the model
+
+		#returns dictionary with a list of row values for each (column,role) pair, None in case of error
+
+		The role in the dictionary key is the role name, if the model has one.
+		"""
+		contents = dict()
+		last_row = row + rows
+
+		while True:
+			page = self.client.fetch_model_data(obj,row,(last_row - row) if rows else 0,roles=roles)
+			if None == page:
+				return None
+
+			for data in page:
+				for column in data.columns:
+					key = (column.column,column.name if column.HasField('name') else column.role)
+					contents.setdefault(key,[]).extend(json.loads(column.values))
+
+			# keep reading until the requested rows, or the whole model, were read
+			if not data.HasField('next_row') or (rows and data.next_row >= last_row):
+				return contents
+			else:
+				row = data.next_row
+
+	def wait_for(self,obj,prop,value,op=protocol_pb2.Condition.EQUAL,timeout=5.0):
+		"""
+		Wait until the property of the specified object satisfies a condition.
+
+		@obj        object identifier
+		@prop   	name of the property to evaluate
+		@value 		the expected value, JSON encoded
+		@op 		the comparison to use, see protocol_pb2.Condition
+		@timeout 	how long to wait, in seconds
+
+		#returns True if the condition was met in time, False otherwise
+		"""
+		return self.client.wait_for(obj,prop,value,op,timeout)
+
 	def get_object(self,obj):
 		"""
 		Return the object as it is currently on the database
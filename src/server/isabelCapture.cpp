@@ -0,0 +1,314 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelCapture.h"
+
+#include <QtConcurrent>
+#include <QByteArray>
+#include <QStringList>
+#include <QFile>
+#include <QDir>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+#define CAPTURE_MAX_FPS 	(60)				/* maximum number of frames grabbed per second */
+#define CAPTURE_MAX_PENDING (4*1024*1024)		/* frames are dropped while the client has more than this, in bytes, to read */
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Encode a frame, this runs in the thread pool.
+
+	@state 		the encoding state, shared by all of the frames
+	@shot 		the frame to encode
+	@number 	the sequence number of the frame
+	@key_frame 	if true, encode all of the tiles
+	@elapsed 	time, in milliseconds, since the capture began
+
+	#returns the response with the encoded frame
+*/
+static Response capture_encode(T_CAPTURE *state, T_SHOT shot, unsigned int number, bool key_frame, qint64 elapsed);
+
+/*--------------------- Public Class Definitions -------------------*/
+
+isabelCapture::isabelCapture(QTcpSocket *client, QObject *object, WId win_id, const QRect &region,
+							 const Capture &capture, const ImageFormat &format, QObject *parent)
+: QObject(parent)
+{
+	this->socket = client;
+	this->target = object;
+	this->object = (NULL != object);
+	this->window = win_id;
+	this->region = region;
+	this->ticker = new QTimer(this);
+	this->frames = 0;
+	this->dropped = 0;
+	this->pending = false;
+	this->status  = Response::NO_ERROR;
+
+	key_interval = qMax(1U,capture.key_interval());
+
+	/* the lossless QOI is the fastest to encode */
+	encoding = Image::QOI;
+	quality  = -1;
+
+	if(format.has_encoding())
+	{
+		encoding = format.encoding();
+		quality  = format.quality();
+	}
+
+	state.mode 		= capture.mode();
+	state.tile_size = capture.tile_size();
+	state.directory = QString::fromUtf8(capture.directory().c_str());
+	state.ring_size = qMax(1U,capture.ring_size());
+	state.failed 	= false;
+
+	ticker->setTimerType(Qt::PreciseTimer);
+	ticker->setInterval(1000/qBound(1U,capture.fps(),(unsigned int)CAPTURE_MAX_FPS));
+
+	connect(ticker,SIGNAL(timeout()),this,SLOT(tick()));
+	connect(&watcher,SIGNAL(finished()),this,SLOT(encoded()));
+}
+
+isabelCapture::~isabelCapture()
+{
+	/* the thread pool might still be using the encoding state */
+	watcher.waitForFinished();
+}
+
+bool isabelCapture::start(void)
+{
+	if(!state.directory.isEmpty())
+	{
+		QDir directory(state.directory);
+
+		if(!directory.mkpath("."))
+		{
+			return false;
+		}
+
+		/* the frames of a previous capture would be mixed with the new ones */
+		Q_FOREACH(const QString &name, directory.entryList(QStringList() << "frame_*.pb",QDir::Files))
+		{
+			directory.remove(name);
+		}
+	}
+
+	clock.start();
+	ticker->start();
+
+	return true;
+}
+
+void isabelCapture::stop(Response &response)
+{
+	ticker->stop();
+	watcher.waitForFinished();
+
+	if(pending)
+	{
+		/* the last frame was encoded, but not sent yet */
+		response.CopyFrom(watcher.result());
+		pending = false;
+	}
+
+	if(state.failed && (Response::NO_ERROR == status))
+	{
+		status = Response::UNKNOWN_ERROR;
+	}
+
+	response.set_error(status);
+	response.set_more(false);
+	response.set_frame_number(frames);
+	response.set_dropped(dropped);
+}
+
+bool isabelCapture::streaming(void)
+{
+	return state.directory.isEmpty();
+}
+
+QTcpSocket *isabelCapture::client(void)
+{
+	return socket.data();
+}
+
+const Response &isabelCapture::response(void)
+{
+	return result;
+}
+
+void isabelCapture::tick(void)
+{
+	/* never wait for the encoding, nor for the client, just skip the frame */
+	if(pending || (streaming() && !socket.isNull() && (CAPTURE_MAX_PENDING < socket->bytesToWrite())))
+	{
+		dropped++;
+		return;
+	}
+
+	T_SHOT shot;
+	bool   grabbed;
+
+	if(object)
+	{
+		if(target.isNull())
+		{
+			/* the object was destroyed while capturing */
+			fail(Response::UNKNOWN_OBJECT_ID);
+			return;
+		}
+
+		grabbed = grab_object(shot,target.data(),region);
+	}
+	else
+	{
+		grabbed = grab_window(shot,window,region);
+	}
+
+	if(!grabbed)
+	{
+		fail(object ? Response::NOT_VISIBLE : Response::X11_ERROR);
+		return;
+	}
+
+	shot.encoding = encoding;
+	shot.quality  = quality;
+
+	pending = true;
+	watcher.setFuture(QtConcurrent::run(capture_encode,&state,shot,frames,0 == (frames % key_interval),clock.elapsed()));
+
+	frames++;
+}
+
+void isabelCapture::encoded(void)
+{
+	if(!pending)
+	{
+		/* already returned when the capture was stopped */
+		return;
+	}
+
+	pending = false;
+
+	if(state.failed)
+	{
+		fail(Response::UNKNOWN_ERROR);
+		return;
+	}
+
+	if(streaming())
+	{
+		result = watcher.result();
+		result.set_dropped(dropped);
+
+		emit frame_ready();
+	}
+}
+
+void isabelCapture::fail(Response::Error error)
+{
+	ticker->stop();
+	status = error;
+
+	if(streaming())
+	{
+		/* the client is waiting for frames, let it know that no more will come */
+		result.Clear();
+		result.set_error(error);
+		result.set_frame_number(frames);
+		result.set_dropped(dropped);
+
+		emit frame_ready();
+	}
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static Response capture_encode(T_CAPTURE *state, T_SHOT shot, unsigned int number, bool key_frame, qint64 elapsed)
+{
+	Response 	  frame;
+	QList<T_SHOT> shots;
+
+	frame.set_error(Response::NO_ERROR);
+	frame.set_more(state->directory.isEmpty());
+	frame.set_frame_number(number);
+	frame.set_elapsed(elapsed);
+
+	if(Capture::DELTA == state->mode)
+	{
+		QRect geometry(shot.position,shot.image.size());
+
+		/* the tiles can only be compared against a frame with the same geometry */
+		if(key_frame || (state->frame != geometry))
+		{
+			state->tiles.clear();
+		}
+
+		Rect *bounds = frame.mutable_frame();
+
+		bounds->set_x(geometry.x());
+		bounds->set_y(geometry.y());
+		bounds->set_width(geometry.width());
+		bounds->set_height(geometry.height());
+
+		frame.set_key_frame(state->tiles.empty());
+
+		shots 		 = image_changed_tiles(shot,state->tile_size,state->tiles);
+		state->frame = geometry;
+	}
+	else
+	{
+		frame.set_key_frame(true);
+		shots.append(shot);
+	}
+
+	Q_FOREACH(const T_SHOT &part, shots)
+	{
+		frame.add_images()->CopyFrom(image_encode_shot(part));
+	}
+
+	if(!state->directory.isEmpty())
+	{
+		/* the oldest frames are overwritten, so the files never take more than the ring */
+		QString name = QString("%1/frame_%2.pb").arg(state->directory).arg(number % state->ring_size,6,10,QChar('0'));
+		QFile 	file(name);
+
+		QByteArray data(frame.ByteSize(),0);
+		frame.SerializeToArray(data.data(),data.size());
+
+		if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || (data.size() != file.write(data)))
+		{
+			state->failed = true;
+		}
+
+		/* nothing to send to the client */
+		frame.clear_images();
+	}
+
+	return frame;
+}
@@ -0,0 +1,162 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Continuous capture of the screen, of a window, of an object or of a
+   region, at a given rate. It is meant for recording a video of a test
+   run, for instance to diagnose the tests that fail only sometimes.
+
+   The frames are grabbed in the GUI thread, by a timer, and encoded in
+   the Qt thread pool, either whole or as the tiles that changed since
+   the previous frame. The encoded frames are pushed to the client as
+   responses with the field `more` set, or written to a ring of files on
+   the server.
+
+   Only one frame is encoded at a time. If the previous frame is still
+   being encoded, or the client is not reading the frames fast enough,
+   the frame is dropped instead of grabbed, so the capture never slows
+   down the application under test.
+ */
+#ifndef __ISABEL_CAPTURE_H__
+#define __ISABEL_CAPTURE_H__
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QTcpSocket>
+#include <QFutureWatcher>
+#include <QString>
+#include <QRect>
+
+#include <vector>
+
+#include "protocol.pb.h"
+#include "isabelImage.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+typedef struct{
+	Capture::Mode 		  mode; 		// how the frames are encoded
+	int 				  tile_size; 	// for DELTA, the size of the tiles
+	std::vector<uint64_t> tiles; 		// for DELTA, the hashes of the tiles of the previous frame
+	QRect 				  frame; 		// for DELTA, the geometry of the previous frame
+	QString 			  directory; 	// where to write the frames, empty to send them to the client
+	unsigned int 		  ring_size; 	// number of frame files kept in the directory
+	bool 				  failed; 		// true if a frame could not be written to its file
+} T_CAPTURE;
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelCapture : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the frames are sent
+		@object 	the object to capture, NULL to capture the window
+		@win_id 	the X11 window identifier, use 0 for the whole screen
+		@region 	the region to capture, use a null rectangle to capture all of it
+		@capture 	the rate, and how to encode the frames
+		@format 	the encoding of the frames
+		@parent 	the parent QObject
+	*/
+	isabelCapture(QTcpSocket *client, QObject *object, WId win_id, const QRect &region,
+				  const Capture &capture, const ImageFormat &format, QObject *parent);
+
+	/* Class destructor.
+
+		Waits for the frame being encoded, if any.
+	*/
+	virtual ~isabelCapture();
+
+	/* Begin grabbing the frames.
+
+		#returns true if successfull, false if the directory cannot be created
+	*/
+	bool start(void);
+
+	/* Stop grabbing the frames.
+
+		@response 	where the last frame, if not sent yet, and the number of frames
+					captured and dropped are returned
+	*/
+	void stop(Response &response);
+
+	/* Return true if the frames are sent to the client, false if they are written to files.
+	*/
+	bool streaming(void);
+
+	/* Return the client connection, NULL if it was already closed.
+	*/
+	QTcpSocket *client(void);
+
+	/* Return the last encoded frame, valid after frame_ready().
+
+		If the frame has an error, the capture was stopped.
+	*/
+	const Response &response(void);
+
+Q_SIGNALS:
+	void frame_ready(void);		/* emitted when a frame is ready to be sent to the client */
+
+private slots:
+	/* Grab the next frame, or drop it if the previous one is still being handled.
+	 */
+	void tick(void);
+
+	/* Collect the encoded frame.
+	 */
+	void encoded(void);
+
+private:
+	/* Stop grabbing because of an error.
+
+		@error 	the error code to send to the client
+	*/
+	void fail(Response::Error error);
+
+private:
+	QPointer<QTcpSocket> 	 socket; 	/* the client connection */
+	QPointer<QObject> 		 target; 	/* the object to capture */
+	bool 					 object; 	/* if true, capture the object instead of the window */
+	WId 					 window; 	/* the window to capture */
+	QRect 					 region; 	/* the region to capture */
+	QTimer 					 *ticker; 	/* grabs the frames at the requested rate */
+	QElapsedTimer 			 clock; 	/* time since the capture began */
+	QFutureWatcher<Response> watcher; 	/* follows the encoding in the thread pool */
+	T_CAPTURE 				 state; 	/* the encoding state, only used by the thread pool */
+	Response 				 result; 	/* the last encoded frame */
+	int 					 encoding; 	/* the encoding of the frames, one of Image::Encoding */
+	int 					 quality; 	/* the quality, as in QImage::save */
+	unsigned int 			 key_interval; /* for DELTA, number of frames between key frames */
+	unsigned int 			 frames; 	/* number of frames grabbed */
+	unsigned int 			 dropped; 	/* number of frames dropped */
+	bool 					 pending; 	/* true while a frame is being encoded, or waits to be collected */
+	Response::Error 		 status; 	/* the error that stopped the capture, if any */
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelCompress.h"
+
+#ifdef ISABEL_ZSTD
+	#include <zstd.h>
+#endif
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+#define COMPRESS_ZLIB_LEVEL (3)		/* the responses are mostly text, a low level already compresses them well */
+#define COMPRESS_ZSTD_LEVEL (3)
+
+/*--------------------- Public Function Definitions ----------------*/
+
+bool compress_supported(Compressed::Method method)
+{
+	bool result = false;
+
+	switch(method)
+	{
+		case Compressed::NONE:
+		case Compressed::ZLIB:
+			result = true;
+			break;
+
+		case Compressed::ZSTD:
+#ifdef ISABEL_ZSTD
+			result = true;
+#endif
+			break;
+
+		default:
+			break;
+	}
+
+	return result;
+}
+
+QByteArray compress_encode(Compressed::Method method, const QByteArray &input)
+{
+	QByteArray output;
+
+	switch(method)
+	{
+		case Compressed::NONE:
+			output = input;
+			break;
+
+		case Compressed::ZLIB:
+			output = qCompress(input,COMPRESS_ZLIB_LEVEL);
+			break;
+
+#ifdef ISABEL_ZSTD
+		case Compressed::ZSTD:
+			{
+				output.resize(ZSTD_compressBound(input.size()));
+
+				size_t size = ZSTD_compress(output.data(),output.size(),input.constData(),input.size(),COMPRESS_ZSTD_LEVEL);
+
+				if(ZSTD_isError(size))
+				{
+					output.clear();
+				}
+				else
+				{
+					output.resize(size);
+				}
+			}
+			break;
+#endif
+
+		default:
+			break;
+	}
+
+	return output;
+}
+
+QByteArray compress_decode(Compressed::Method method, const QByteArray &input, unsigned int length)
+{
+	QByteArray output;
+
+	switch(method)
+	{
+		case Compressed::NONE:
+			output = input;
+			break;
+
+		case Compressed::ZLIB:
+			output = qUncompress(input);
+			break;
+
+#ifdef ISABEL_ZSTD
+		case Compressed::ZSTD:
+			{
+				output.resize(length);
+
+				size_t size = ZSTD_decompress(output.data(),output.size(),input.constData(),input.size());
+
+				if(ZSTD_isError(size) || (size != length))
+				{
+					output.clear();
+				}
+			}
+			break;
+#endif
+
+		default:
+			break;
+	}
+
+	/* guard against truncated, or corrupted, payloads */
+	if((unsigned int)output.size() != length)
+	{
+		output.clear();
+	}
+
+	return output;
+}
@@ -0,0 +1,70 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Compression of the responses sent to the client. The zlib method is
+   always available, through qCompress. The zstd method is only available
+   when the server is built with zstd support (qmake CONFIG+=zstd).
+
+ */
+#ifndef __ISABEL_COMPRESS_H__
+#define __ISABEL_COMPRESS_H__
+
+#include <QByteArray>
+
+#include "protocol.pb.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+#define COMPRESS_THRESHOLD (1024)	/* default size, in bytes, from which responses are compressed */
+
+/*--------------------- Public Function Declarations ----------------*/
+
+/* Verify if the compression method is available.
+
+	@method  the compression method
+
+	#returns true if the server can compress with this method, false otherwise
+*/
+bool compress_supported(Compressed::Method method);
+
+/* Compress the byte array.
+
+	@method  the compression method
+	@input   the byte array to compress
+
+	#returns the compressed byte array, empty in case of error
+*/
+QByteArray compress_encode(Compressed::Method method, const QByteArray &input);
+
+/* Decompress the byte array.
+
+	@method  the compression method
+	@input   the compressed byte array
+	@length  the size of the uncompressed byte array
+
+	#returns the uncompressed byte array, empty in case of error
+*/
+QByteArray compress_decode(Compressed::Method method, const QByteArray &input, unsigned int length);
+
+#endif
@@ -0,0 +1,735 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelEvents.h"
+
+#include <QApplication>
+#include <QStyleHints>
+#include <QKeySequence>
+#include <QStringList>
+#include <QRegExp>
+#include <QWindow>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QKeyEvent>
+#include <QTouchEvent>
+#include <QTouchDevice>
+
+#include <QtWidgets/QWidget>
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickView>
+
+#include <cstring>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+/* the mouse buttons, in the order of the X11 button numbers */
+static const Qt::MouseButton mouse_buttons[] = {
+	Qt::LeftButton, Qt::MiddleButton, Qt::RightButton,
+	Qt::NoButton, Qt::NoButton, Qt::NoButton, Qt::NoButton, 	/* the wheel */
+	Qt::BackButton, Qt::ForwardButton
+};
+
+#define MOUSE_BUTTONS (sizeof(mouse_buttons)/sizeof(mouse_buttons[0]))
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Return the objects without parent, as listed in the object tree.
+*/
+static QList<QObject *> object_roots(void);
+
+/* Return the path of an object, which identifies it from one run of the application to the next.
+
+	@object 	the object
+
+	#returns the path, as the names, or class and index, of the object and its parents, separated by /
+*/
+static QString object_path(QObject *object);
+
+/* Find the object with the given path.
+
+	@path 	the path of the object
+
+	#returns the object, NULL if there is none
+*/
+static QObject *object_find(const QString &path);
+
+/* Verify that an event ignored by an object can be delivered next to another one.
+
+	@previous 	the object that ignored the event
+	@receiver 	the object receiving the event
+
+	#returns true if the receiver is a parent of the widget, or another item of
+	the same QtQuick window, which delivers to the items under the point
+*/
+static bool object_next(QObject *previous, QObject *receiver);
+
+/* Find the window showing an object, and the position of a point of the object in that window.
+
+	@object 	the widget, QtQuick item or window
+	@local 		the point, relative to the object
+	@window 	where the window is returned
+	@position 	where the position of the point in the window is returned
+
+	#returns true if successfull, false if the object is not shown
+*/
+static bool object_window(QObject *object, const QPoint &local, QWindow *&window, QPointF &position);
+
+/* Return the X11 number of a mouse button, 0 if it has none.
+*/
+static unsigned int button_number(Qt::MouseButton button);
+
+/* Return the mouse buttons as a bitmap of the X11 button numbers, bit 0 for button 1.
+*/
+static unsigned int button_bitmap(Qt::MouseButtons buttons);
+
+/* Return the mouse buttons of a bitmap of the X11 button numbers.
+*/
+static Qt::MouseButtons button_flags(unsigned int bitmap);
+
+/*--------------------- Public Class Definitions -------------------*/
+
+isabelEvents::isabelEvents(QObject *parent)
+: QObject(parent)
+{
+	active 		 = false;
+	last_type 	 = QEvent::None;
+	last_time 	 = 0;
+	last_event 	 = NULL;
+	press_button = 0;
+	max_events 	 = 1;
+	dropped 	 = 0;
+}
+
+isabelEvents::~isabelEvents()
+{
+	end();
+
+	Q_FOREACH(UserEvent *event, events)
+	{
+		delete event;
+	}
+}
+
+void isabelEvents::begin(const std::map<unsigned int, QObject *> &objects, unsigned int max_events)
+{
+	/* a new recording discards the previous one */
+	end();
+
+	Q_FOREACH(UserEvent *event, events)
+	{
+		delete event;
+	}
+
+	events.clear();
+	ids.clear();
+
+	for(std::map<unsigned int, QObject *>::const_iterator iter = objects.begin(); iter != objects.end(); ++iter)
+	{
+		ids.insert(iter->second,iter->first);
+	}
+
+	last_type  = QEvent::None;
+	last_event = NULL;
+	active 	   = true;
+
+	this->max_events = qMax(1U,max_events);
+	this->dropped 	 = 0;
+
+	clock.start();
+	qApp->installEventFilter(this);
+}
+
+void isabelEvents::end(void)
+{
+	if(!active)
+	{
+		return;
+	}
+
+	qApp->removeEventFilter(this);
+	active = false;
+	ids.clear();
+}
+
+void isabelEvents::drain(Response &response)
+{
+	Q_FOREACH(UserEvent *event, events)
+	{
+		response.add_events()->CopyFrom(*event);
+		delete event;
+	}
+
+	events.clear();
+
+	/* the event delivered again to another object is no longer in the list */
+	last_type = QEvent::None;
+
+	response.set_dropped(dropped);
+	dropped = 0;
+}
+
+bool isabelEvents::recording(void)
+{
+	return active;
+}
+
+Response::Error isabelEvents::simulate(const UserEvent &event)
+{
+	QObject *target = object_find(QString::fromUtf8(event.path().c_str()));
+
+	if(NULL == target)
+	{
+		return Response::UNKNOWN_OBJECT_ID;
+	}
+
+	Qt::KeyboardModifiers modifiers = Qt::KeyboardModifiers(event.modifiers());
+	Qt::MouseButtons 	  buttons 	= button_flags(event.buttons());
+	QPoint 				  local(event.xpos(),event.ypos());
+
+	switch(event.type())
+	{
+		case UserEvent::MOUSE_MOVE_ABS:
+		case UserEvent::MOUSE_BUTTON:
+		case UserEvent::MOUSE_WHEEL:
+			{
+				QWindow *window;
+				QPointF  position;
+
+				/* through the window, so it also handles the focus, the popups and the mouse grab */
+				if(!object_window(target,local,window,position))
+				{
+					return Response::NOT_VISIBLE;
+				}
+
+				QPointF screen = window->mapToGlobal(position.toPoint());
+
+				if(UserEvent::MOUSE_MOVE_ABS == event.type())
+				{
+					QMouseEvent move(QEvent::MouseMove,position,screen,Qt::NoButton,buttons,modifiers);
+					QCoreApplication::sendEvent(window,&move);
+				}
+				else if(UserEvent::MOUSE_WHEEL == event.type())
+				{
+					QPoint 			angle(event.wheel_x(),event.wheel_y());
+					bool 			vertical = (0 != angle.y());
+					QWheelEvent 	wheel(position,screen,QPoint(),angle,vertical ? angle.y() : angle.x(),
+										  vertical ? Qt::Vertical : Qt::Horizontal,buttons,modifiers);
+
+					QCoreApplication::sendEvent(window,&wheel);
+				}
+				else
+				{
+					Qt::MouseButton button = ((0 < event.button()) && (event.button() <= MOUSE_BUTTONS)) ? mouse_buttons[event.button() - 1] : Qt::NoButton;
+
+					if(Qt::NoButton == button)
+					{
+						return Response::INVALID_REQUEST;
+					}
+
+					QMouseEvent click(event.press() ? QEvent::MouseButtonPress : QEvent::MouseButtonRelease,
+									  position,screen,button,buttons,modifiers);
+					QCoreApplication::sendEvent(window,&click);
+
+					if(event.press())
+					{
+						/* the double clicks are not recorded, Qt sends them after the second press */
+						if((press_button == event.button()) &&
+						   (pressed.elapsed() < qApp->styleHints()->mouseDoubleClickInterval()) &&
+						   ((screen.toPoint() - press_pos).manhattanLength() < qApp->styleHints()->startDragDistance()))
+						{
+							QMouseEvent twice(QEvent::MouseButtonDblClick,position,screen,button,buttons,modifiers);
+							QCoreApplication::sendEvent(window,&twice);
+
+							press_button = 0;
+						}
+						else
+						{
+							press_button = event.button();
+							press_pos 	 = screen.toPoint();
+							pressed.start();
+						}
+					}
+				}
+			}
+			break;
+
+		case UserEvent::KEYBOARD:
+			{
+				if(!event.has_code())
+				{
+					return Response::INVALID_REQUEST;
+				}
+
+				QKeyEvent key(event.press() ? QEvent::KeyPress : QEvent::KeyRelease,event.code(),modifiers,
+							  QString::fromUtf8(event.text().c_str()));
+
+				QCoreApplication::sendEvent(target,&key);
+			}
+			break;
+
+		case UserEvent::TOUCH:
+			{
+				static QTouchDevice *device = NULL;
+
+				if(NULL == device)
+				{
+					device = new QTouchDevice();
+					device->setType(QTouchDevice::TouchScreen);
+				}
+
+				QList<QTouchEvent::TouchPoint> points;
+				Qt::TouchPointStates 		   states = 0;
+				bool 						   begins = true;
+				bool 						   ends   = true;
+
+				for(int t = 0; t < event.touches_size(); t++)
+				{
+					const TouchPoint 	   &touch = event.touches(t);
+					QTouchEvent::TouchPoint point(touch.id());
+					Qt::TouchPointState 	state;
+
+					switch(touch.state())
+					{
+						case TouchPoint::PRESSED: 	 state = Qt::TouchPointPressed; 	break;
+						case TouchPoint::MOVED: 	 state = Qt::TouchPointMoved; 		break;
+						case TouchPoint::STATIONARY: state = Qt::TouchPointStationary; 	break;
+						default: 					 state = Qt::TouchPointReleased; 	break;
+					}
+
+					point.setState(state);
+					point.setPos(QPointF(touch.xpos(),touch.ypos()));
+
+					points.append(point);
+					states |= state;
+					begins &= (Qt::TouchPointPressed == state);
+					ends   &= (Qt::TouchPointReleased == state);
+				}
+
+				if(points.isEmpty())
+				{
+					return Response::INVALID_REQUEST;
+				}
+
+				QTouchEvent touch(begins ? QEvent::TouchBegin : (ends ? QEvent::TouchEnd : QEvent::TouchUpdate),
+								  device,modifiers,states,points);
+
+				QCoreApplication::sendEvent(target,&touch);
+			}
+			break;
+
+		default:
+			return Response::INVALID_REQUEST;
+	}
+
+	return Response::NO_ERROR;
+}
+
+bool isabelEvents::eventFilter(QObject *receiver, QEvent *event)
+{
+	switch(event->type())
+	{
+		case QEvent::MouseMove:
+		case QEvent::MouseButtonPress:
+		case QEvent::MouseButtonRelease:
+		case QEvent::Wheel:
+		case QEvent::KeyPress:
+		case QEvent::KeyRelease:
+		case QEvent::TouchBegin:
+		case QEvent::TouchUpdate:
+		case QEvent::TouchEnd:
+			break;
+
+		default:
+			return false;
+	}
+
+	/* the windows only forward the events to their widgets and items */
+	if(!receiver->isWidgetType() && !receiver->inherits("QQuickItem"))
+	{
+		return false;
+	}
+
+	QInputEvent *input = static_cast<QInputEvent *>(event);
+
+	/* the same event, delivered to another object since the previous one ignored it. The event
+	   is either the same one, or a copy with the same timestamp for the mouse events, but two
+	   events of the same millisecond, as key repeats, go to the same object. */
+	bool again = !events.empty() && (last_type == event->type()) &&
+				 !last_receiver.isNull() && object_next(last_receiver.data(),receiver) &&
+				 ((last_event == event) || ((0 != input->timestamp()) && (last_time == input->timestamp())));
+
+	UserEvent *recorded = again ? events.back() : new UserEvent();
+
+	if(!again)
+	{
+		uint64_t instant = clock.nsecsElapsed()/1000;
+
+		recorded->set_instant(instant/1000);
+		recorded->set_instant_us(instant);
+	}
+
+	recorded->set_modifiers(input->modifiers());
+
+	switch(event->type())
+	{
+		case QEvent::MouseMove:
+		case QEvent::MouseButtonPress:
+		case QEvent::MouseButtonRelease:
+			{
+				QMouseEvent *mouse = static_cast<QMouseEvent *>(event);
+
+				if(QEvent::MouseMove == event->type())
+				{
+					recorded->set_type(UserEvent::MOUSE_MOVE_ABS);
+				}
+				else
+				{
+					recorded->set_type(UserEvent::MOUSE_BUTTON);
+					recorded->set_press(QEvent::MouseButtonPress == event->type());
+					recorded->set_button(button_number(mouse->button()));
+				}
+
+				recorded->set_xpos(mouse->pos().x());
+				recorded->set_ypos(mouse->pos().y());
+				recorded->set_buttons(button_bitmap(mouse->buttons()));
+			}
+			break;
+
+		case QEvent::Wheel:
+			{
+				QWheelEvent *wheel = static_cast<QWheelEvent *>(event);
+
+				recorded->set_type(UserEvent::MOUSE_WHEEL);
+				recorded->set_xpos(wheel->pos().x());
+				recorded->set_ypos(wheel->pos().y());
+				recorded->set_buttons(button_bitmap(wheel->buttons()));
+				recorded->set_wheel_x(wheel->angleDelta().x());
+				recorded->set_wheel_y(wheel->angleDelta().y());
+			}
+			break;
+
+		case QEvent::KeyPress:
+		case QEvent::KeyRelease:
+			{
+				QKeyEvent *key = static_cast<QKeyEvent *>(event);
+
+				recorded->set_type(UserEvent::KEYBOARD);
+				recorded->set_press(QEvent::KeyPress == event->type());
+				recorded->set_code(key->key());
+				recorded->set_key(QKeySequence(key->key()).toString(QKeySequence::PortableText).toUtf8().constData());
+				recorded->set_text(key->text().toUtf8().constData());
+			}
+			break;
+
+		default:
+			{
+				QTouchEvent *touch = static_cast<QTouchEvent *>(event);
+
+				recorded->set_type(UserEvent::TOUCH);
+				recorded->clear_touches();
+
+				Q_FOREACH(const QTouchEvent::TouchPoint &point, touch->touchPoints())
+				{
+					TouchPoint *touched = recorded->add_touches();
+
+					switch(point.state())
+					{
+						case Qt::TouchPointPressed: 	touched->set_state(TouchPoint::PRESSED); 	break;
+						case Qt::TouchPointMoved: 		touched->set_state(TouchPoint::MOVED); 		break;
+						case Qt::TouchPointStationary: 	touched->set_state(TouchPoint::STATIONARY); break;
+						default: 						touched->set_state(TouchPoint::RELEASED); 	break;
+					}
+
+					touched->set_id(point.id());
+					touched->set_xpos(qRound(point.pos().x()));
+					touched->set_ypos(qRound(point.pos().y()));
+				}
+			}
+			break;
+	}
+
+	set_target(recorded,receiver);
+
+	if(!again)
+	{
+		/* full, the oldest event gives its place to the newest */
+		if(max_events <= events.size())
+		{
+			delete events.front();
+			events.pop_front();
+			dropped++;
+		}
+
+		events.push_back(recorded);
+	}
+
+	last_type 	  = event->type();
+	last_time 	  = input->timestamp();
+	last_event 	  = event;
+	last_receiver = receiver;
+
+	return false;
+}
+
+void isabelEvents::set_target(UserEvent *recorded, QObject *receiver)
+{
+	recorded->set_path(object_path(receiver).toUtf8().constData());
+
+	QHash<QObject *, unsigned int>::const_iterator iter = ids.find(receiver);
+
+	if(ids.end() != iter)
+	{
+		recorded->set_object(iter.value());
+	}
+	else
+	{
+		recorded->clear_object();
+	}
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static QList<QObject *> object_roots(void)
+{
+	QList<QObject *> roots;
+
+	/* the same roots, in the same order, as the object tree */
+	Q_FOREACH(QWidget *widget, QApplication::topLevelWidgets())
+	{
+		roots.append(widget);
+	}
+
+	Q_FOREACH(QWindow *window, QApplication::topLevelWindows())
+	{
+		roots.append(window);
+
+		QQuickView *view = qobject_cast<QQuickView *>(window);
+
+		if((NULL != view) && (NULL != view->rootObject()))
+		{
+			roots.append(view->rootObject());
+		}
+	}
+
+	return roots;
+}
+
+static bool object_next(QObject *previous, QObject *receiver)
+{
+	QQuickItem *item = qobject_cast<QQuickItem *>(previous);
+	QQuickItem *next = qobject_cast<QQuickItem *>(receiver);
+
+	if((NULL != item) && (NULL != next))
+	{
+		return (item != next) && (item->window() == next->window());
+	}
+
+	for(QObject *parent = previous->parent(); NULL != parent; parent = parent->parent())
+	{
+		if(receiver == parent)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static QString object_path(QObject *object)
+{
+	QStringList path;
+
+	while(NULL != object)
+	{
+		QObject 		 *parent   = object->parent();
+		QList<QObject *> siblings = (NULL != parent) ? parent->children() : object_roots();
+
+		if(!object->objectName().isEmpty())
+		{
+			path.prepend(object->objectName());
+		}
+		else
+		{
+			const char *type  = object->metaObject()->className();
+			int 		index = 0;
+
+			Q_FOREACH(QObject *sibling, siblings)
+			{
+				if(sibling == object)
+				{
+					break;
+				}
+
+				if(0 == strcmp(type,sibling->metaObject()->className()))
+				{
+					index++;
+				}
+			}
+
+			path.prepend(QString("%1[%2]").arg(type).arg(index));
+		}
+
+		object = parent;
+	}
+
+	return path.join("/");
+}
+
+static QObject *object_find(const QString &path)
+{
+	QObject *object = NULL;
+	QRegExp  indexed("^(.+)\\[(\\d+)\\]$");
+
+	if(path.isEmpty())
+	{
+		return NULL;
+	}
+
+	Q_FOREACH(const QString &name, path.split("/"))
+	{
+		QList<QObject *> siblings = (NULL != object) ? object->children() : object_roots();
+		QObject 		 *found   = NULL;
+
+		/* first by name, then by class and index */
+		Q_FOREACH(QObject *sibling, siblings)
+		{
+			if(sibling->objectName() == name)
+			{
+				found = sibling;
+				break;
+			}
+		}
+
+		if((NULL == found) && indexed.exactMatch(name))
+		{
+			QByteArray type  = indexed.cap(1).toUtf8();
+			int 	   index = indexed.cap(2).toInt();
+
+			Q_FOREACH(QObject *sibling, siblings)
+			{
+				if(0 == strcmp(type.constData(),sibling->metaObject()->className()))
+				{
+					if(0 == index)
+					{
+						found = sibling;
+						break;
+					}
+
+					index--;
+				}
+			}
+		}
+
+		if(NULL == found)
+		{
+			return NULL;
+		}
+
+		object = found;
+	}
+
+	return object;
+}
+
+static bool object_window(QObject *object, const QPoint &local, QWindow *&window, QPointF &position)
+{
+	QWidget 	*widget = qobject_cast<QWidget *>(object);
+	QQuickItem 	*item 	= qobject_cast<QQuickItem *>(object);
+
+	window = NULL;
+
+	if(NULL != widget)
+	{
+		if(widget->isVisible())
+		{
+			QWidget *top = widget->window();
+
+			window 	 = top->windowHandle();
+			position = widget->mapTo(top,local);
+		}
+	}
+	else if(NULL != item)
+	{
+		if(item->isVisible())
+		{
+			window 	 = item->window();
+			position = item->mapToScene(local);
+		}
+	}
+	else
+	{
+		window 	 = qobject_cast<QWindow *>(object);
+		position = local;
+	}
+
+	return (NULL != window) && window->isVisible();
+}
+
+static unsigned int button_number(Qt::MouseButton button)
+{
+	for(unsigned int b = 0; b < MOUSE_BUTTONS; b++)
+	{
+		if(mouse_buttons[b] == button)
+		{
+			return b + 1;
+		}
+	}
+
+	return 0;
+}
+
+static unsigned int button_bitmap(Qt::MouseButtons buttons)
+{
+	unsigned int bitmap = 0;
+
+	for(unsigned int b = 0; b < MOUSE_BUTTONS; b++)
+	{
+		if((Qt::NoButton != mouse_buttons[b]) && buttons.testFlag(mouse_buttons[b]))
+		{
+			bitmap |= (1 << b);
+		}
+	}
+
+	return bitmap;
+}
+
+static Qt::MouseButtons button_flags(unsigned int bitmap)
+{
+	Qt::MouseButtons buttons = Qt::NoButton;
+
+	for(unsigned int b = 0; b < MOUSE_BUTTONS; b++)
+	{
+		if(bitmap & (1 << b))
+		{
+			buttons |= mouse_buttons[b];
+		}
+	}
+
+	return buttons;
+}
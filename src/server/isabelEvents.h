@@ -0,0 +1,143 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Recording and replay of the user events at the Qt level. Instead of
+   the screen position of the mouse, each event is recorded along with
+   its target object, a widget or a QtQuick item, and the position
+   relative to it. The replay delivers the events to the same object,
+   wherever its window is, so it does not need to search the screen.
+
+   The events are recorded by an event filter installed on the
+   application, which sees each event every time it is delivered. When
+   the target object ignores an event, Qt delivers it again to another
+   object, its parent or the item below it, and the recorded event is
+   updated to the object that finally got it.
+
+   The target object is identified by its path: the object name, or the
+   class name and index among the siblings of the same class, of it and
+   of all of its parents. Unlike the server assigned IDs, the path is the
+   same from one run of the application to the next.
+ */
+#ifndef __ISABEL_EVENTS_H__
+#define __ISABEL_EVENTS_H__
+
+#include <QObject>
+#include <QEvent>
+#include <QHash>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QPoint>
+
+#include <map>
+#include <deque>
+#include <vector>
+
+#include "protocol.pb.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelEvents : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@parent 	the parent QObject
+	*/
+	isabelEvents(QObject *parent);
+
+	/* Class destructor.
+
+		Stops the recording, if any, and releases the events not drained.
+	*/
+	virtual ~isabelEvents();
+
+	/* Begin recording the Qt events.
+
+		@objects 	the current object tree, to find the ID of the target objects
+		@max_events number of events kept until drained, the oldest are dropped first
+	*/
+	void begin(const std::map<unsigned int, QObject *> &objects, unsigned int max_events);
+
+	/* Stop recording the Qt events, those recorded so far are kept until drained.
+	*/
+	void end(void);
+
+	/* Return the events recorded so far, while the recording goes on.
+
+		@response 	where the events, and the number of those dropped, are returned
+	*/
+	void drain(Response &response);
+
+	/* Return true while recording.
+	*/
+	bool recording(void);
+
+	/* Deliver an event to its target object, as recorded by this class.
+
+		@event 		the event to replay, with the path of its target object
+
+		#returns NO_ERROR if successfull, UNKNOWN_OBJECT_ID if the object does
+		 not exist, NOT_VISIBLE if it is not shown, INVALID_REQUEST otherwise
+	*/
+	Response::Error simulate(const UserEvent &event);
+
+	/* Record the user events delivered to the application objects.
+
+		@receiver 	the object the event is delivered to
+		@event 		the event being delivered
+
+		#returns false, the event is always delivered
+	*/
+	bool eventFilter(QObject *receiver, QEvent *event);
+
+private:
+	/* Fill the recorded event with the target object.
+
+		@recorded 	the event to fill
+		@receiver 	the target object
+	*/
+	void set_target(UserEvent *recorded, QObject *receiver);
+
+private:
+	bool 					 active; 	/* true while recording */
+	QElapsedTimer 			 clock; 	/* time since the recording began */
+	QHash<QObject *, unsigned int> ids; /* the ID of each object in the object tree */
+	std::deque<UserEvent *>  events; 	/* the events recorded so far */
+	unsigned int 			 max_events; /* number of events kept until drained */
+	unsigned int 			 dropped; 	/* number of events dropped since the last drain */
+	QEvent::Type 			 last_type; /* type of the last recorded event */
+	unsigned long 			 last_time; /* timestamp of the last recorded event */
+	QEvent 					 *last_event; /* the last recorded event, only compared, never used */
+	QPointer<QObject> 		 last_receiver; /* the object that received the last recorded event */
+	QElapsedTimer 			 pressed; 	/* when replaying, time since the last button press */
+	unsigned int 			 press_button; /* when replaying, the last button pressed, 0 if none */
+	QPoint 					 press_pos; /* when replaying, where the last button was pressed */
+};
+
+#endif
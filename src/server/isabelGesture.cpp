@@ -0,0 +1,299 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelGesture.h"
+
+#include <cmath>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+typedef struct{
+	double x; 		// horizontal position
+	double y; 		// vertical position
+} T_GESTURE_POINT;
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Add an event to the steps.
+
+	@steps 		where the event is added
+	@instant 	when the event happens, in microseconds
+
+	#returns the event, to fill
+*/
+static UserEvent *gesture_event(std::vector<ReplayStep> &steps, uint64_t instant);
+
+/* Decode the next character of an UTF-8 string.
+
+	@text 		the string
+	@position 	offset of the character, moved past it on return
+
+	#returns the code point, -1 if the string is not valid UTF-8
+*/
+static long gesture_utf8(const std::string &text, size_t &position);
+
+/* Return the position along the path.
+
+	@request 	the request, with the waypoints
+	@along 		the distance from the first waypoint to each waypoint
+	@distance 	the distance from the first waypoint, along the path
+
+	#returns the position
+*/
+static T_GESTURE_POINT gesture_point(const Request &request, const std::vector<double> &along, double distance);
+
+/*--------------------- Public Function Definitions ----------------*/
+
+bool gesture_text(const Request &request, const isabelKeymap &keymap, std::vector<ReplayStep> &steps)
+{
+	const std::string &text 	= request.text();
+	uint64_t 		  cadence 	= 1000*(uint64_t)request.cadence();
+	uint64_t 		  instant 	= 0;
+	size_t 			  position 	= 0;
+
+	while(position < text.size())
+	{
+		long 		code = gesture_utf8(text,position);
+		const char *name;
+
+		if(0 > code)
+		{
+			return false;
+		}
+
+		switch(code)
+		{
+			case '\n':
+				name = "Return";
+				break;
+
+			case '\t':
+				name = "Tab";
+				break;
+
+			default:
+				/* whichever key symbol the layout has for the character, legacy or Unicode */
+				name = keymap.character(code);
+				break;
+		}
+
+		if(NULL == name)
+		{
+			return false;
+		}
+
+		UserEvent *press = gesture_event(steps,instant);
+
+		press->set_type(UserEvent::KEYBOARD);
+		press->set_key(name);
+		press->set_press(true);
+
+		/* each key is held for half of the cadence */
+		UserEvent *release = gesture_event(steps,instant + cadence/2);
+
+		release->set_type(UserEvent::KEYBOARD);
+		release->set_key(name);
+		release->set_press(false);
+
+		instant += cadence;
+	}
+
+	return true;
+}
+
+bool gesture_path(const Request &request, std::vector<ReplayStep> &steps)
+{
+	int 				count 	 = request.waypoints_size();
+	uint64_t 			duration = 1000*(uint64_t)request.duration();
+	uint64_t 			interval = 1000*(uint64_t)((0 < request.move_interval()) ? request.move_interval() : 1);
+	std::vector<double> along(1,0);
+
+	if(0 == count)
+	{
+		return false;
+	}
+
+	/* the mouse moves at a constant speed, the time is split by the length of each segment */
+	for(int w = 1; w < count; w++)
+	{
+		double dx = request.waypoints(w).x() - request.waypoints(w - 1).x();
+		double dy = request.waypoints(w).y() - request.waypoints(w - 1).y();
+
+		along.push_back(along.back() + sqrt(dx*dx + dy*dy));
+	}
+
+	int 	  xpos = request.waypoints(0).x();
+	int 	  ypos = request.waypoints(0).y();
+	UserEvent *event = gesture_event(steps,0);
+
+	event->set_type(UserEvent::MOUSE_MOVE_ABS);
+	event->set_xpos(xpos);
+	event->set_ypos(ypos);
+
+	if(0 != request.button())
+	{
+		event = gesture_event(steps,0);
+		event->set_type(UserEvent::MOUSE_BUTTON);
+		event->set_button(request.button());
+		event->set_press(true);
+	}
+
+	for(uint64_t instant = interval; (instant < duration) && (0 < along.back()); instant += interval)
+	{
+		T_GESTURE_POINT point = gesture_point(request,along,along.back()*instant/duration);
+
+		/* the moves that do not reach the next pixel are skipped */
+		if(((int)lround(point.x) == xpos) && ((int)lround(point.y) == ypos))
+		{
+			continue;
+		}
+
+		xpos = lround(point.x);
+		ypos = lround(point.y);
+
+		event = gesture_event(steps,instant);
+		event->set_type(UserEvent::MOUSE_MOVE_ABS);
+		event->set_xpos(xpos);
+		event->set_ypos(ypos);
+	}
+
+	/* the path always ends on the last waypoint */
+	if((request.waypoints(count - 1).x() != xpos) || (request.waypoints(count - 1).y() != ypos))
+	{
+		event = gesture_event(steps,duration);
+		event->set_type(UserEvent::MOUSE_MOVE_ABS);
+		event->set_xpos(request.waypoints(count - 1).x());
+		event->set_ypos(request.waypoints(count - 1).y());
+	}
+
+	if(0 != request.button())
+	{
+		event = gesture_event(steps,duration);
+		event->set_type(UserEvent::MOUSE_BUTTON);
+		event->set_button(request.button());
+		event->set_press(false);
+	}
+
+	return true;
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static UserEvent *gesture_event(std::vector<ReplayStep> &steps, uint64_t instant)
+{
+	steps.push_back(ReplayStep());
+
+	UserEvent *event = steps.back().mutable_event();
+
+	event->set_type(UserEvent::KEYBOARD);
+	event->set_instant(instant/1000);
+	event->set_instant_us(instant);
+
+	return event;
+}
+
+static long gesture_utf8(const std::string &text, size_t &position)
+{
+	unsigned char first = text[position++];
+	long 		  code;
+	int 		  more;
+
+	if(0x80 > first)
+	{
+		return first;
+	}
+	else if(0xC0 == (first & 0xE0))
+	{
+		code = first & 0x1F;
+		more = 1;
+	}
+	else if(0xE0 == (first & 0xF0))
+	{
+		code = first & 0x0F;
+		more = 2;
+	}
+	else if(0xF0 == (first & 0xF8))
+	{
+		code = first & 0x07;
+		more = 3;
+	}
+	else
+	{
+		return -1;
+	}
+
+	for(; 0 < more; more--)
+	{
+		if((position >= text.size()) || (0x80 != (text[position] & 0xC0)))
+		{
+			return -1;
+		}
+
+		code = (code << 6) | (text[position++] & 0x3F);
+	}
+
+	return (0x10FFFF < code) ? -1 : code;
+}
+
+static T_GESTURE_POINT gesture_point(const Request &request, const std::vector<double> &along, double distance)
+{
+	int 			count = request.waypoints_size();
+	int 			s 	  = 0;
+	T_GESTURE_POINT point;
+
+	/* the segment with the position */
+	while((s + 2 < count) && (along[s + 1] < distance))
+	{
+		s++;
+	}
+
+	double length = along[s + 1] - along[s];
+	double u 	  = (0 < length) ? (distance - along[s])/length : 0;
+
+	const Point &p1 = request.waypoints(s);
+	const Point &p2 = request.waypoints(s + 1);
+
+	if(!request.smooth())
+	{
+		point.x = p1.x() + u*(p2.x() - p1.x());
+		point.y = p1.y() + u*(p2.y() - p1.y());
+
+		return point;
+	}
+
+	/* the ends of the path are repeated, so the spline goes through them */
+	const Point &p0 = request.waypoints((0 < s) ? s - 1 : s);
+	const Point &p3 = request.waypoints((s + 2 < count) ? s + 2 : s + 1);
+
+	double u2 = u*u;
+	double u3 = u2*u;
+
+	point.x = 0.5*(2*p1.x() + (p2.x() - p0.x())*u + (2*p0.x() - 5*p1.x() + 4*p2.x() - p3.x())*u2 + (3*p1.x() - p0.x() - 3*p2.x() + p3.x())*u3);
+	point.y = 0.5*(2*p1.y() + (p2.y() - p0.y())*u + (2*p0.y() - 5*p1.y() + 4*p2.y() - p3.y())*u2 + (3*p1.y() - p0.y() - 3*p2.y() + p3.y())*u3);
+
+	return point;
+}
@@ -0,0 +1,73 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Expansion of the high level gestures into the user events the server
+   replays, so the client sends a single request for a whole gesture
+   instead of one for each key or mouse position.
+
+   A text is typed as a press and a release for each character, one
+   character every cadence milliseconds, each key held for half of it.
+   The characters are typed with the key symbol the keyboard layout of
+   the X11 server has for them, so they must be on that layout.
+
+   A mouse path moves the mouse through the waypoints, at a constant
+   speed, with a move every few milliseconds. The path either joins the
+   waypoints with straight lines, or curves through them along a
+   Catmull-Rom spline. A mouse button can be held along the path, to
+   drag something from the first waypoint to the last one.
+ */
+#ifndef __ISABEL_GESTURE_H__
+#define __ISABEL_GESTURE_H__
+
+#include <vector>
+
+#include "protocol.pb.h"
+#include "isabelKeymap.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+/*--------------------- Public Function Declarations ----------------*/
+
+/* Expand a text into the key presses that type it.
+
+	@request 	the TYPE_TEXT request, with the text and the cadence
+	@keymap 	the keyboard mapping, to find the key symbol of each character
+	@steps 		where the key presses and releases are added
+
+	#returns true if successfull, false if the text is not valid UTF-8
+	 or one of its characters is not on the keyboard layout
+*/
+bool gesture_text(const Request &request, const isabelKeymap &keymap, std::vector<ReplayStep> &steps);
+
+/* Expand a path into the mouse moves along it.
+
+	@request 	the POINTER_PATH request, with the waypoints, the duration,
+				the time between moves, the mouse button and the interpolation
+	@steps 		where the mouse moves, and button presses, are added
+
+	#returns true if successfull, false if there are no waypoints
+*/
+bool gesture_path(const Request &request, std::vector<ReplayStep> &steps);
+
+#endif
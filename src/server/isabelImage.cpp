@@ -0,0 +1,613 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelImage.h"
+#include "isabelPixels.h"
+#include "isabelX11.h"
+
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QGuiApplication>
+#include <QBuffer>
+#include <QScreen>
+#include <QTimer>
+#include <QPixmap>
+
+#include <QtWidgets/QWidget>
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickWindow>
+
+#include <cstring>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+static QPointer<isabelX11> grab_x11; 	/* grabs the windows through shared memory, if set */
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Return the part of the rectangle to grab.
+
+	@bounds 	the rectangle of the widget, window or item
+	@region 	the region to grab, relative to the bounds, or a null rectangle
+
+	#returns the region to grab, clipped to the bounds, it is empty if there is nothing to grab
+*/
+static QRect grab_area(const QRect &bounds, const QRect &region);
+
+/* Return the image as 32 bits per pixel, converting it only if necessary.
+
+	@image 	the image to convert
+
+	#returns the image in either Format_RGB32 or Format_ARGB32
+*/
+static QImage image_argb32(const QImage &image);
+
+/*--------------------- Public Function Definitions ----------------*/
+
+void grab_set_x11(isabelX11 *x11)
+{
+	grab_x11 = x11;
+}
+
+bool grab_window(T_SHOT &shot, WId win_id, const QRect &region)
+{
+	/* the shared memory grab does not send the pixels over the X11 socket */
+	if(!grab_x11.isNull() && grab_x11->grab_window(shot.image,shot.position,win_id,region))
+	{
+		return true;
+	}
+
+	/* platform indepent way of taking a screenshot of the whole screen */
+	QScreen *screen = QGuiApplication::primaryScreen();
+
+	if(NULL == screen)
+	{
+		return false;
+	}
+
+	QPoint origin(0,0);
+
+	/* without the X11 client, the position is only known for the whole screen */
+	if(!grab_x11.isNull())
+	{
+		grab_x11->window_origin(origin,win_id);
+	}
+
+	if(region.isNull())
+	{
+		shot.image 	  = screen->grabWindow(win_id).toImage();
+		shot.position = origin;
+	}
+	else
+	{
+		shot.image 	  = screen->grabWindow(win_id,region.x(),region.y(),region.width(),region.height()).toImage();
+		shot.position = origin + region.topLeft();
+	}
+
+	return !shot.image.isNull();
+}
+
+bool grab_screen(T_SHOT &shot, QScreen *screen)
+{
+	QScreen *primary = QGuiApplication::primaryScreen();
+
+	/* the screens of a virtual desktop share the same root window */
+	if((NULL != primary) && primary->virtualSiblings().contains(screen))
+	{
+		return grab_window(shot,0,screen->geometry());
+	}
+
+	shot.image 	  = screen->grabWindow(0).toImage();
+	shot.position = screen->geometry().topLeft();
+
+	return !shot.image.isNull();
+}
+
+bool grab_object(T_SHOT &shot, QObject *object, const QRect &region)
+{
+	QWidget 	 *widget = qobject_cast<QWidget*>(object);
+	QQuickItem 	 *item 	 = qobject_cast<QQuickItem*>(object);
+	QWindow 	 *window = qobject_cast<QWindow*>(object);
+	QRect 		 area;
+
+	if(NULL != widget)
+	{
+		/* the widget renders itself, there is no need to grab the screen */
+		area = grab_area(widget->rect(),region);
+
+		if(!widget->isVisible() || area.isEmpty())
+		{
+			return false;
+		}
+
+		shot.image 	  = widget->grab(area).toImage();
+		shot.position = widget->mapToGlobal(area.topLeft());
+	}
+	else if(NULL != item)
+	{
+		QQuickWindow *quick = item->window();
+
+		if((NULL == quick) || !item->isVisible())
+		{
+			return false;
+		}
+
+		/* the scene is rendered as a whole, and then cropped to the item */
+		QRect bounds = item->mapRectToScene(QRectF(0,0,item->width(),item->height())).toAlignedRect();
+
+		area = region.isNull() ? bounds : (bounds & region.translated(bounds.topLeft()));
+		area = area & QRect(QPoint(0,0),quick->size());
+
+		if(area.isEmpty())
+		{
+			return false;
+		}
+
+		qreal ratio = quick->devicePixelRatio();
+		QRect pixels(area.topLeft()*ratio,area.size()*ratio);
+
+		shot.image 	  = quick->grabWindow().copy(pixels);
+		shot.position = quick->mapToGlobal(area.topLeft());
+	}
+	else if(NULL != window)
+	{
+		area = grab_area(QRect(QPoint(0,0),window->size()),region);
+
+		if(!window->isVisible() || area.isEmpty())
+		{
+			return false;
+		}
+
+		QQuickWindow *quick = qobject_cast<QQuickWindow*>(window);
+
+		if(NULL != quick)
+		{
+			qreal ratio = quick->devicePixelRatio();
+			QRect pixels(area.topLeft()*ratio,area.size()*ratio);
+
+			shot.image = quick->grabWindow().copy(pixels);
+		}
+		else if(!grab_window(shot,window->winId(),area))
+		{
+			return false;
+		}
+
+		shot.position = window->mapToGlobal(area.topLeft());
+	}
+	else
+	{
+		return false;
+	}
+
+	return !shot.image.isNull();
+}
+
+QList<T_SHOT> image_changed_tiles(const T_SHOT &shot, int tile, std::vector<uint64_t> &hashes)
+{
+	QList<T_SHOT> 	 tiles;
+	std::vector<int> changed;
+
+	/* the hash works on any 32 bits per pixel format, as those returned by the grabs */
+	QImage image = (32 == shot.image.depth()) ? shot.image : shot.image.convertToFormat(QImage::Format_ARGB32);
+
+	int columns = pixels_changed_tiles(image.constBits(),image.bytesPerLine(),image.width(),image.height(),tile,hashes,changed);
+
+	for(unsigned int t = 0; t < changed.size(); t++)
+	{
+		/* the tiles share the pixels, the copy is done when encoding */
+		T_SHOT part = shot;
+
+		part.image 	  = image;
+		part.area 	  = QRect((changed[t] % columns)*tile,(changed[t] / columns)*tile,tile,tile) & image.rect();
+		part.position = part.area.topLeft();
+
+		tiles.append(part);
+	}
+
+	return tiles;
+}
+
+uint64_t image_hash(const T_SHOT &shot)
+{
+	/* same pixel layout as the tiles */
+	QImage image = (32 == shot.image.depth()) ? shot.image : shot.image.convertToFormat(QImage::Format_ARGB32);
+
+	return pixels_hash(image.constBits(),image.bytesPerLine(),image.width(),image.height());
+}
+
+Response image_digest(const T_SHOT &shot)
+{
+	Response 		   result;
+	Digest 			   *digest = result.mutable_digest();
+	QCryptographicHash sha256(QCryptographicHash::Sha256);
+
+	QImage 	   image = image_argb32(shot.image);
+	QByteArray row(image.width()*4,0);
+
+	/* the alpha is ignored, it is not always set by the grabs */
+	for(int y = 0; y < image.height(); y++)
+	{
+		const uint32_t *pixels = (const uint32_t *)image.constScanLine(y);
+		uint32_t 		*opaque = (uint32_t *)row.data();
+
+		for(int x = 0; x < image.width(); x++)
+		{
+			opaque[x] = pixels[x] | 0xFF000000;
+		}
+
+		sha256.addData(row);
+	}
+
+	QByteArray hash = sha256.result();
+
+	digest->set_sha256(hash.constData(),hash.size());
+	digest->set_dhash(pixels_dhash(image.constBits(),image.bytesPerLine(),image.width(),image.height()));
+	digest->set_phash(pixels_phash(image.constBits(),image.bytesPerLine(),image.width(),image.height()));
+
+	Rect *bounds = digest->mutable_bounds();
+
+	bounds->set_x(shot.position.x());
+	bounds->set_y(shot.position.y());
+	bounds->set_width(image.width());
+	bounds->set_height(image.height());
+
+	result.set_error(Response::NO_ERROR);
+
+	return result;
+}
+
+QImage image_decode(const Image &image)
+{
+	QImage decoded;
+
+	switch(image.encoding())
+	{
+		case Image::PNG:
+		case Image::JPEG:
+			decoded = QImage::fromData((const uchar *)image.data().data(),image.data().size());
+			break;
+
+		case Image::RAW:
+			/* the size is not in the pixels, so it must be given, and match them */
+			if(image.has_width() && image.has_height() && (0 < image.width()) && (0 < image.height()) &&
+			   (image.data().size() == (uint64_t)image.width()*image.height()*4))
+			{
+				/* the copy detaches the image from the request */
+				decoded = QImage((const uchar *)image.data().data(),image.width(),image.height(),
+								 image.width()*4,QImage::Format_ARGB32).copy();
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	return decoded;
+}
+
+Response image_find(const T_SHOT &shot, const QImage &needle, int count)
+{
+	Response result;
+
+	std::vector<T_MATCH> matches;
+
+	QImage haystack = image_argb32(shot.image);
+	QImage pin 		= image_argb32(needle);
+
+	pixels_find(haystack.constBits(),haystack.bytesPerLine(),haystack.width(),haystack.height(),
+				pin.constBits(),pin.bytesPerLine(),pin.width(),pin.height(),count,matches);
+
+	/* the worst possible difference, all channels of all pixels */
+	double worst = 3.0*255.0*pin.width()*pin.height();
+
+	for(unsigned int m = 0; m < matches.size(); m++)
+	{
+		Match *match = result.add_matches();
+
+		match->set_x(shot.position.x() + matches[m].x);
+		match->set_y(shot.position.y() + matches[m].y);
+		match->set_width(pin.width());
+		match->set_height(pin.height());
+		match->set_score(1.0 - matches[m].sad/worst);
+	}
+
+	result.set_error(Response::NO_ERROR);
+
+	return result;
+}
+
+Response image_compare(const T_SHOT &shot, const QImage &baseline, const Comparison &comparison, const ImageFormat &format)
+{
+	Response result;
+
+	QImage first  = image_argb32(shot.image);
+	QImage second = image_argb32(baseline);
+	int    width  = first.width();
+	int    height = first.height();
+
+	/* the ignored regions are marked, pixel by pixel */
+	std::vector<uint8_t> ignore;
+
+	if(0 < comparison.ignore_size())
+	{
+		ignore.assign(width*height,0);
+
+		for(int i = 0; i < comparison.ignore_size(); i++)
+		{
+			const Rect &region = comparison.ignore(i);
+			QRect area = QRect(region.x(),region.y(),region.width(),region.height()) & first.rect();
+
+			for(int y = area.top(); y <= area.bottom(); y++)
+			{
+				memset(&ignore[y*width + area.left()],1,area.width());
+			}
+		}
+	}
+
+	std::vector<uint8_t> mismatches(comparison.diff_image() ? width*height : 0);
+	T_DIFFERENCE 		 difference;
+
+	pixels_compare(first.constBits(),first.bytesPerLine(),second.constBits(),second.bytesPerLine(),
+				   width,height,comparison.tolerance(),ignore.empty() ? NULL : &ignore[0],
+				   difference,mismatches.empty() ? NULL : &mismatches[0]);
+
+	Difference *found = result.mutable_difference();
+	found->set_mismatches(difference.count);
+
+	if(0 < difference.count)
+	{
+		Rect *bounds = found->mutable_bounds();
+
+		bounds->set_x(difference.left);
+		bounds->set_y(difference.top);
+		bounds->set_width(difference.right - difference.left + 1);
+		bounds->set_height(difference.bottom - difference.top + 1);
+	}
+
+	if(comparison.diff_image())
+	{
+		/* the pixels that differ are red, the others are a darker copy of the screenshot */
+		QImage diff(width,height,QImage::Format_RGB32);
+
+		for(int y = 0; y < height; y++)
+		{
+			const QRgb *source = (const QRgb *)first.constScanLine(y);
+			QRgb 	   *target = (QRgb *)diff.scanLine(y);
+
+			for(int x = 0; x < width; x++)
+			{
+				target[x] = mismatches[y*width + x] ? qRgb(255,0,0) : (0xFF000000 | ((source[x] >> 2) & 0x3F3F3F));
+			}
+		}
+
+		QByteArray data  = image_encode(diff,format.encoding(),format.quality());
+		Image 	   *image = result.add_images();
+
+		image->set_encoding(format.encoding());
+		image->set_width(width);
+		image->set_height(height);
+		image->set_xpos(shot.position.x());
+		image->set_ypos(shot.position.y());
+		image->set_data(data.constData(),data.size());
+	}
+
+	result.set_error(Response::NO_ERROR);
+
+	return result;
+}
+
+Image image_encode_shot(const T_SHOT &shot)
+{
+	Image  image;
+	QImage pixels = shot.area.isNull() ? shot.image : shot.image.copy(shot.area);
+
+	QByteArray data = image_encode(pixels,(Image::Encoding)shot.encoding,shot.quality);
+
+	image.set_encoding((Image::Encoding)shot.encoding);
+	image.set_width(pixels.width());
+	image.set_height(pixels.height());
+	image.set_xpos(shot.position.x());
+	image.set_ypos(shot.position.y());
+	image.set_data(data.constData(),data.size());
+
+	return image;
+}
+
+QByteArray image_encode(const QImage &image, Image::Encoding encoding, int quality)
+{
+	QByteArray blob;
+
+	switch(encoding)
+	{
+		case Image::PNG:
+		case Image::JPEG:
+			{
+				QBuffer buffer(&blob);
+				buffer.open(QIODevice::WriteOnly);
+				image.save(&buffer,(Image::PNG == encoding) ? "PNG" : "JPG",quality);
+			}
+			break;
+
+		case Image::RAW:
+			{
+				/* 32 bits rows are never padded, so the pixels can be copied at once */
+				QImage argb = image_argb32(image);
+				blob = QByteArray((const char *)argb.constBits(),argb.byteCount());
+			}
+			break;
+
+		case Image::QOI:
+			blob = qoi_encode(image);
+			break;
+
+		default:
+			break;
+	}
+
+	return blob;
+}
+
+QByteArray qoi_encode(const QImage &image)
+{
+	QImage argb = image_argb32(image);
+
+	QByteArray output(pixels_qoi_size(argb.width(),argb.height()),Qt::Uninitialized);
+
+	size_t size = pixels_qoi(argb.constBits(),argb.bytesPerLine(),argb.width(),argb.height(),
+							 QImage::Format_RGB32 == argb.format(),(uint8_t *)output.data());
+
+	output.resize(size);
+
+	return output;
+}
+
+/*--------------------- Public Class Definitions -------------------*/
+
+isabelEncode::isabelEncode(QTcpSocket *client, QObject *parent)
+: QObject(parent)
+{
+	socket = client;
+	legacy = false;
+
+	connect(&watcher,SIGNAL(finished()),this,SLOT(encoded()));
+}
+
+void isabelEncode::start(const QList<T_SHOT> &shots, bool legacy, const Response &partial)
+{
+	this->legacy = legacy;
+
+	result.MergeFrom(partial);
+
+	if(shots.isEmpty())
+	{
+		/* nothing changed since the previous delta screenshot */
+		QTimer::singleShot(0,this,SLOT(encoded()));
+	}
+	else
+	{
+		watcher.setFuture(QtConcurrent::mapped(shots,image_encode_shot));
+	}
+}
+
+void isabelEncode::set_frame(const QRect &frame, bool key_frame)
+{
+	Rect *geometry = result.mutable_frame();
+
+	geometry->set_x(frame.x());
+	geometry->set_y(frame.y());
+	geometry->set_width(frame.width());
+	geometry->set_height(frame.height());
+
+	result.set_key_frame(key_frame);
+}
+
+QTcpSocket *isabelEncode::client(void)
+{
+	return socket.data();
+}
+
+const Response &isabelEncode::response(void)
+{
+	return result;
+}
+
+void isabelEncode::encoded(void)
+{
+	QList<Image> images = watcher.future().results();
+
+	if(legacy && !images.isEmpty())
+	{
+		result.set_image(images[0].data());
+	}
+	else
+	{
+		Q_FOREACH(const Image &image, images)
+		{
+			result.add_images()->CopyFrom(image);
+		}
+	}
+
+	result.set_error(Response::NO_ERROR);
+
+	emit finished();
+}
+
+isabelTask::isabelTask(QTcpSocket *client, QObject *parent)
+: QObject(parent)
+{
+	socket = client;
+
+	connect(&watcher,SIGNAL(finished()),this,SIGNAL(finished()));
+}
+
+void isabelTask::start(const QFuture<Response> &future, const Response &partial)
+{
+	this->partial.CopyFrom(partial);
+
+	watcher.setFuture(future);
+}
+
+QTcpSocket *isabelTask::client(void)
+{
+	return socket.data();
+}
+
+Response isabelTask::response(void)
+{
+	Response result(partial);
+
+	result.MergeFrom(watcher.result());
+
+	return result;
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static QRect grab_area(const QRect &bounds, const QRect &region)
+{
+	if(region.isNull())
+	{
+		return bounds;
+	}
+	else
+	{
+		return bounds & region;
+	}
+}
+
+static QImage image_argb32(const QImage &image)
+{
+	if((QImage::Format_RGB32 == image.format()) || (QImage::Format_ARGB32 == image.format()))
+	{
+		return image;
+	}
+	else
+	{
+		return image.convertToFormat(QImage::Format_ARGB32);
+	}
+}
@@ -0,0 +1,289 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Grabbing and encoding of the screenshots. Grabbing the screen must be
+   done in the GUI thread, but the encoding is done in the Qt thread pool,
+   so the application under test is only blocked while grabbing.
+
+   Screenshots can be limited to a region, or to a single widget, window
+   or QtQuick item, so only the pixels of interest are grabbed and encoded.
+   They can also be split in tiles, and only the tiles that changed since
+   the previous screenshot are encoded.
+
+   Images uploaded by the client can be searched for on the screen, or
+   compared against a screenshot, which also runs in the thread pool.
+
+   Windows are grabbed through the X11 shared memory, when available,
+   since it is much faster than QScreen::grabWindow().
+
+   Besides the formats supported by Qt, this module implements the
+   "Quite OK Image" format (QOI), see: https://qoiformat.org/
+ */
+#ifndef __ISABEL_IMAGE_H__
+#define __ISABEL_IMAGE_H__
+
+#include <QObject>
+#include <QPointer>
+#include <QTcpSocket>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QByteArray>
+#include <QList>
+#include <QPoint>
+#include <QRect>
+#include <QWindow>
+#include <QScreen>
+
+#include <vector>
+
+#include "protocol.pb.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+class isabelX11;
+
+typedef struct{
+	QImage 	image; 		// the grabbed pixels
+	QPoint  position; 	// position of the image on the screen
+	int 	encoding; 	// how to encode the image, one of Image::Encoding
+	int 	quality; 	// the quality, as in QImage::save
+	QRect 	area; 		// the part of the image to encode, a null rectangle for all of it
+} T_SHOT;
+
+/*--------------------- Public Function Declarations ----------------*/
+
+/* Select the X11 client used to grab the windows through shared memory.
+
+	@x11 		the X11 client, NULL to always use QScreen::grabWindow()
+*/
+void grab_set_x11(isabelX11 *x11);
+
+/* Grab a region of a X11 window, or of the whole screen.
+
+	@shot 		where the grabbed image, and its position on the screen, are returned
+	@win_id 	the X11 window identifier, use 0 for the whole screen
+	@region 	the region to grab, relative to the window, use a null rectangle to grab all of it
+
+	#returns true if successfull, false otherwise
+*/
+bool grab_window(T_SHOT &shot, WId win_id, const QRect &region);
+
+/* Grab one of the screens, as listed by QGuiApplication::screens().
+
+	@shot 		where the grabbed image, and its position on the virtual desktop, are returned
+	@screen 	the screen to grab
+
+	#returns true if successfull, false otherwise
+*/
+bool grab_screen(T_SHOT &shot, QScreen *screen);
+
+/* Grab a region of a widget, window or QtQuick item.
+
+	@shot 		where the grabbed image, and its position, are returned
+	@object 	the object to grab
+	@region 	the region to grab, relative to the object, use a null rectangle to grab all of it
+
+	#returns true if successfull, false if the object is not shown or has no geometry
+*/
+bool grab_object(T_SHOT &shot, QObject *object, const QRect &region);
+
+/* Split the screenshot in tiles and return those that changed.
+
+	@shot 		the screenshot to split
+	@tile 		the size of the square tiles, in pixels
+	@hashes 	the hashes of the tiles of the previous screenshot, replaced by those
+				of this screenshot. If empty, all of the tiles are returned.
+
+	#returns the tiles that changed, their position is relative to the screenshot
+*/
+QList<T_SHOT> image_changed_tiles(const T_SHOT &shot, int tile, std::vector<uint64_t> &hashes);
+
+/* Compute the hash of all of the screenshot pixels.
+
+	@shot 		the screenshot to hash
+
+	#returns the 64 bits hash of the pixels
+*/
+uint64_t image_hash(const T_SHOT &shot);
+
+/* Compute the digest of the screenshot: its SHA-256, and its perceptual hashes.
+
+	@shot 		the screenshot to digest
+
+	#returns the response with the digest
+*/
+Response image_digest(const T_SHOT &shot);
+
+/* Decode an image sent by the client.
+
+	@image 		the encoded image, either PNG, JPEG or raw pixels
+
+	#returns the decoded image, a null image in case of error
+*/
+QImage image_decode(const Image &image);
+
+/* Search for the needle in a screenshot.
+
+	@shot 		the screenshot where to search
+	@needle 	the image to search for
+	@count 		maximum number of locations to return
+
+	#returns the response with the best locations, in screen coordinates
+*/
+Response image_find(const T_SHOT &shot, const QImage &needle, int count);
+
+/* Compare a screenshot against an image of the same size.
+
+	@shot 		 the screenshot to compare
+	@baseline 	 the image to compare against
+	@comparison  the tolerance, and the regions to ignore
+	@format 	 how to encode the image with the differences, if requested
+
+	#returns the response with the number of pixels that differ, and their bounding box
+*/
+Response image_compare(const T_SHOT &shot, const QImage &baseline, const Comparison &comparison, const ImageFormat &format);
+
+/* Encode the screenshot, or the part of it selected by its area.
+
+	@shot 		the screenshot to encode
+
+	#returns the encoded image, with its position on the screen
+*/
+Image image_encode_shot(const T_SHOT &shot);
+
+/* Encode the image.
+
+	@image 		the image to encode
+	@encoding 	the image encoding
+	@quality 	the encoding quality, as in QImage::save, ignored by the lossless raw and QOI
+
+	#returns the encoded image, empty in case of error
+*/
+QByteArray image_encode(const QImage &image, Image::Encoding encoding, int quality);
+
+/* Encode the image using the QOI format.
+
+	@image 		the image to encode
+
+	#returns the QOI encoded image
+*/
+QByteArray qoi_encode(const QImage &image);
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelEncode : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@parent 	the parent QObject
+	*/
+	isabelEncode(QTcpSocket *client, QObject *parent);
+
+	/* Encode the screenshots, in parallel, in the Qt thread pool.
+
+		@shots 		the screenshots to encode
+		@legacy 	if true, return the first screenshot in the field image, as
+					done before the client could select the format
+		@partial 	the fields of the response already known, sent along with the screenshots
+
+		The signal finished() is emitted once all screenshots are encoded.
+	*/
+	void start(const QList<T_SHOT> &shots, bool legacy, const Response &partial);
+
+	/* Describe the whole screenshot, when only some tiles of it are encoded.
+
+		@frame 		the geometry of the whole screenshot
+		@key_frame 	true if all of the tiles are encoded
+	*/
+	void set_frame(const QRect &frame, bool key_frame);
+
+	/* Return the client connection, NULL if it was already closed.
+	*/
+	QTcpSocket *client(void);
+
+	/* Return the response to send to the client, valid after finished().
+	*/
+	const Response &response(void);
+
+Q_SIGNALS:
+	void finished(void);	/* emitted once all of the screenshots are encoded */
+
+private slots:
+	/* Collect the encoded screenshots.
+	 */
+	void encoded(void);
+
+private:
+	QPointer<QTcpSocket>  socket;	/* the client connection */
+	QFutureWatcher<Image> watcher; 	/* follows the encoding in the thread pool */
+	Response 			  result; 	/* the response to send to the client */
+	bool 				  legacy; 	/* if true, the response uses the field image */
+};
+
+class isabelTask : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@parent 	the parent QObject
+	*/
+	isabelTask(QTcpSocket *client, QObject *parent);
+
+	/* Follow the computation of the response, in the thread pool.
+
+		@future 	the response being computed
+		@partial 	the fields of the response already known, merged with the computed ones
+
+		The signal finished() is emitted once the response is ready.
+	*/
+	void start(const QFuture<Response> &future, const Response &partial);
+
+	/* Return the client connection, NULL if it was already closed.
+	*/
+	QTcpSocket *client(void);
+
+	/* Return the response to send to the client, valid after finished().
+	*/
+	Response response(void);
+
+Q_SIGNALS:
+	void finished(void);	/* emitted once the response is ready */
+
+private:
+	QPointer<QTcpSocket> 	 socket;	/* the client connection */
+	QFutureWatcher<Response> watcher; 	/* follows the computation in the thread pool */
+	Response 				 partial; 	/* the fields of the response known before the computation */
+};
+
+#endif
@@ -0,0 +1,439 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelJournal.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+#define JOURNAL_HEADER 		(9)			/* size of the magic and the version */
+#define JOURNAL_TYPE_MASK 	(0x07)		/* bits of the header byte with the event type */
+#define JOURNAL_PRESS 		(0x08)		/* bit of the header byte set for presses */
+#define JOURNAL_NEW_KEY 	(0x10)		/* bit of the header byte set when a new key name follows */
+#define JOURNAL_JITTER 		(0x20)		/* bit of the header byte set when the sampling jitter follows */
+#define JOURNAL_FLUSH_SIZE 	(64*1024)	/* the events are written once they take this many bytes */
+
+/* the event types, as in UserEvent::Type, which this module does not depend on */
+#define JOURNAL_KEYBOARD 	(0)
+#define JOURNAL_MOVE_REL 	(1)
+#define JOURNAL_MOVE_ABS 	(2)
+#define JOURNAL_BUTTON 		(3)
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Append a varint to a buffer.
+
+	@buffer 	the buffer
+	@value 		the value to append
+*/
+static void journal_varint(std::vector<uint8_t> &buffer, uint64_t value);
+
+/* Append a signed value to a buffer, as a zigzag encoded varint.
+
+	@buffer 	the buffer
+	@value 		the value to append
+*/
+static void journal_zigzag(std::vector<uint8_t> &buffer, int32_t value);
+
+/*--------------------- Public Class Definitions -------------------*/
+
+isabelJournalWriter::isabelJournalWriter()
+{
+	file   = NULL;
+	last   = 0;
+	count  = 0;
+	failed = false;
+}
+
+isabelJournalWriter::~isabelJournalWriter()
+{
+	close();
+}
+
+bool isabelJournalWriter::open(const char *path)
+{
+	close();
+
+	file = fopen(path,"wb");
+
+	if(NULL == file)
+	{
+		return false;
+	}
+
+	buffer.clear();
+	keys.clear();
+
+	last   = 0;
+	count  = 0;
+	failed = false;
+
+	buffer.insert(buffer.end(),JOURNAL_MAGIC,JOURNAL_MAGIC + strlen(JOURNAL_MAGIC));
+	buffer.push_back(JOURNAL_VERSION);
+
+	return flush();
+}
+
+void isabelJournalWriter::write(const T_USER_EVENT &event, const char *key)
+{
+	uint8_t header = (event.type & JOURNAL_TYPE_MASK) | (event.press ? JOURNAL_PRESS : 0) | (event.jitter ? JOURNAL_JITTER : 0);
+	size_t 	start  = buffer.size();
+
+	buffer.push_back(header);
+
+	/* the events are recorded in order, a step back is taken as no time at all */
+	if(event.instant > last)
+	{
+		journal_varint(buffer,event.instant - last);
+		last = event.instant;
+	}
+	else
+	{
+		journal_varint(buffer,0);
+	}
+
+	if(0 != event.jitter)
+	{
+		journal_zigzag(buffer,event.jitter);
+	}
+
+	switch(event.type)
+	{
+		case JOURNAL_MOVE_REL:
+		case JOURNAL_MOVE_ABS:
+			journal_zigzag(buffer,event.xpos);
+			journal_zigzag(buffer,event.ypos);
+			break;
+
+		case JOURNAL_BUTTON:
+			journal_varint(buffer,event.code);
+			break;
+
+		case JOURNAL_KEYBOARD:
+			{
+				std::string 							 name((NULL != key) ? key : "");
+				std::map<std::string,uint32_t>::iterator iter = keys.find(name);
+
+				if(keys.end() == iter)
+				{
+					/* the first time the key is seen, its name goes in the dictionary */
+					buffer[start] |= JOURNAL_NEW_KEY;
+
+					journal_varint(buffer,name.size());
+					buffer.insert(buffer.end(),name.begin(),name.end());
+
+					keys.insert(std::pair<std::string,uint32_t>(name,keys.size()));
+				}
+				else
+				{
+					journal_varint(buffer,iter->second);
+				}
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	count++;
+
+	if(JOURNAL_FLUSH_SIZE <= buffer.size())
+	{
+		flush();
+	}
+}
+
+bool isabelJournalWriter::flush(void)
+{
+	if(NULL == file)
+	{
+		return false;
+	}
+
+	if(!buffer.empty())
+	{
+		if(buffer.size() != fwrite(&buffer[0],1,buffer.size(),file))
+		{
+			failed = true;
+		}
+
+		buffer.clear();
+	}
+
+	/* what was recorded so far survives a crash of the application */
+	if(0 != fflush(file))
+	{
+		failed = true;
+	}
+
+	return !failed;
+}
+
+bool isabelJournalWriter::close(void)
+{
+	if(NULL == file)
+	{
+		return !failed;
+	}
+
+	flush();
+
+	if(0 != fclose(file))
+	{
+		failed = true;
+	}
+
+	file = NULL;
+
+	return !failed;
+}
+
+uint32_t isabelJournalWriter::events(void)
+{
+	return count;
+}
+
+isabelJournalReader::isabelJournalReader()
+{
+	data 	 = NULL;
+	size 	 = 0;
+	position = 0;
+	last 	 = 0;
+	version  = 0;
+}
+
+isabelJournalReader::~isabelJournalReader()
+{
+	close();
+}
+
+bool isabelJournalReader::open(const char *path)
+{
+	struct stat info;
+	int 		fd;
+
+	close();
+
+	fd = ::open(path,O_RDONLY);
+
+	if(0 > fd)
+	{
+		return false;
+	}
+
+	if((0 != fstat(fd,&info)) || (JOURNAL_HEADER > info.st_size))
+	{
+		::close(fd);
+		return false;
+	}
+
+	void *mapped = mmap(NULL,info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+
+	/* the mapping stays valid once the file is closed */
+	::close(fd);
+
+	if(MAP_FAILED == mapped)
+	{
+		return false;
+	}
+
+	data = (const uint8_t *)mapped;
+	size = info.st_size;
+
+	version = data[JOURNAL_HEADER - 1];
+
+	if((0 != memcmp(data,JOURNAL_MAGIC,strlen(JOURNAL_MAGIC))) || (1 > version) || (JOURNAL_VERSION < version))
+	{
+		close();
+		return false;
+	}
+
+	/* the events are read in order, so the kernel can read ahead */
+	madvise(mapped,size,MADV_SEQUENTIAL);
+
+	rewind();
+
+	return true;
+}
+
+void isabelJournalReader::close(void)
+{
+	if(NULL != data)
+	{
+		munmap((void *)data,size);
+	}
+
+	data 	 = NULL;
+	size 	 = 0;
+	position = 0;
+	last 	 = 0;
+	version  = 0;
+
+	names.clear();
+}
+
+void isabelJournalReader::rewind(void)
+{
+	position = JOURNAL_HEADER;
+	last 	 = 0;
+
+	/* the dictionary is built again, as the events are decoded */
+	names.clear();
+}
+
+bool isabelJournalReader::next(T_USER_EVENT &event)
+{
+	size_t 	 start = position;
+	uint64_t value;
+
+	if((NULL == data) || (position >= size))
+	{
+		return false;
+	}
+
+	uint8_t header = data[position++];
+
+	event = T_USER_EVENT();
+	event.type 	= header & JOURNAL_TYPE_MASK;
+	event.press = (header & JOURNAL_PRESS) ? 1 : 0;
+
+	bool complete = varint(value);
+
+	/* the first version has the time in milliseconds */
+	event.instant = last + ((1 == version) ? 1000*value : value);
+
+	if(header & JOURNAL_JITTER)
+	{
+		uint64_t jitter = 0;
+
+		complete 	 = complete && varint(jitter);
+		event.jitter = (int32_t)((jitter >> 1) ^ (~(jitter & 1) + 1));
+	}
+
+	switch(event.type)
+	{
+		case JOURNAL_MOVE_REL:
+		case JOURNAL_MOVE_ABS:
+			{
+				uint64_t x = 0;
+				uint64_t y = 0;
+
+				complete = complete && varint(x) && varint(y);
+
+				event.xpos = (int32_t)((x >> 1) ^ (~(x & 1) + 1));
+				event.ypos = (int32_t)((y >> 1) ^ (~(y & 1) + 1));
+			}
+			break;
+
+		case JOURNAL_BUTTON:
+			complete   = complete && varint(value);
+			event.code = (uint32_t)value;
+			break;
+
+		case JOURNAL_KEYBOARD:
+			if(header & JOURNAL_NEW_KEY)
+			{
+				complete = complete && varint(value) && (value <= size - position);
+
+				if(complete)
+				{
+					event.code = names.size();
+					names.push_back(std::string((const char *)data + position,value));
+					position += value;
+				}
+			}
+			else
+			{
+				complete   = complete && varint(value);
+				event.code = (uint32_t)value;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	if(!complete)
+	{
+		/* cut short while writing, the last event is incomplete */
+		position = start;
+		return false;
+	}
+
+	last = event.instant;
+
+	return true;
+}
+
+const std::string &isabelJournalReader::key(uint32_t index)
+{
+	return (index < names.size()) ? names[index] : unknown;
+}
+
+bool isabelJournalReader::varint(uint64_t &value)
+{
+	value = 0;
+
+	for(int shift = 0; (position < size) && (shift < 64); shift += 7)
+	{
+		uint8_t byte = data[position++];
+
+		value |= (uint64_t)(byte & 0x7F) << shift;
+
+		if(0 == (byte & 0x80))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static void journal_varint(std::vector<uint8_t> &buffer, uint64_t value)
+{
+	while(0x80 <= value)
+	{
+		buffer.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+
+	buffer.push_back((uint8_t)value);
+}
+
+static void journal_zigzag(std::vector<uint8_t> &buffer, int32_t value)
+{
+	/* the small displacements, either way, take a single byte */
+	journal_varint(buffer,((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
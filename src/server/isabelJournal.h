@@ -0,0 +1,192 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Compact file of recorded user events. Long recordings are written to
+   the file as they go, instead of being kept in memory until the client
+   asks for them, and read back without parsing the whole file up front.
+
+   The file starts with the 8 bytes "ISABELEV" and a version byte, then
+   each event is written as:
+   	- a header byte: the event type in bits 0 to 2, the pressed flag in
+   	  bit 3, bit 4 set when a new key name follows, and bit 5 set when
+   	  the sampling jitter follows
+   	- the time since the previous event, in microseconds, as a varint
+   	- if the events were polled, the sampling jitter, in microseconds, as
+   	  a zigzag encoded varint
+   	- for mouse movements, the horizontal and vertical positions, as
+   	  zigzag encoded varints
+   	- for mouse buttons, the button number, as a varint
+   	- for keys, either the length and bytes of a new key name, which is
+   	  added to the dictionary of the file, or the index of a key name
+   	  already in the dictionary, as a varint
+
+   The varints are 7 bits per byte, least significant first, with bit 7
+   set on all bytes but the last. A typical event takes 3 to 6 bytes.
+   The files of the first version, with the time in milliseconds and
+   without the jitter, are also read.
+
+   The reader maps the file in memory and decodes one event at a time,
+   building the dictionary as it goes. A file cut short, as when the
+   application crashed while recording, ends at its last whole event.
+ */
+#ifndef __ISABEL_JOURNAL_H__
+#define __ISABEL_JOURNAL_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "isabelRing.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+#define JOURNAL_MAGIC 		"ISABELEV"	/* the first bytes of the file */
+#define JOURNAL_VERSION 	(2)			/* the version of the file format, after the magic */
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelJournalWriter {
+
+public:
+
+	/* Class initialization.
+	*/
+	isabelJournalWriter();
+
+	/* Class destructor.
+
+		Writes the pending events and closes the file.
+	*/
+	~isabelJournalWriter();
+
+	/* Create the file, replacing it if it exists.
+
+		@path 	the name of the file
+
+		#returns true if successfull, false otherwise
+	*/
+	bool open(const char *path);
+
+	/* Add an event to the file, it is written on the next flush.
+
+		@event 	the event, its code is the button number for mouse buttons
+		@key 	for key events, the key name
+	*/
+	void write(const T_USER_EVENT &event, const char *key);
+
+	/* Write the pending events to the file.
+
+		#returns true if successfull, false otherwise
+	*/
+	bool flush(void);
+
+	/* Write the pending events and close the file.
+
+		#returns true if successfull, false otherwise
+	*/
+	bool close(void);
+
+	/* Return the number of events added to the file.
+	*/
+	uint32_t events(void);
+
+private:
+	FILE 						  *file; 	/* the file, NULL if not open */
+	std::vector<uint8_t> 		  buffer; 	/* the events not yet written */
+	std::map<std::string,uint32_t> keys; 	/* the index of each key name in the dictionary */
+	uint64_t 					  last; 	/* instant of the previous event */
+	uint32_t 					  count; 	/* number of events added */
+	bool 						  failed; 	/* true once a write failed */
+};
+
+class isabelJournalReader {
+
+public:
+
+	/* Class initialization.
+	*/
+	isabelJournalReader();
+
+	/* Class destructor.
+
+		Unmaps the file.
+	*/
+	~isabelJournalReader();
+
+	/* Map a file in memory.
+
+		@path 	the name of the file
+
+		#returns true if successfull, false if it cannot be read or is not a file of events
+	*/
+	bool open(const char *path);
+
+	/* Unmap the file.
+	*/
+	void close(void);
+
+	/* Go back to the first event.
+	*/
+	void rewind(void);
+
+	/* Decode the next event.
+
+		@event 	where the event is returned, for key events its code is the index of the key name
+
+		#returns true if successfull, false at the end of the file
+	*/
+	bool next(T_USER_EVENT &event);
+
+	/* Return the name of a key.
+
+		@index 	the index of the key name, as returned by next()
+
+		#returns the key name, empty if the index is not in the dictionary yet
+	*/
+	const std::string &key(uint32_t index);
+
+private:
+	/* Decode a varint at the current position.
+
+		@value 	where the value is returned
+
+		#returns true if successfull, false if the file ends before the varint
+	*/
+	bool varint(uint64_t &value);
+
+private:
+	const uint8_t 			 *data; 	/* the mapped file, NULL if none */
+	size_t 					 size; 		/* size of the file, in bytes */
+	size_t 					 position; 	/* offset of the next event */
+	uint64_t 				 last; 		/* instant of the previous event */
+	uint8_t 				 version; 	/* the version of the file format */
+	std::vector<std::string> names; 	/* the dictionary of key names read so far */
+	std::string 			 unknown; 	/* returned for the indexes not in the dictionary */
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   The keyboard mapping of the X11 server, read once and kept in tables,
+   so that the recorded key codes are named, and the simulated key names
+   are converted back to key codes, without asking the X11 server for
+   each key.
+
+   Each key code has a few key symbols, one for each level: the first
+   without modifiers, the second with Shift, the third and fourth with
+   the Mode_switch modifier, without and with Shift, the fifth and sixth
+   with the ISO_Level3_Shift (AltGr) modifier, without and with Shift.
+   The modifier map
+   tells which keys set each of the 8 modifiers, so the simulation can
+   hold the modifiers of a level with real key presses. The tables must
+   be read again whenever the X11 server reports a MappingNotify event.
+
+   The Unicode character of each key symbol on the keyboard is also kept,
+   so a text is typed with whatever key symbol the layout has for each
+   character: the Latin-1 and Unicode ones, or the legacy ones of the
+   other scripts, such as Cyrillic_a for U+0430.
+ */
+#ifndef __ISABEL_KEYMAP_H__
+#define __ISABEL_KEYMAP_H__
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+#define KEYMAP_LEVELS (6)	/* the levels with known modifiers, the others are ignored */
+#define KEYMAP_MODIFIERS (8)	/* number of modifiers: Shift, Lock, Control and Mod1 to Mod5 */
+
+typedef struct{
+	uint8_t  keycode; 		// the key code that produces the key symbol
+	uint32_t modifiers; 	// the keyboard modifiers to hold along with it
+} T_KEY_CODE;
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelKeymap {
+
+public:
+
+	/* Class initialization, with an empty mapping.
+	*/
+	isabelKeymap();
+
+	/* Read the keyboard mapping from the X11 server.
+
+		@display 	the X11 client
+	*/
+	void read(void *display);
+
+	/* Build the tables from a keyboard mapping.
+
+		@min_code 	 the first key code
+		@max_code 	 the last key code
+		@per_code 	 number of key symbols for each key code
+		@mapping 	 the key symbols, per_code for each key code from min_code to max_code
+		@per_modifier number of key codes for each modifier
+		@modifiers 	 the key codes of each modifier, per_modifier for each one, 0 if unused
+	*/
+	void build(int min_code, int max_code, int per_code, const unsigned long *mapping, int per_modifier, const uint8_t *modifiers);
+
+	/* Return the key symbol produced by a key code.
+
+		@keycode 	the key code
+		@state 		the keyboard modifiers
+
+		#returns the key symbol, 0 (NoSymbol) if none
+	*/
+	unsigned long keysym(int keycode, uint32_t state) const;
+
+	/* Return the name of a key symbol.
+
+		@keysym 	the key symbol
+
+		#returns the name, NULL if unknown
+	*/
+	const char *name(unsigned long keysym) const;
+
+	/* Find the key code that produces a key symbol.
+
+		@name 		the name of the key symbol
+		@code 		where the key code, and the modifiers to hold, are returned
+
+		#returns true if found, false if no key produces it
+	*/
+	bool find(const std::string &name, T_KEY_CODE &code) const;
+
+	/* Return the name of the key symbol that types a Unicode character.
+
+		@character 	the Unicode code point
+
+		#returns the name, NULL if no key of the keyboard types it
+	*/
+	const char *character(uint32_t character) const;
+
+	/* Return the modifiers set by a key.
+
+		@keycode 	the key code
+
+		#returns the modifier mask, 0 if it is not a modifier key
+	*/
+	uint32_t modifiers(int keycode) const;
+
+	/* Return the key that sets a modifier.
+
+		@modifier 	the modifier mask, with a single bit set
+
+		#returns the key code, 0 if no key sets it
+	*/
+	int modifier_key(uint32_t modifier) const;
+
+private:
+	std::vector<unsigned long> 			keysyms; 	/* the key symbols, per_code for each key code */
+	int 								min_code; 	/* the first key code */
+	int 								per_code; 	/* number of key symbols for each key code */
+	uint32_t 							mode_switch; /* the modifier mask of the Mode_switch key */
+	uint32_t 							level3; 	/* the modifier mask of the ISO_Level3_Shift key, AltGr */
+	std::map<int, uint32_t> 			masks; 		/* the modifiers set by each modifier key */
+	int 								modifier_codes[KEYMAP_MODIFIERS]; /* the first key that sets each modifier */
+	std::map<unsigned long, std::string> names; 	/* the name of each key symbol */
+	std::map<std::string, T_KEY_CODE> 	codes; 		/* the key code of each key symbol name */
+	std::map<uint32_t, std::string> 	characters; /* the key symbol name typing each Unicode character */
+};
+
+#endif
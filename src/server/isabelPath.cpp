@@ -0,0 +1,216 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelPath.h"
+
+#include <utility>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+#define PATH_MOVE_REL 	(1)		/* the type of the relative moves, as in UserEvent::Type */
+
+typedef struct{
+	int64_t  x; 		// horizontal position, relative to the start of the path
+	int64_t  y; 		// vertical position, relative to the start of the path
+} T_POINT;
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Select the points to keep, with the Ramer-Douglas-Peucker algorithm.
+
+	@points 	the path, its first and last points are always kept
+	@tolerance 	maximum distance, in pixels, between the recorded and the simplified paths
+	@keep 		where the points to keep are flagged
+*/
+static void path_rdp(const std::vector<T_POINT> &points, double tolerance, std::vector<bool> &keep);
+
+/* Return the square of the distance between a point and a segment.
+
+	@point 		the point
+	@start 		the start of the segment
+	@end 		the end of the segment
+*/
+static double path_distance(const T_POINT &point, const T_POINT &start, const T_POINT &end);
+
+/*--------------------- Public Function Definitions ----------------*/
+
+unsigned int path_simplify(std::vector<T_USER_EVENT> &events, double tolerance)
+{
+	std::vector<T_USER_EVENT> simplified;
+	std::vector<T_POINT> 	  points;
+	std::vector<bool> 		  keep;
+	size_t 					  e = 0;
+
+	simplified.reserve(events.size());
+
+	while(e < events.size())
+	{
+		if(PATH_MOVE_REL != events[e].type)
+		{
+			simplified.push_back(events[e++]);
+			continue;
+		}
+
+		/* the path goes on while the mouse keeps moving */
+		size_t 	first = e;
+		T_POINT point = {0,0};
+
+		points.assign(1,point);
+
+		do
+		{
+			point.x += events[e].xpos;
+			point.y += events[e].ypos;
+			points.push_back(point);
+			e++;
+		}
+		while((e < events.size()) && (PATH_MOVE_REL == events[e].type) &&
+			  (1000*PATH_PAUSE_TIME > events[e].instant - events[e - 1].instant));
+
+		path_rdp(points,tolerance,keep);
+
+		/* each kept point moves the mouse from the previous kept point */
+		size_t previous = 0;
+
+		for(size_t p = 1; p < points.size(); p++)
+		{
+			if(keep[p])
+			{
+				T_USER_EVENT move = events[first + p - 1];
+
+				move.xpos = points[p].x - points[previous].x;
+				move.ypos = points[p].y - points[previous].y;
+
+				simplified.push_back(move);
+				previous = p;
+			}
+		}
+	}
+
+	unsigned int removed = events.size() - simplified.size();
+
+	events.swap(simplified);
+
+	return removed;
+}
+
+unsigned int path_simplify_chunk(std::vector<T_USER_EVENT> &events, std::vector<T_USER_EVENT> &open,
+								 double tolerance, bool close)
+{
+	/* the open path goes first, it happened before this chunk */
+	if(!open.empty())
+	{
+		open.insert(open.end(),events.begin(),events.end());
+		events.swap(open);
+		open.clear();
+	}
+
+	if(!close)
+	{
+		/* the moves at the end, without a pause, might go on in the next chunk */
+		size_t tail = events.size();
+
+		while((0 < tail) && (PATH_MOVE_REL == events[tail - 1].type) &&
+			  ((events.size() == tail) || (1000*PATH_PAUSE_TIME > events[tail].instant - events[tail - 1].instant)))
+		{
+			tail--;
+		}
+
+		if(PATH_MAX_OPEN > events.size() - tail)
+		{
+			open.assign(events.begin() + tail,events.end());
+			events.resize(tail);
+		}
+	}
+
+	return path_simplify(events,tolerance);
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static void path_rdp(const std::vector<T_POINT> &points, double tolerance, std::vector<bool> &keep)
+{
+	std::vector< std::pair<size_t,size_t> > pending;
+
+	keep.assign(points.size(),false);
+	keep.front() = true;
+	keep.back()  = true;
+
+	/* without recursion, the paths can have many thousands of points */
+	pending.push_back(std::pair<size_t,size_t>(0,points.size() - 1));
+
+	while(!pending.empty())
+	{
+		size_t start = pending.back().first;
+		size_t end 	 = pending.back().second;
+		size_t far 	 = start;
+		double worst = tolerance*tolerance;
+
+		pending.pop_back();
+
+		for(size_t p = start + 1; p < end; p++)
+		{
+			double distance = path_distance(points[p],points[start],points[end]);
+
+			if(distance > worst)
+			{
+				worst = distance;
+				far   = p;
+			}
+		}
+
+		/* the farthest point is out of the tolerance, keep it and look at both sides */
+		if(far != start)
+		{
+			keep[far] = true;
+
+			pending.push_back(std::pair<size_t,size_t>(start,far));
+			pending.push_back(std::pair<size_t,size_t>(far,end));
+		}
+	}
+}
+
+static double path_distance(const T_POINT &point, const T_POINT &start, const T_POINT &end)
+{
+	double dx 	  = (double)(end.x - start.x);
+	double dy 	  = (double)(end.y - start.y);
+	double px 	  = (double)(point.x - start.x);
+	double py 	  = (double)(point.y - start.y);
+	double length = dx*dx + dy*dy;
+
+	if(0 < length)
+	{
+		/* the closest point of the segment, not of the line, as the path might go back */
+		double t = (px*dx + py*dy)/length;
+
+		t  = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+		px -= t*dx;
+		py -= t*dy;
+	}
+
+	return px*px + py*py;
+}
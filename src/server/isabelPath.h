@@ -0,0 +1,78 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Simplification of the recorded mouse paths. A few seconds of mouse
+   movement is recorded as thousands of small relative moves, each one
+   replayed with a round trip to the server. The moves between two other
+   events are a path, which the Ramer-Douglas-Peucker algorithm reduces
+   to the few points that keep it within a tolerance, in pixels, of the
+   recorded one.
+
+   The first and last points of each path are always kept, so the clicks
+   and key presses happen exactly where they were recorded. A pause of
+   the mouse also ends the path, and each kept point keeps its recorded
+   instant, so the hovering and the speed of the drags are replayed.
+
+   The events are drained from the recording in chunks, so the path at
+   the end of a chunk is kept open, and only simplified once it ends in
+   a later chunk, or the recording ends.
+ */
+#ifndef __ISABEL_PATH_H__
+#define __ISABEL_PATH_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "isabelRing.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+#define PATH_PAUSE_TIME (100)	/* a mouse still for this long, in milliseconds, ends the path */
+#define PATH_MAX_OPEN 	(8192)	/* a path with this many moves is not kept open any longer */
+
+/*--------------------- Public Function Declarations ----------------*/
+
+/* Simplify the paths of relative mouse moves.
+
+	@events 	the recorded events, the relative moves are replaced by those that are kept
+	@tolerance 	maximum distance, in pixels, between the recorded and the simplified paths
+
+	#returns the number of events removed
+*/
+unsigned int path_simplify(std::vector<T_USER_EVENT> &events, double tolerance);
+
+/* Simplify the paths of relative mouse moves, in a chunk of the recorded events.
+
+	@events 	the events of the chunk, replaced by those ready to be sent: the open path
+				of the previous chunk and the events of this one, until the path at its end
+	@open 		the moves of the path that did not end yet, carried from one chunk to the next
+	@tolerance 	maximum distance, in pixels, between the recorded and the simplified paths
+	@close 		true to end the open path, when the mouse stopped or the recording ends
+
+	#returns the number of events removed
+*/
+unsigned int path_simplify_chunk(std::vector<T_USER_EVENT> &events, std::vector<T_USER_EVENT> &open,
+								 double tolerance, bool close);
+
+#endif
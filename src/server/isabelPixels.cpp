@@ -0,0 +1,1037 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelPixels.h"
+
+#include <algorithm>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+/* the SSE implementations are selected at run time, so the library runs on any x86 CPU */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXELS_SSE
+#include <smmintrin.h>
+#endif
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+/* the primes of the xxHash32 algorithm, the hash uses the same rounds */
+#define HASH_PRIME_1 	(2654435761U)
+#define HASH_PRIME_2 	(2246822519U)
+#define HASH_PRIME_3 	(3266489917U)
+#define HASH_PRIME_4 	(668265263U)
+#define HASH_PRIME_5 	(374761393U)
+#define HASH_LANES 		(4)			/* number of independent lanes, one per 32 bits word in a SSE register */
+#define PIXEL_COLOR_MASK 	(0x00FFFFFF)	/* the color channels of a pixel, without the alpha */
+#define FIND_MIN_NEEDLE 	(4)			/* smallest size, in pixels, of the needle in the reduced images */
+#define FIND_MAX_FACTOR 	(4)			/* largest reduction of the images, when searching */
+#define FIND_CANDIDATES 	(4)			/* candidates refined, for each match returned */
+#define LUMA_RED 			(77)		/* weights of the color channels in the luminance, they add up to 256 */
+#define LUMA_GREEN 			(150)
+#define LUMA_BLUE 			(29)
+#define DHASH_COLUMNS 		(9)			/* size of the grayscale image of the difference hash */
+#define DHASH_ROWS 			(8)
+#define PHASH_SIZE 			(32)		/* size of the grayscale image of the perceptual hash */
+#define PHASH_FREQUENCIES 	(8)			/* number of the lowest frequencies used, in each direction */
+#define QOI_OP_INDEX 		(0x00)		/* QOI operations */
+#define QOI_OP_DIFF 		(0x40)
+#define QOI_OP_LUMA 		(0x80)
+#define QOI_OP_RUN 			(0xC0)
+#define QOI_OP_RGB 			(0xFE)
+#define QOI_OP_RGBA 		(0xFF)
+#define QOI_MAX_RUN 		(62)		/* longest run of identical pixels */
+#define QOI_HEADER_SIZE 	(14)		/* size, in bytes, of the header */
+#define QOI_PIXEL_SIZE 		(5)			/* worst case size, in bytes, of an encoded pixel */
+#define QOI_PADDING_SIZE 	(8)			/* size, in bytes, of the end marker */
+
+typedef std::pair<uint64_t,int> T_CANDIDATE;	/* the average difference, and the position in the haystack */
+
+static bool simd = true;	/* false to use the plain C implementations, see pixels_use_simd() */
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Rotate the bits to the left.
+
+	@value 	the value to rotate
+	@bits 	how many bits to rotate
+
+	#returns the rotated value
+*/
+static inline uint32_t rotate_left(uint32_t value, int bits);
+
+/* Mix one pixel into a lane of the hash.
+
+	@lane 	 the current lane value
+	@pixel 	 the pixel to mix
+
+	#returns the new lane value
+*/
+static inline uint32_t hash_round(uint32_t lane, uint32_t pixel);
+
+/* Spread the bits of the final hash value.
+
+	@value 	the value to spread
+
+	#returns the final hash value
+*/
+static inline uint32_t hash_avalanche(uint32_t value);
+
+/* Mix the pixels into the lanes of the hash, the pixels of each row are 
+   spread over the lanes and the remainder is mixed in one by one.
+
+	@lanes 		the lanes of the hash
+	@pixels 	the top left pixel of the rectangle
+	@stride 	distance, in bytes, between two rows of pixels
+	@width 		width of the rectangle, in pixels
+	@height 	height of the rectangle, in pixels
+*/
+static void hash_lanes(uint32_t *lanes, const uint8_t *pixels, int stride, int width, int height);
+
+#ifdef PIXELS_SSE
+/* Same as hash_lanes(), using SSE4.1 to mix the four lanes at once.
+*/
+__attribute__((target("sse4.1")))
+static void hash_lanes_sse41(uint32_t *lanes, const uint8_t *pixels, int stride, int width, int height);
+#endif
+
+/* Compute the sum of the absolute differences between two rectangles of pixels, see pixels_sad().
+*/
+static uint64_t sad_rows(const uint8_t *first, int first_stride, const uint8_t *second, int second_stride,
+						 int width, int height, uint64_t limit);
+
+#ifdef PIXELS_SSE
+/* Same as sad_rows(), using SSE2 to compare four pixels at once.
+*/
+__attribute__((target("sse2")))
+static uint64_t sad_rows_sse2(const uint8_t *first, int first_stride, const uint8_t *second, int second_stride,
+							  int width, int height, uint64_t limit);
+#endif
+
+/* Find the pixels that differ in a row, see pixels_compare().
+
+	@first 		the first pixel of the first row
+	@second 	the first pixel of the second row
+	@width 		number of pixels in the rows
+	@tolerance 	pixels differ if any of the color channels differs by more than this
+	@differs 	one byte per pixel, set to 1 for the pixels that differ and 0 for the others
+
+	#returns the number of pixels that differ
+*/
+static int compare_row(const uint8_t *first, const uint8_t *second, int width, int tolerance, uint8_t *differs);
+
+#ifdef PIXELS_SSE
+/* Same as compare_row(), using SSE2 to compare four pixels at once.
+*/
+__attribute__((target("sse2")))
+static int compare_row_sse2(const uint8_t *first, const uint8_t *second, int width, int tolerance, uint8_t *differs);
+#endif
+
+/* Compute the luminance of a row of pixels.
+
+	@pixels 	the first pixel of the row
+	@width 		number of pixels in the row
+	@luma 		where the luminance of each pixel, from 0 to 255, is returned
+*/
+static void luma_row(const uint8_t *pixels, int width, uint32_t *luma);
+
+#ifdef PIXELS_SSE
+/* Same as luma_row(), using SSE2 to convert four pixels at once.
+*/
+__attribute__((target("sse2")))
+static void luma_row_sse2(const uint8_t *pixels, int width, uint32_t *luma);
+#endif
+
+/* Reduce the image, each block of pixels is replaced by their average.
+
+	@pixels 	the top left pixel of the image
+	@stride 	distance, in bytes, between two rows of pixels
+	@width 		width of the image, in pixels
+	@height 	height of the image, in pixels
+	@factor 	size of the square blocks, in pixels
+	@output 	where the reduced image is returned, without padding between the rows
+*/
+static void pixels_reduce(const uint8_t *pixels, int stride, int width, int height, int factor, std::vector<uint32_t> &output);
+
+/*--------------------- Public Function Definitions ----------------*/
+
+uint64_t pixels_hash(const uint8_t *pixels, int stride, int width, int height)
+{
+	uint32_t lanes[HASH_LANES] = {
+		HASH_PRIME_1 + HASH_PRIME_2,
+		HASH_PRIME_2,
+		0,
+		0 - HASH_PRIME_1
+	};
+
+#ifdef PIXELS_SSE
+	static const bool sse41 = __builtin_cpu_supports("sse4.1");
+
+	if(sse41 && simd)
+	{
+		hash_lanes_sse41(lanes,pixels,stride,width,height);
+	}
+	else
+#endif
+	{
+		hash_lanes(lanes,pixels,stride,width,height);
+	}
+
+	/* two different combinations of the lanes give the upper and lower half of the hash */
+	uint32_t length = (uint32_t)(width*height*4);
+	uint32_t upper  = rotate_left(lanes[0],1) + rotate_left(lanes[1],7) + rotate_left(lanes[2],12) + rotate_left(lanes[3],18);
+	uint32_t lower  = (lanes[0] ^ rotate_left(lanes[2],16))*HASH_PRIME_3 + (lanes[1] ^ rotate_left(lanes[3],16))*HASH_PRIME_4;
+
+	upper = hash_avalanche(upper + length);
+	lower = hash_avalanche(lower + length*HASH_PRIME_5);
+
+	return ((uint64_t)upper << 32) | lower;
+}
+
+int pixels_changed_tiles(const uint8_t *pixels, int stride, int width, int height, int tile,
+						 std::vector<uint64_t> &hashes, std::vector<int> &changed)
+{
+	int columns = (width + tile - 1) / tile;
+	int rows 	= (height + tile - 1) / tile;
+
+	/* without the previous hashes, everything changed */
+	bool everything = ((int)hashes.size() != columns*rows);
+
+	if(everything)
+	{
+		hashes.assign(columns*rows,0);
+	}
+
+	changed.clear();
+
+	for(int r = 0; r < rows; r++)
+	{
+		int y = r*tile;
+		int h = (height - y < tile) ? (height - y) : tile;
+
+		for(int c = 0; c < columns; c++)
+		{
+			int x = c*tile;
+			int w = (width - x < tile) ? (width - x) : tile;
+			int t = r*columns + c;
+
+			uint64_t hash = pixels_hash(pixels + y*stride + x*4,stride,w,h);
+
+			if(everything || (hashes[t] != hash))
+			{
+				changed.push_back(t);
+			}
+
+			hashes[t] = hash;
+		}
+	}
+
+	return columns;
+}
+
+uint64_t pixels_sad(const uint8_t *first, int first_stride, const uint8_t *second, int second_stride,
+					int width, int height, uint64_t limit)
+{
+#ifdef PIXELS_SSE
+	static const bool sse2 = __builtin_cpu_supports("sse2");
+
+	if(sse2 && simd)
+	{
+		return sad_rows_sse2(first,first_stride,second,second_stride,width,height,limit);
+	}
+#endif
+
+	return sad_rows(first,first_stride,second,second_stride,width,height,limit);
+}
+
+void pixels_compare(const uint8_t *first, int first_stride, const uint8_t *second, int second_stride,
+					int width, int height, int tolerance, const uint8_t *ignore,
+					T_DIFFERENCE &difference, uint8_t *mismatches)
+{
+#ifdef PIXELS_SSE
+	static const bool sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+	std::vector<uint8_t> differs(width);
+
+	difference.count  = 0;
+	difference.left   = width;
+	difference.top 	  = height;
+	difference.right  = -1;
+	difference.bottom = -1;
+
+	for(int y = 0; y < height; y++)
+	{
+		int count;
+
+#ifdef PIXELS_SSE
+		if(sse2 && simd)
+		{
+			count = compare_row_sse2(first + y*first_stride,second + y*second_stride,width,tolerance,&differs[0]);
+		}
+		else
+#endif
+		{
+			count = compare_row(first + y*first_stride,second + y*second_stride,width,tolerance,&differs[0]);
+		}
+
+		/* the ignored pixels are only looked at when there are differences */
+		if((0 < count) && (NULL != ignore))
+		{
+			for(int x = 0; x < width; x++)
+			{
+				if(differs[x] && ignore[y*width + x])
+				{
+					differs[x] = 0;
+					count--;
+				}
+			}
+		}
+
+		if(0 < count)
+		{
+			difference.count += count;
+			difference.top 	  = std::min(difference.top,y);
+			difference.bottom = y;
+
+			for(int x = 0; x < width; x++)
+			{
+				if(differs[x])
+				{
+					difference.left  = std::min(difference.left,x);
+					difference.right = std::max(difference.right,x);
+				}
+			}
+		}
+
+		if(NULL != mismatches)
+		{
+			if(0 < count)
+			{
+				memcpy(mismatches + y*width,&differs[0],width);
+			}
+			else
+			{
+				memset(mismatches + y*width,0,width);
+			}
+		}
+	}
+}
+
+void pixels_find(const uint8_t *haystack, int haystack_stride, int haystack_width, int haystack_height,
+				 const uint8_t *needle, int needle_stride, int needle_width, int needle_height,
+				 int count, std::vector<T_MATCH> &matches)
+{
+	matches.clear();
+
+	if((0 >= count) || (0 >= needle_width) || (0 >= needle_height) ||
+	   (needle_width > haystack_width) || (needle_height > haystack_height))
+	{
+		return;
+	}
+
+	/* reduce both images, as long as the needle keeps enough detail */
+	int factor = std::min(needle_width,needle_height) / FIND_MIN_NEEDLE;
+
+	factor = std::max(1,std::min(factor,FIND_MAX_FACTOR));
+
+	std::vector<uint32_t> reduced_haystack;
+	std::vector<uint32_t> reduced_needle;
+
+	const uint8_t *hay 	  	 = haystack;
+	int 		  hay_stride = haystack_stride;
+	int 		  hay_width  = haystack_width / factor;
+	int 		  hay_height = haystack_height / factor;
+
+	if(1 < factor)
+	{
+		pixels_reduce(haystack,haystack_stride,haystack_width,haystack_height,factor,reduced_haystack);
+
+		hay 	   = (const uint8_t *)&reduced_haystack[0];
+		hay_stride = hay_width*4;
+	}
+
+	/* the best candidate at each position of the reduced haystack */
+	std::vector<T_CANDIDATE> candidates(hay_width*hay_height,T_CANDIDATE(PIXELS_NO_LIMIT,-1));
+
+	/* the needle rarely starts at the border of a block, so it is compared at a few offsets */
+	int step = std::max(1,factor/2);
+
+	for(int oy = 0; oy < factor; oy += step)
+	{
+		for(int ox = 0; ox < factor; ox += step)
+		{
+			/* the needle pixels before the first block of the haystack are skipped */
+			int skip_x = (factor - ox) % factor;
+			int skip_y = (factor - oy) % factor;
+
+			const uint8_t *pin 		  = needle + skip_y*needle_stride + skip_x*4;
+			int 		  pin_stride = needle_stride;
+			int 		  pin_width  = (needle_width - skip_x) / factor;
+			int 		  pin_height = (needle_height - skip_y) / factor;
+
+			if((0 >= pin_width) || (0 >= pin_height))
+			{
+				continue;
+			}
+
+			if(1 < factor)
+			{
+				pixels_reduce(pin,needle_stride,needle_width - skip_x,needle_height - skip_y,factor,reduced_needle);
+
+				pin 	   = (const uint8_t *)&reduced_needle[0];
+				pin_stride = pin_width*4;
+			}
+
+			for(int cy = 0; cy + pin_height <= hay_height; cy++)
+			{
+				int y = cy*factor - skip_y;
+
+				if((0 > y) || (y + needle_height > haystack_height))
+				{
+					continue;
+				}
+
+				for(int cx = 0; cx + pin_width <= hay_width; cx++)
+				{
+					int x = cx*factor - skip_x;
+
+					if((0 > x) || (x + needle_width > haystack_width))
+					{
+						continue;
+					}
+
+					/* the reduced needles have slightly different sizes, compare the average difference */
+					uint64_t sad = pixels_sad(hay + cy*hay_stride + cx*4,hay_stride,pin,pin_stride,pin_width,pin_height,PIXELS_NO_LIMIT);
+
+					sad = (sad << 16) / (pin_width*pin_height);
+
+					if(sad < candidates[cy*hay_width + cx].first)
+					{
+						candidates[cy*hay_width + cx] = T_CANDIDATE(sad,y*haystack_width + x);
+					}
+				}
+			}
+		}
+	}
+
+	std::sort(candidates.begin(),candidates.end());
+
+	/* keep the best candidates, discarding those overlapping a better one */
+	std::vector<T_CANDIDATE> selected;
+
+	for(unsigned int c = 0; (c < candidates.size()) && (0 <= candidates[c].second) && ((int)selected.size() < count*FIND_CANDIDATES); c++)
+	{
+		int  x 		 = candidates[c].second % haystack_width;
+		int  y 		 = candidates[c].second / haystack_width;
+		bool overlap = false;
+
+		for(unsigned int s = 0; (s < selected.size()) && !overlap; s++)
+		{
+			int dx = x - selected[s].second % haystack_width;
+			int dy = y - selected[s].second / haystack_width;
+
+			overlap = (2*std::abs(dx) < needle_width) && (2*std::abs(dy) < needle_height);
+		}
+
+		if(!overlap)
+		{
+			selected.push_back(candidates[c]);
+		}
+	}
+
+	/* refine the candidates in the original images, around their position */
+	for(unsigned int s = 0; s < selected.size(); s++)
+	{
+		T_MATCH best;
+
+		best.x 	 = selected[s].second % haystack_width;
+		best.y 	 = selected[s].second / haystack_width;
+		best.sad = PIXELS_NO_LIMIT;
+
+		int left   = std::max(0,best.x - step);
+		int right  = std::min(haystack_width - needle_width,best.x + step);
+		int top    = std::max(0,best.y - step);
+		int bottom = std::min(haystack_height - needle_height,best.y + step);
+
+		for(int y = top; y <= bottom; y++)
+		{
+			for(int x = left; x <= right; x++)
+			{
+				uint64_t sad = pixels_sad(haystack + y*haystack_stride + x*4,haystack_stride,
+										  needle,needle_stride,needle_width,needle_height,best.sad);
+
+				if(sad < best.sad)
+				{
+					best.x 	 = x;
+					best.y 	 = y;
+					best.sad = sad;
+				}
+			}
+		}
+
+		matches.push_back(best);
+	}
+
+	/* the best matches first */
+	for(unsigned int m = 1; m < matches.size(); m++)
+	{
+		for(unsigned int n = m; (0 < n) && (matches[n].sad < matches[n - 1].sad); n--)
+		{
+			std::swap(matches[n],matches[n - 1]);
+		}
+	}
+
+	if((int)matches.size() > count)
+	{
+		matches.resize(count);
+	}
+}
+
+void pixels_gray_cells(const uint8_t *pixels, int stride, int width, int height, int columns, int rows,
+					   std::vector<uint32_t> &cells)
+{
+#ifdef PIXELS_SSE
+	static const bool sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+	std::vector<uint32_t> luma(width);
+	std::vector<uint64_t> sums(columns);
+
+	cells.assign(columns*rows,0);
+
+	if((0 >= width) || (0 >= height))
+	{
+		return;
+	}
+
+	for(int r = 0; r < rows; r++)
+	{
+		/* every cell covers at least one row and one column */
+		int top 	= (r*height) / rows;
+		int bottom 	= std::max(top + 1,((r + 1)*height) / rows);
+
+		std::fill(sums.begin(),sums.end(),0);
+
+		for(int y = top; y < bottom; y++)
+		{
+#ifdef PIXELS_SSE
+			if(sse2 && simd)
+			{
+				luma_row_sse2(pixels + y*stride,width,&luma[0]);
+			}
+			else
+#endif
+			{
+				luma_row(pixels + y*stride,width,&luma[0]);
+			}
+
+			for(int c = 0; c < columns; c++)
+			{
+				int left  = (c*width) / columns;
+				int right = std::max(left + 1,((c + 1)*width) / columns);
+
+				for(int x = left; x < right; x++)
+				{
+					sums[c] += luma[x];
+				}
+			}
+		}
+
+		for(int c = 0; c < columns; c++)
+		{
+			int left  = (c*width) / columns;
+			int right = std::max(left + 1,((c + 1)*width) / columns);
+
+			cells[r*columns + c] = (uint32_t)(sums[c] / ((uint64_t)(right - left)*(bottom - top)));
+		}
+	}
+}
+
+uint64_t pixels_dhash(const uint8_t *pixels, int stride, int width, int height)
+{
+	std::vector<uint32_t> cells;
+	uint64_t 			  hash = 0;
+
+	pixels_gray_cells(pixels,stride,width,height,DHASH_COLUMNS,DHASH_ROWS,cells);
+
+	for(int r = 0; r < DHASH_ROWS; r++)
+	{
+		for(int c = 0; c < DHASH_COLUMNS - 1; c++)
+		{
+			if(cells[r*DHASH_COLUMNS + c + 1] > cells[r*DHASH_COLUMNS + c])
+			{
+				hash |= (uint64_t)1 << (r*(DHASH_COLUMNS - 1) + c);
+			}
+		}
+	}
+
+	return hash;
+}
+
+uint64_t pixels_phash(const uint8_t *pixels, int stride, int width, int height)
+{
+	std::vector<uint32_t> cells;
+	double 				  cosines[PHASH_FREQUENCIES][PHASH_SIZE];
+	double 				  rows[PHASH_SIZE][PHASH_FREQUENCIES];
+	double 				  dct[PHASH_FREQUENCIES*PHASH_FREQUENCIES];
+	uint64_t 			  hash = 0;
+
+	pixels_gray_cells(pixels,stride,width,height,PHASH_SIZE,PHASH_SIZE,cells);
+
+	for(int u = 0; u < PHASH_FREQUENCIES; u++)
+	{
+		for(int x = 0; x < PHASH_SIZE; x++)
+		{
+			cosines[u][x] = cos(((2*x + 1)*u*M_PI) / (2*PHASH_SIZE));
+		}
+	}
+
+	/* the DCT is separable, transform the rows and then the columns, only the lowest frequencies are needed */
+	for(int y = 0; y < PHASH_SIZE; y++)
+	{
+		for(int u = 0; u < PHASH_FREQUENCIES; u++)
+		{
+			double sum = 0;
+
+			for(int x = 0; x < PHASH_SIZE; x++)
+			{
+				sum += cosines[u][x]*cells[y*PHASH_SIZE + x];
+			}
+
+			rows[y][u] = sum;
+		}
+	}
+
+	for(int v = 0; v < PHASH_FREQUENCIES; v++)
+	{
+		for(int u = 0; u < PHASH_FREQUENCIES; u++)
+		{
+			double sum = 0;
+
+			for(int y = 0; y < PHASH_SIZE; y++)
+			{
+				sum += cosines[v][y]*rows[y][u];
+			}
+
+			dct[v*PHASH_FREQUENCIES + u] = sum;
+		}
+	}
+
+	double sorted[PHASH_FREQUENCIES*PHASH_FREQUENCIES];
+	int    count = PHASH_FREQUENCIES*PHASH_FREQUENCIES;
+
+	memcpy(sorted,dct,sizeof(sorted));
+	std::sort(sorted,sorted + count);
+
+	double median = (sorted[count/2 - 1] + sorted[count/2]) / 2;
+
+	for(int f = 0; f < count; f++)
+	{
+		if(dct[f] > median)
+		{
+			hash |= (uint64_t)1 << f;
+		}
+	}
+
+	return hash;
+}
+
+void pixels_use_simd(bool enable)
+{
+	simd = enable;
+}
+
+size_t pixels_qoi_size(int width, int height)
+{
+	return QOI_HEADER_SIZE + (size_t)width*height*QOI_PIXEL_SIZE + QOI_PADDING_SIZE;
+}
+
+size_t pixels_qoi(const uint8_t *pixels, int stride, int width, int height, bool opaque, uint8_t *output)
+{
+	uint8_t *out = output;
+
+	/* header: magic, width and height in big endian, channels and colorspace */
+	const uint8_t header[QOI_HEADER_SIZE] = {
+		'q', 'o', 'i', 'f',
+		(uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+		(uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+		(uint8_t)(opaque ? 3 : 4), 0
+	};
+
+	memcpy(out,header,sizeof(header));
+	out += sizeof(header);
+
+	uint32_t index[64];
+	uint32_t previous = 0xFF000000;
+	int 	 run 	  = 0;
+
+	memset(index,0x00,sizeof(index));
+
+	for(int y = 0; y < height; y++)
+	{
+		const uint32_t *row = (const uint32_t *)(pixels + y*stride);
+
+		for(int x = 0; x < width; x++)
+		{
+			uint32_t pixel = opaque ? (row[x] | 0xFF000000) : row[x];
+
+			if(pixel == previous)
+			{
+				run++;
+
+				/* runs span rows, they end at their maximum size or at the last pixel */
+				if((QOI_MAX_RUN == run) || ((height - 1 == y) && (width - 1 == x)))
+				{
+					*out++ = QOI_OP_RUN | (run - 1);
+					run    = 0;
+				}
+
+				continue;
+			}
+
+			if(0 < run)
+			{
+				*out++ = QOI_OP_RUN | (run - 1);
+				run    = 0;
+			}
+
+			int r = (pixel >> 16) & 0xFF;
+			int g = (pixel >> 8) & 0xFF;
+			int b = pixel & 0xFF;
+			int a = pixel >> 24;
+			int h = (r*3 + g*5 + b*7 + a*11) % 64;
+
+			if(index[h] == pixel)
+			{
+				*out++ = QOI_OP_INDEX | h;
+			}
+			else if(a == (int)(previous >> 24))
+			{
+				int8_t vr   = (int8_t)(r - ((previous >> 16) & 0xFF));
+				int8_t vg   = (int8_t)(g - ((previous >> 8) & 0xFF));
+				int8_t vb   = (int8_t)(b - (previous & 0xFF));
+				int8_t vg_r = vr - vg;
+				int8_t vg_b = vb - vg;
+
+				if((-3 < vr) && (2 > vr) && (-3 < vg) && (2 > vg) && (-3 < vb) && (2 > vb))
+				{
+					*out++ = QOI_OP_DIFF | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2);
+				}
+				else if((-9 < vg_r) && (8 > vg_r) && (-33 < vg) && (32 > vg) && (-9 < vg_b) && (8 > vg_b))
+				{
+					*out++ = QOI_OP_LUMA | (vg + 32);
+					*out++ = ((vg_r + 8) << 4) | (vg_b + 8);
+				}
+				else
+				{
+					*out++ = QOI_OP_RGB;
+					*out++ = r;
+					*out++ = g;
+					*out++ = b;
+				}
+			}
+			else
+			{
+				*out++ = QOI_OP_RGBA;
+				*out++ = r;
+				*out++ = g;
+				*out++ = b;
+				*out++ = a;
+			}
+
+			index[h] = pixel;
+			previous = pixel;
+		}
+	}
+
+	/* end marker */
+	const uint8_t padding[QOI_PADDING_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+	memcpy(out,padding,sizeof(padding));
+	out += sizeof(padding);
+
+	return out - output;
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static void hash_lanes(uint32_t *lanes, const uint8_t *pixels, int stride, int width, int height)
+{
+	for(int y = 0; y < height; y++)
+	{
+		const uint32_t *row = (const uint32_t *)(pixels + y*stride);
+
+		for(int x = 0; x < width; x++)
+		{
+			lanes[x % HASH_LANES] = hash_round(lanes[x % HASH_LANES],row[x]);
+		}
+	}
+}
+
+#ifdef PIXELS_SSE
+__attribute__((target("sse4.1")))
+static void hash_lanes_sse41(uint32_t *lanes, const uint8_t *pixels, int stride, int width, int height)
+{
+	const __m128i prime_1 = _mm_set1_epi32((int)HASH_PRIME_1);
+	const __m128i prime_2 = _mm_set1_epi32((int)HASH_PRIME_2);
+
+	int 	blocks = width / HASH_LANES;
+	__m128i state  = _mm_loadu_si128((const __m128i *)lanes);
+
+	for(int y = 0; y < height; y++)
+	{
+		const uint32_t *row = (const uint32_t *)(pixels + y*stride);
+		int 			x 	= 0;
+
+		for(int b = 0; b < blocks; b++, x += HASH_LANES)
+		{
+			__m128i block = _mm_loadu_si128((const __m128i *)(row + x));
+
+			state = _mm_add_epi32(state,_mm_mullo_epi32(block,prime_2));
+			state = _mm_or_si128(_mm_slli_epi32(state,13),_mm_srli_epi32(state,19));
+			state = _mm_mullo_epi32(state,prime_1);
+		}
+
+		if(x < width)
+		{
+			_mm_storeu_si128((__m128i *)lanes,state);
+
+			for(; x < width; x++)
+			{
+				lanes[x % HASH_LANES] = hash_round(lanes[x % HASH_LANES],row[x]);
+			}
+
+			state = _mm_loadu_si128((const __m128i *)lanes);
+		}
+	}
+
+	_mm_storeu_si128((__m128i *)lanes,state);
+}
+#endif
+
+static inline uint32_t rotate_left(uint32_t value, int bits)
+{
+	return (value << bits) | (value >> (32 - bits));
+}
+
+static inline uint32_t hash_round(uint32_t lane, uint32_t pixel)
+{
+	return rotate_left(lane + pixel*HASH_PRIME_2,13)*HASH_PRIME_1;
+}
+
+static inline uint32_t hash_avalanche(uint32_t value)
+{
+	value ^= value >> 15;
+	value *= HASH_PRIME_2;
+	value ^= value >> 13;
+	value *= HASH_PRIME_3;
+	value ^= value >> 16;
+
+	return value;
+}
+
+static uint64_t sad_rows(const uint8_t *first, int first_stride, const uint8_t *second, int second_stride,
+						 int width, int height, uint64_t limit)
+{
+	uint64_t sad = 0;
+
+	for(int y = 0; (y < height) && (sad <= limit); y++)
+	{
+		const uint8_t *a = first + y*first_stride;
+		const uint8_t *b = second + y*second_stride;
+
+		for(int x = 0; x < width; x++, a += 4, b += 4)
+		{
+			/* blue, green and red, the alpha is the fourth byte */
+			sad += std::abs(a[0] - b[0]) + std::abs(a[1] - b[1]) + std::abs(a[2] - b[2]);
+		}
+	}
+
+	return sad;
+}
+
+#ifdef PIXELS_SSE
+__attribute__((target("sse2")))
+static uint64_t sad_rows_sse2(const uint8_t *first, int first_stride, const uint8_t *second, int second_stride,
+							  int width, int height, uint64_t limit)
+{
+	const __m128i colors = _mm_set1_epi32(PIXEL_COLOR_MASK);
+
+	uint64_t sad 	= 0;
+	int 	 blocks = width / 4;
+
+	for(int y = 0; (y < height) && (sad <= limit); y++)
+	{
+		const uint8_t *a 	 = first + y*first_stride;
+		const uint8_t *b 	 = second + y*second_stride;
+		__m128i 	   total = _mm_setzero_si128();
+
+		for(int k = 0; k < blocks; k++, a += 16, b += 16)
+		{
+			__m128i pa = _mm_and_si128(_mm_loadu_si128((const __m128i *)a),colors);
+			__m128i pb = _mm_and_si128(_mm_loadu_si128((const __m128i *)b),colors);
+
+			/* two partial sums, one in each 64 bits half */
+			total = _mm_add_epi64(total,_mm_sad_epu8(pa,pb));
+		}
+
+		sad += (uint64_t)_mm_cvtsi128_si32(total) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(total,8));
+		sad += sad_rows(a,first_stride,b,second_stride,width - blocks*4,1,PIXELS_NO_LIMIT);
+	}
+
+	return sad;
+}
+#endif
+
+static int compare_row(const uint8_t *first, const uint8_t *second, int width, int tolerance, uint8_t *differs)
+{
+	int count = 0;
+
+	for(int x = 0; x < width; x++, first += 4, second += 4)
+	{
+		differs[x] = (std::abs(first[0] - second[0]) > tolerance) ||
+					 (std::abs(first[1] - second[1]) > tolerance) ||
+					 (std::abs(first[2] - second[2]) > tolerance);
+
+		count += differs[x];
+	}
+
+	return count;
+}
+
+#ifdef PIXELS_SSE
+__attribute__((target("sse2")))
+static int compare_row_sse2(const uint8_t *first, const uint8_t *second, int width, int tolerance, uint8_t *differs)
+{
+	const __m128i colors = _mm_set1_epi32(PIXEL_COLOR_MASK);
+	const __m128i limit  = _mm_set1_epi8((char)std::min(255,std::max(0,tolerance)));
+	const __m128i zero 	 = _mm_setzero_si128();
+
+	int count  = 0;
+	int blocks = width / 4;
+
+	for(int b = 0; b < blocks; b++, first += 16, second += 16)
+	{
+		__m128i pa = _mm_loadu_si128((const __m128i *)first);
+		__m128i pb = _mm_loadu_si128((const __m128i *)second);
+
+		/* the absolute difference of each channel, above the tolerance, without the alpha */
+		__m128i diff   = _mm_or_si128(_mm_subs_epu8(pa,pb),_mm_subs_epu8(pb,pa));
+		__m128i excess = _mm_and_si128(_mm_subs_epu8(diff,limit),colors);
+
+		/* one bit per channel within the tolerance */
+		int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(excess,zero));
+
+		if(0xFFFF == equal)
+		{
+			memset(differs + b*4,0,4);
+			continue;
+		}
+
+		for(int p = 0; p < 4; p++)
+		{
+			differs[b*4 + p] = (0xF != ((equal >> (p*4)) & 0xF));
+			count 			+= differs[b*4 + p];
+		}
+	}
+
+	return count + compare_row(first,second,width - blocks*4,tolerance,differs + blocks*4);
+}
+#endif
+
+static void luma_row(const uint8_t *pixels, int width, uint32_t *luma)
+{
+	for(int x = 0; x < width; x++, pixels += 4)
+	{
+		luma[x] = (LUMA_BLUE*pixels[0] + LUMA_GREEN*pixels[1] + LUMA_RED*pixels[2]) >> 8;
+	}
+}
+
+#ifdef PIXELS_SSE
+__attribute__((target("sse2")))
+static void luma_row_sse2(const uint8_t *pixels, int width, uint32_t *luma)
+{
+	/* the alpha channel has no weight */
+	const __m128i weights = _mm_setr_epi16(LUMA_BLUE,LUMA_GREEN,LUMA_RED,0,LUMA_BLUE,LUMA_GREEN,LUMA_RED,0);
+	const __m128i zero 	  = _mm_setzero_si128();
+
+	int blocks = width / 4;
+
+	for(int b = 0; b < blocks; b++)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)(pixels + b*16));
+
+		/* each pair of channels is multiplied and added: blue with green, and red with alpha */
+		__m128i low  = _mm_madd_epi16(_mm_unpacklo_epi8(block,zero),weights);
+		__m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(block,zero),weights);
+
+		/* add the two halves of each pixel, and keep one sum per pixel */
+		low  = _mm_add_epi32(low,_mm_shuffle_epi32(low,_MM_SHUFFLE(2,3,0,1)));
+		high = _mm_add_epi32(high,_mm_shuffle_epi32(high,_MM_SHUFFLE(2,3,0,1)));
+
+		__m128i sums = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low),_mm_castsi128_ps(high),_MM_SHUFFLE(2,0,2,0)));
+
+		_mm_storeu_si128((__m128i *)(luma + b*4),_mm_srli_epi32(sums,8));
+	}
+
+	luma_row(pixels + blocks*16,width - blocks*4,luma + blocks*4);
+}
+#endif
+
+static void pixels_reduce(const uint8_t *pixels, int stride, int width, int height, int factor, std::vector<uint32_t> &output)
+{
+	int columns = width / factor;
+	int rows 	= height / factor;
+	int area 	= factor*factor;
+
+	output.resize(columns*rows);
+
+	for(int r = 0; r < rows; r++)
+	{
+		for(int c = 0; c < columns; c++)
+		{
+			uint32_t sum[4] = { 0, 0, 0, 0 };
+
+			for(int y = r*factor; y < (r + 1)*factor; y++)
+			{
+				const uint8_t *p = pixels + y*stride + c*factor*4;
+
+				for(int x = 0; x < factor; x++, p += 4)
+				{
+					sum[0] += p[0];
+					sum[1] += p[1];
+					sum[2] += p[2];
+					sum[3] += p[3];
+				}
+			}
+
+			output[r*columns + c] = (sum[0]/area) | ((sum[1]/area) << 8) | ((sum[2]/area) << 16) | ((sum[3]/area) << 24);
+		}
+	}
+}
@@ -0,0 +1,213 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Processing of the screenshot pixels, on the server side. The functions
+   work on raw 32 bits per pixel buffers, as those of QImage::Format_RGB32
+   and Format_ARGB32, so they can be used from any thread. Where the CPU
+   supports it, the inner loops use SSE instructions, otherwise a plain C
+   implementation that gives the exact same results is used.
+
+   The QOI encoder of the screenshots also works on the raw pixels.
+ */
+#ifndef __ISABEL_PIXELS_H__
+#define __ISABEL_PIXELS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+#define PIXELS_NO_LIMIT (~(uint64_t)0)	/* compare all of the pixels, see pixels_sad() */
+
+typedef struct{
+	int 	 x; 		// horizontal position of the match, in the haystack
+	int 	 y; 		// vertical position of the match, in the haystack
+	uint64_t sad; 		// sum of the absolute differences of the color channels
+} T_MATCH;
+
+typedef struct{
+	uint64_t count; 	// number of pixels that differ
+	int 	 left; 		// bounding box of the pixels that differ, valid if count is not zero
+	int 	 top;
+	int 	 right; 	// the last column and row are included in the bounding box
+	int 	 bottom;
+} T_DIFFERENCE;
+
+/*--------------------- Public Function Declarations ----------------*/
+
+/* Compute a 64 bits hash of a rectangle of pixels.
+
+	@pixels 	the top left pixel of the rectangle
+	@stride 	distance, in bytes, between two rows of pixels
+	@width 		width of the rectangle, in pixels
+	@height 	height of the rectangle, in pixels
+
+	#returns the hash of the pixels, padding bytes between the rows are ignored
+*/
+uint64_t pixels_hash(const uint8_t *pixels, int stride, int width, int height);
+
+/* Split an image in tiles and find those that changed since the previous image.
+
+	@pixels 	the top left pixel of the image
+	@stride 	distance, in bytes, between two rows of pixels
+	@width 		width of the image, in pixels
+	@height 	height of the image, in pixels
+	@tile 		size of the square tiles, the tiles in the last row and column might be smaller
+	@hashes 	the hashes of the tiles of the previous image, replaced by those of this image.
+				If it is empty, or has a different number of tiles, all of the tiles changed.
+	@changed 	where the indexes of the changed tiles are returned, row by row
+
+	#returns the number of tiles in each row
+*/
+int pixels_changed_tiles(const uint8_t *pixels, int stride, int width, int height, int tile,
+						 std::vector<uint64_t> &hashes, std::vector<int> &changed);
+
+/* Compute the sum of the absolute differences between two rectangles of pixels.
+
+	@first 			the top left pixel of the first rectangle
+	@first_stride 	distance, in bytes, between two rows of the first rectangle
+	@second 		the top left pixel of the second rectangle
+	@second_stride 	distance, in bytes, between two rows of the second rectangle
+	@width 			width of the rectangles, in pixels
+	@height 		height of the rectangles, in pixels
+	@limit 			stop as soon as the sum exceeds this value
+
+	#returns the sum of the absolute differences of the red, green and blue channels,
+			 the alpha channel is ignored. If larger than limit, the sum is partial.
+*/
+uint64_t pixels_sad(const uint8_t *first, int first_stride, const uint8_t *second, int second_stride,
+					int width, int height, uint64_t limit);
+
+/* Compare two rectangles of pixels.
+
+	@first 			the top left pixel of the first rectangle
+	@first_stride 	distance, in bytes, between two rows of the first rectangle
+	@second 		the top left pixel of the second rectangle
+	@second_stride 	distance, in bytes, between two rows of the second rectangle
+	@width 			width of the rectangles, in pixels
+	@height 		height of the rectangles, in pixels
+	@tolerance 		pixels differ if any of the color channels differs by more than this
+	@ignore 		one byte per pixel, row by row, pixels whose byte is not zero are not
+					compared. Use NULL to compare all of the pixels.
+	@difference 	where the number of pixels that differ, and their bounding box, is returned
+	@mismatches 	one byte per pixel, row by row, where 1 is written for the pixels that
+					differ and 0 for the others. Use NULL if not needed.
+
+	The alpha channel is ignored.
+*/
+void pixels_compare(const uint8_t *first, int first_stride, const uint8_t *second, int second_stride,
+					int width, int height, int tolerance, const uint8_t *ignore,
+					T_DIFFERENCE &difference, uint8_t *mismatches);
+
+/* Search for the best matches of the needle inside the haystack.
+
+	@haystack 		 the top left pixel of the image where to search
+	@haystack_stride distance, in bytes, between two rows of the haystack
+	@haystack_width  width of the haystack, in pixels
+	@haystack_height height of the haystack, in pixels
+	@needle 		 the top left pixel of the image to search for
+	@needle_stride 	 distance, in bytes, between two rows of the needle
+	@needle_width 	 width of the needle, in pixels
+	@needle_height 	 height of the needle, in pixels
+	@count 			 maximum number of matches to return
+	@matches 		 where the matches are returned, the best first
+
+	The search is done first on reduced copies of both images, and then refined
+	around the best candidates, which are at least half a needle apart.
+*/
+void pixels_find(const uint8_t *haystack, int haystack_stride, int haystack_width, int haystack_height,
+				 const uint8_t *needle, int needle_stride, int needle_width, int needle_height,
+				 int count, std::vector<T_MATCH> &matches);
+
+/* Reduce a rectangle of pixels to a small grayscale image.
+
+	@pixels 	the top left pixel of the rectangle
+	@stride 	distance, in bytes, between two rows of pixels
+	@width 		width of the rectangle, in pixels
+	@height 	height of the rectangle, in pixels
+	@columns 	width of the grayscale image
+	@rows 		height of the grayscale image
+	@cells 		where the grayscale image is returned, row by row
+
+	Each cell is the average luminance of the pixels it covers, rectangles
+	smaller than the grayscale image are stretched.
+*/
+void pixels_gray_cells(const uint8_t *pixels, int stride, int width, int height, int columns, int rows,
+					   std::vector<uint32_t> &cells);
+
+/* Compute the difference hash of a rectangle of pixels.
+
+	@pixels 	the top left pixel of the rectangle
+	@stride 	distance, in bytes, between two rows of pixels
+	@width 		width of the rectangle, in pixels
+	@height 	height of the rectangle, in pixels
+
+	#returns the hash, each bit is set if a cell of a 9x8 grayscale version
+	of the pixels is brighter than the cell to its left
+*/
+uint64_t pixels_dhash(const uint8_t *pixels, int stride, int width, int height);
+
+/* Compute the perceptual hash of a rectangle of pixels.
+
+	@pixels 	the top left pixel of the rectangle
+	@stride 	distance, in bytes, between two rows of pixels
+	@width 		width of the rectangle, in pixels
+	@height 	height of the rectangle, in pixels
+
+	#returns the hash, each bit is set if one of the 8x8 lowest frequencies of the
+	DCT of a 32x32 grayscale version of the pixels is above their median
+*/
+uint64_t pixels_phash(const uint8_t *pixels, int stride, int width, int height);
+
+/* Select the implementation of the inner loops, to compare them in the unit tests.
+
+	@enable 	if true, use the SSE instructions where the CPU supports them,
+				otherwise always use the plain C implementation
+*/
+void pixels_use_simd(bool enable);
+
+/* Return the largest size of a QOI encoded image, see pixels_qoi().
+
+	@width 		width of the image, in pixels
+	@height 	height of the image, in pixels
+
+	#returns the size, in bytes
+*/
+size_t pixels_qoi_size(int width, int height);
+
+/* Encode an image using the QOI format.
+
+	@pixels 	the top left pixel of the image
+	@stride 	distance, in bytes, between two rows of pixels
+	@width 		width of the image, in pixels
+	@height 	height of the image, in pixels
+	@opaque 	if true, the alpha channel is ignored and the image has three channels
+	@output 	where the encoded image is written, of at least pixels_qoi_size() bytes
+
+	#returns the size of the encoded image, in bytes
+*/
+size_t pixels_qoi(const uint8_t *pixels, int stride, int width, int height, bool opaque, uint8_t *output);
+
+#endif
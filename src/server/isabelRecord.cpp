@@ -0,0 +1,286 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelRecord.h"
+#include "protocol.pb.h"
+
+#include <QMutexLocker>
+
+extern "C"
+{
+	#include <X11/Xlib.h>
+	#include <X11/Xproto.h>
+	#include <X11/extensions/record.h>
+}
+
+/*--------------------- Private Data Declarations ----------------*/
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Receive the data recorded by the X11 server, called from the recording thread.
+
+	@closure 	the recorder
+	@data 		the recorded data
+*/
+static void record_callback(XPointer closure, XRecordInterceptData *data);
+
+/*--------------------- Public Class Definitions -------------------*/
+
+isabelRecord::isabelRecord(QObject *parent)
+: QThread(parent)
+{
+	context 		 = 0;
+	enabled 		 = false;
+	synced 			 = false;
+	offset 			 = 0;
+	xpos 			 = 0;
+	ypos 			 = 0;
+	ring 			 = NULL;
+	lock 			 = NULL;
+	keymap 			 = NULL;
+
+	/* the data connection is blocked while recording, so it cannot control it */
+	control = (void *)XOpenDisplay(NULL);
+	data 	= (void *)XOpenDisplay(NULL);
+}
+
+isabelRecord::~isabelRecord()
+{
+	end();
+
+	if(NULL != control)
+	{
+		XCloseDisplay((Display *)control);
+	}
+
+	if(NULL != data)
+	{
+		XCloseDisplay((Display *)data);
+	}
+}
+
+bool isabelRecord::available(void)
+{
+	int major;
+	int minor;
+
+	if((NULL == control) || (NULL == data))
+	{
+		return false;
+	}
+
+	return XRecordQueryVersion((Display *)control,&major,&minor);
+}
+
+bool isabelRecord::begin(int xpos, int ypos, T_EVENT_RING *ring, QMutex *lock, const isabelKeymap *keymap)
+{
+	if((0 != context) || !available())
+	{
+		return false;
+	}
+
+	XRecordRange *range = XRecordAllocRange();
+
+	if(NULL == range)
+	{
+		return false;
+	}
+
+	/* only the keyboard and mouse events, as they come from the devices */
+	range->device_events.first = KeyPress;
+	range->device_events.last  = MotionNotify;
+
+	XRecordClientSpec clients = XRecordAllClients;
+
+	context = XRecordCreateContext((Display *)control,0,&clients,1,&range,1);
+	XFree(range);
+
+	if(0 == context)
+	{
+		return false;
+	}
+
+	/* the context must exist before the data connection enables it */
+	XSync((Display *)control,False);
+
+	this->xpos 	 = xpos;
+	this->ypos 	 = ypos;
+	this->ring 	 = ring;
+	this->lock 	 = lock;
+	this->keymap = keymap;
+	this->synced = false;
+	this->offset = 0;
+
+	state.lock();
+	enabled = false;
+	state.unlock();
+
+	clock.start();
+
+	start();
+
+	return true;
+}
+
+void isabelRecord::end(void)
+{
+	if(0 == context)
+	{
+		return;
+	}
+
+	/* disabling the context before the recording thread enabled it does nothing,
+	   and the thread would then block forever */
+	state.lock();
+
+	while(!enabled)
+	{
+		ready.wait(&state);
+	}
+
+	state.unlock();
+
+	/* unblocks the recording thread */
+	XRecordDisableContext((Display *)control,context);
+	XFlush((Display *)control);
+
+	wait();
+
+	XRecordFreeContext((Display *)control,context);
+	XFlush((Display *)control);
+	context = 0;
+}
+
+void isabelRecord::intercept(int type, int detail, unsigned int state, int xpos, int ypos, unsigned long time)
+{
+	T_USER_EVENT event = T_USER_EVENT();
+
+	/* the keymap is read again by the caller when the mapping changes */
+	QMutexLocker locker(lock);
+
+	if(!synced)
+	{
+		/* relate the X11 server time with the begin of the recording */
+		offset = (long)time - (long)clock.elapsed();
+		synced = true;
+	}
+
+	long instant = (long)time - offset;
+
+	/* the X11 server time is in milliseconds, but it is when the event happened */
+	event.instant = (0 < instant) ? 1000*(uint64_t)instant : 0;
+
+	switch(type)
+	{
+		case MotionNotify:
+			if((xpos == this->xpos) && (ypos == this->ypos))
+			{
+				return;
+			}
+
+			event.type = UserEvent::MOUSE_MOVE_REL;
+			event.xpos = xpos - this->xpos;
+			event.ypos = ypos - this->ypos;
+
+			this->xpos = xpos;
+			this->ypos = ypos;
+			break;
+
+		case ButtonPress:
+		case ButtonRelease:
+			event.type  = UserEvent::MOUSE_BUTTON;
+			event.press = (ButtonPress == type);
+			event.code  = detail;
+			break;
+
+		case KeyPress:
+		case KeyRelease:
+			{
+				unsigned long keysym = keymap->keysym(detail,state);
+
+				if(NoSymbol == keysym)
+				{
+					return;
+				}
+
+				/* named when drained, so nothing is allocated while recording */
+				event.type  = UserEvent::KEYBOARD;
+				event.press = (KeyPress == type);
+				event.code  = keysym;
+			}
+			break;
+
+		default:
+			return;
+	}
+
+	ring_push(*ring,event);
+}
+
+void isabelRecord::started(void)
+{
+	QMutexLocker locker(&state);
+
+	enabled = true;
+	ready.wakeAll();
+}
+
+void isabelRecord::run(void)
+{
+	/* blocks until the context is disabled by the control connection */
+	XRecordEnableContext((Display *)data,context,record_callback,(XPointer)this);
+
+	/* the context might have failed to be enabled, do not leave end() waiting */
+	started();
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static void record_callback(XPointer closure, XRecordInterceptData *data)
+{
+	isabelRecord *recorder = (isabelRecord *)closure;
+
+	if(XRecordStartOfData == data->category)
+	{
+		/* the context is enabled, it can be disabled from now on */
+		recorder->started();
+	}
+	else if((XRecordFromServer == data->category) && (NULL != data->data))
+	{
+		xEvent *event = (xEvent *)data->data;
+
+		recorder->intercept(event->u.u.type & 0x7F,
+							event->u.u.detail,
+							event->u.keyButtonPointer.state,
+							event->u.keyButtonPointer.rootX,
+							event->u.keyButtonPointer.rootY,
+							data->server_time);
+	}
+
+	/* the data is allocated by the X11 library for each callback */
+	XRecordFreeData(data);
+}
@@ -0,0 +1,126 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Recording of the user input events with the X11 RECORD extension. The
+   X11 server sends every mouse and keyboard event, with the time it
+   happened, as soon as it happens, so no event is lost between two
+   samples and nothing is done while the user is idle.
+
+   The events are received on a dedicated X11 connection, in a dedicated
+   thread, so the GUI thread of the application under test is not
+   involved. A second connection controls the recording, as the first one
+   is blocked while receiving the events.
+ */
+#ifndef __ISABEL_RECORD_H__
+#define __ISABEL_RECORD_H__
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+#include "isabelRing.h"
+#include "isabelKeymap.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelRecord : public QThread {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@parent 	the parent QObject
+	*/
+	isabelRecord(QObject *parent);
+
+	/* Class destructor.
+
+		Stops the recording, if any.
+	*/
+	virtual ~isabelRecord();
+
+	/* Return true if the X11 server supports the RECORD extension.
+	*/
+	bool available(void);
+
+	/* Begin recording the user events.
+
+		@xpos 	the current horizontal position of the mouse
+		@ypos 	the current vertical position of the mouse
+		@ring 	where the recorded events are added
+		@lock 	protects the ring, which the caller drains while recording, and the keymap
+		@keymap names the keys, the caller reads it again when the mapping changes
+
+		#returns true if successfull, false otherwise
+	*/
+	bool begin(int xpos, int ypos, T_EVENT_RING *ring, QMutex *lock, const isabelKeymap *keymap);
+
+	/* Stop recording the user events, those recorded so far stay in the ring.
+	*/
+	void end(void);
+
+	/* Convert an event sent by the X11 server, called from the recording thread.
+
+		@type 		the X11 event type
+		@detail 	the key code, or the mouse button
+		@state 		the keyboard modifiers and mouse buttons, before the event
+		@xpos 		horizontal position of the mouse
+		@ypos 		vertical position of the mouse
+		@time 		the X11 server time of the event, in milliseconds
+	*/
+	void intercept(int type, int detail, unsigned int state, int xpos, int ypos, unsigned long time);
+
+	/* The X11 server began sending the events, or the recording could not begin,
+	   called from the recording thread.
+	*/
+	void started(void);
+
+protected:
+	/* Receive the events, until the recording is stopped.
+	*/
+	void run(void);
+
+private:
+	void 		  			 *control; 	/* X11 client that controls the recording */
+	void 		  			 *data; 	/* X11 client that receives the recorded events */
+	QMutex 					 state; 	/* protects enabled */
+	QWaitCondition 			 ready; 	/* signaled once enabled is set */
+	bool 					 enabled; 	/* true once the context is enabled, it can only be disabled then */
+	unsigned long 			 context; 	/* the recording context, 0 if none */
+	T_EVENT_RING 			 *ring; 	/* where the recorded events are added */
+	QMutex 		  			 *lock; 	/* protects the ring and the keymap */
+	const isabelKeymap 		 *keymap; 	/* names the keys */
+	QElapsedTimer 			 clock; 	/* time since the recording began */
+	bool 					 synced; 	/* true once the X11 server time is related to the clock */
+	long 					 offset; 	/* X11 server time when the recording began */
+	int 					 xpos; 		/* last horizontal position of the mouse */
+	int 					 ypos; 		/* last vertical position of the mouse */
+};
+
+#endif
@@ -0,0 +1,460 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelReplay.h"
+#include "isabelX11.h"
+#include "isabelEvents.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+#define REPLAY_BATCH (4096)	/* events injected, and sent to the X11 server at once, before returning to the event loop */
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Return the time of the monotonic clock, in microseconds.
+*/
+static uint64_t replay_clock(void);
+
+/* Return the recorded instant of an event, in microseconds.
+
+	@event 	the event
+*/
+static uint64_t replay_instant(const UserEvent &event);
+
+/*--------------------- Public Class Definitions -------------------*/
+
+isabelReplay::isabelReplay(QTcpSocket *client, isabelX11 *x11, isabelEvents *qt_events, float speed, unsigned int timeout, QObject *parent)
+: isabelWait(client,timeout,parent)
+{
+	this->x11 		= x11;
+	this->qt_events = qt_events;
+	this->speed 	= speed;
+
+	journaling = false;
+	pending    = false;
+	index 	   = 0;
+	timer 	   = -1;
+	notifier   = NULL;
+	sync 	   = NULL;
+	stopped    = false;
+	started    = 0;
+	base 	   = 0;
+	origin 	   = 0;
+	last 	   = 0;
+	first 	   = true;
+	sync_began = 0;
+	waited 	   = 0;
+	events 	   = 0;
+	syncs 	   = 0;
+
+	/* connected before the server, so the report is in the response it sends */
+	connect(this,SIGNAL(finished()),this,SLOT(report()));
+}
+
+isabelReplay::~isabelReplay()
+{
+	delete notifier;
+
+	if(0 <= timer)
+	{
+		close(timer);
+	}
+}
+
+void isabelReplay::add(const ReplayStep &step, QObject *object)
+{
+	steps.push_back(step);
+	objects.push_back(object);
+}
+
+bool isabelReplay::load(const char *path)
+{
+	journaling = journal.open(path);
+
+	return journaling;
+}
+
+void isabelReplay::start(void)
+{
+	started = replay_clock();
+	timer 	= timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if(0 > timer)
+	{
+		finish(Response::UNKNOWN_ERROR);
+		return;
+	}
+
+	notifier = new QSocketNotifier(timer,QSocketNotifier::Read,this);
+	connect(notifier,SIGNAL(activated(int)),this,SLOT(inject()));
+
+	pending = fetch();
+
+	/* starts the timeout, and finishes right away if there are no steps */
+	isabelWait::start();
+
+	schedule();
+}
+
+void isabelReplay::inject(void)
+{
+	uint64_t 	 expirations;
+	unsigned int batch 	= 0;
+	bool 		 queued = false;
+
+	/* acknowledge the expiration, otherwise the notifier keeps reporting it */
+	if(sizeof(expirations) != read(timer,&expirations,sizeof(expirations)))
+	{
+		expirations = 0;
+	}
+
+	/* the mapping only changes between batches, not for each key */
+	x11->refresh_keymap();
+
+	while(!stopped && pending && current.has_event() && (REPLAY_BATCH > batch))
+	{
+		uint64_t due = deadline();
+		uint64_t now = replay_clock();
+
+		if(now < due)
+		{
+			break;
+		}
+
+		/* the Qt events are delivered right away, while the X11 events queued before only reach the
+		   application once it reads them from its X11 connection, so the batch ends here, and the Qt
+		   event is simulated after the event loop ran, on the timer that expires at once */
+		if(queued && current.event().has_path())
+		{
+			break;
+		}
+
+		Response::Error error = simulate(current.event());
+
+		if(Response::NO_ERROR != error)
+		{
+			finish(error);
+			return;
+		}
+
+		queued = queued || !current.event().has_path();
+
+		if(0 < speed)
+		{
+			late.push_back((uint32_t)std::min<uint64_t>(now - due,0xFFFFFFFF));
+		}
+
+		last = replay_instant(current.event());
+		events++;
+		batch++;
+
+		pending = fetch();
+	}
+
+	/* a single round trip for all of the X11 events injected together */
+	if(queued && !x11->flush_user())
+	{
+		finish(Response::X11_ERROR);
+		return;
+	}
+
+	schedule();
+}
+
+void isabelReplay::synced(void)
+{
+	isabelWait 		*reached = qobject_cast<isabelWait*>(sender());
+	Response::Error error 	 = reached->response().error();
+
+	reached->deleteLater();
+	sync = NULL;
+
+	if(stopped)
+	{
+		return;
+	}
+
+	if(Response::NO_ERROR != error)
+	{
+		finish(error);
+		return;
+	}
+
+	uint64_t now = replay_clock();
+
+	syncs++;
+	pending = fetch();
+
+	if(pending && current.has_event() && !first && (0 < speed))
+	{
+		/* the timeline only moves if the sync point was reached after the next event was due */
+		uint64_t due = deadline();
+
+		if(now > due)
+		{
+			base   += now - due;
+			waited += now - due;
+		}
+	}
+	else
+	{
+		waited += now - sync_began;
+	}
+
+	schedule();
+}
+
+void isabelReplay::report(void)
+{
+	if(stopped)
+	{
+		return;
+	}
+
+	stopped = true;
+
+	if(NULL != notifier)
+	{
+		notifier->setEnabled(false);
+	}
+
+	if(NULL != sync)
+	{
+		sync->disconnect(this);
+		sync->deleteLater();
+		sync = NULL;
+	}
+
+	if(Response::NO_ERROR != result.error())
+	{
+		/* the keys pressed by the events replayed so far would stay pressed */
+		x11->release_user();
+	}
+
+	ReplayReport *replay = result.mutable_replay();
+
+	replay->set_events(events);
+	replay->set_syncs(syncs);
+	replay->set_step(pending ? index - 1 : index);
+	replay->set_duration_us(replay_clock() - started);
+	replay->set_scheduled_us(((0 < speed) && !first) ? (uint64_t)((double)(last - origin)/speed) : 0);
+	replay->set_waited_us(waited);
+
+	if(!late.empty())
+	{
+		uint64_t total = 0;
+
+		for(unsigned int e = 0; e < late.size(); e++)
+		{
+			total += late[e];
+		}
+
+		replay->set_mean_late_us(total/late.size());
+		replay->set_max_late_us(*std::max_element(late.begin(),late.end()));
+
+		/* the events are all replayed, their order does not matter anymore */
+		std::vector<uint32_t>::iterator p99 = late.begin() + (99*(late.size() - 1))/100;
+
+		std::nth_element(late.begin(),p99,late.end());
+		replay->set_p99_late_us(*p99);
+	}
+}
+
+bool isabelReplay::condition(void)
+{
+	return !pending;
+}
+
+bool isabelReplay::fetch(void)
+{
+	object = NULL;
+
+	if(!journaling)
+	{
+		if(index >= steps.size())
+		{
+			return false;
+		}
+
+		current.CopyFrom(steps[index]);
+		object = objects[index];
+		index++;
+
+		return true;
+	}
+
+	/* the file is decoded as it is replayed */
+	T_USER_EVENT recorded;
+
+	if(!journal.next(recorded))
+	{
+		return false;
+	}
+
+	current.Clear();
+
+	UserEvent *event = current.mutable_event();
+
+	event->set_type((UserEvent::Type)recorded.type);
+	event->set_instant(recorded.instant/1000);
+	event->set_instant_us(recorded.instant);
+
+	switch(recorded.type)
+	{
+		case UserEvent::KEYBOARD:
+			event->set_key(journal.key(recorded.code));
+			event->set_press(recorded.press);
+			break;
+
+		case UserEvent::MOUSE_BUTTON:
+			event->set_button(recorded.code);
+			event->set_press(recorded.press);
+			break;
+
+		default:
+			event->set_xpos(recorded.xpos);
+			event->set_ypos(recorded.ypos);
+			break;
+	}
+
+	index++;
+
+	return true;
+}
+
+void isabelReplay::schedule(void)
+{
+	if(stopped)
+	{
+		return;
+	}
+
+	if(!pending)
+	{
+		/* all of the steps were replayed */
+		evaluate();
+		return;
+	}
+
+	if(current.has_event())
+	{
+		if(first)
+		{
+			/* the timeline begins with the first event */
+			base   = replay_clock();
+			origin = replay_instant(current.event());
+			last   = origin;
+			first  = false;
+		}
+
+		struct itimerspec spec;
+		uint64_t 		  due = std::max<uint64_t>(deadline(),1);
+
+		/* an absolute deadline, so the delays do not add up, and one already passed expires at once */
+		memset(&spec,0x00,sizeof(spec));
+		spec.it_value.tv_sec  = due/1000000;
+		spec.it_value.tv_nsec = (due%1000000)*1000;
+
+		if(0 != timerfd_settime(timer,TFD_TIMER_ABSTIME,&spec,NULL))
+		{
+			finish(Response::UNKNOWN_ERROR);
+		}
+
+		return;
+	}
+
+	/* a sync point */
+	sync_began = replay_clock();
+
+	if(current.idle())
+	{
+		sync = new isabelWaitIdle(NULL,current.animations(),current.timeout(),this);
+	}
+	else if(!object.isNull())
+	{
+		sync = new isabelWaitProperty(NULL,object,current.condition(),current.timeout(),this);
+	}
+	else
+	{
+		/* the object was destroyed during the replay */
+		finish(Response::UNKNOWN_OBJECT_ID);
+		return;
+	}
+
+	connect(sync,SIGNAL(finished()),this,SLOT(synced()));
+
+	/* the sync point might be reached right away */
+	sync->start();
+}
+
+uint64_t isabelReplay::deadline(void)
+{
+	uint64_t instant = replay_instant(current.event());
+
+	if(0 >= speed)
+	{
+		/* as fast as possible, always due */
+		return 0;
+	}
+
+	return base + ((instant > origin) ? (uint64_t)((double)(instant - origin)/speed) : 0);
+}
+
+Response::Error isabelReplay::simulate(const UserEvent &event)
+{
+	if(event.has_path())
+	{
+		/* recorded from the Qt events, it goes straight to its target object */
+		return qt_events->simulate(event);
+	}
+
+	/* sent to the X11 server once the whole batch is injected */
+	return x11->inject_user(event) ? Response::NO_ERROR : Response::X11_ERROR;
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static uint64_t replay_clock(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+
+	return (uint64_t)now.tv_sec*1000000 + now.tv_nsec/1000;
+}
+
+static uint64_t replay_instant(const UserEvent &event)
+{
+	return event.has_instant_us() ? event.instant_us() : 1000*(uint64_t)event.instant();
+}
@@ -0,0 +1,179 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Replay of a sequence of user events on the server timeline. The client
+   uploads the whole sequence at once, or names a file recorded on the
+   server, and only gets the response once it was replayed, so neither the
+   network round trip nor the client scheduling delay the events.
+
+   Each event is injected at its recorded instant, relative to the first
+   one and divided by the speed multiplier. The deadlines are absolute
+   times on the monotonic clock, armed on a timerfd, so the delays do not
+   add up from one event to the next. A speed of 0 injects the events as
+   fast as possible. The X11 events are sent to the X11 server in batches
+   of a few thousands, each with a single round trip.
+
+   The sync points stop the timeline until an object property satisfies
+   a condition, or until the application is idle, as the WAIT_FOR and
+   WAIT_IDLE requests do. The events after a sync point keep their pace,
+   shifted by how late the sync point was reached.
+
+   The response reports how late, past their deadline, the events were
+   injected, as the event loop of the application under test can only
+   inject them once it is free.
+ */
+#ifndef __ISABEL_REPLAY_H__
+#define __ISABEL_REPLAY_H__
+
+#include <QObject>
+#include <QPointer>
+#include <QSocketNotifier>
+#include <QTcpSocket>
+
+#include <stdint.h>
+#include <vector>
+
+#include "protocol.pb.h"
+#include "isabelWait.h"
+#include "isabelJournal.h"
+
+class isabelX11;
+class isabelEvents;
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelReplay : public isabelWait {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@x11 		injects the X11 events
+		@qt_events 	injects the Qt events, those with the path of their target object
+		@speed 		the speed multiplier, 0 injects the events as fast as possible
+		@timeout 	how long the whole replay can take, in milliseconds, 0 waits forever
+		@parent 	the parent QObject
+	*/
+	isabelReplay(QTcpSocket *client, isabelX11 *x11, isabelEvents *qt_events, float speed, unsigned int timeout, QObject *parent);
+
+	/* Class destructor.
+	*/
+	virtual ~isabelReplay();
+
+	/* Add a step to the replay.
+
+		@step 		the event, or sync point
+		@object 	for sync points on an object property, the object
+	*/
+	void add(const ReplayStep &step, QObject *object);
+
+	/* Replay the events of a file recorded on the server, instead of the steps.
+
+		@path 	the name of the file
+
+		#returns true if successfull, false if it cannot be read
+	*/
+	bool load(const char *path);
+
+	/* Begin the replay.
+	*/
+	void start(void);
+
+public slots:
+	/* Inject the events whose deadline has passed.
+	 */
+	void inject(void);
+
+	/* A sync point was reached, or failed.
+	 */
+	void synced(void);
+
+	/* Stop the replay and report its timing, once finished.
+	 */
+	void report(void);
+
+protected:
+	/* The replay is complete once all of the steps were replayed.
+
+		#returns true if there are no steps left, false otherwise
+	*/
+	bool condition(void);
+
+private:
+	/* Move to the next step.
+
+		#returns true if there is one, false at the end of the replay
+	*/
+	bool fetch(void);
+
+	/* Arm the timer for the next event, or begin waiting for the next sync point.
+	*/
+	void schedule(void);
+
+	/* Return the deadline of the current event, in microseconds of the monotonic clock.
+	*/
+	uint64_t deadline(void);
+
+	/* Inject an event, to the X11 server or to its target object.
+
+		@event 	the event to inject
+
+		#returns NO_ERROR if successfull, the error code otherwise
+	*/
+	Response::Error simulate(const UserEvent &event);
+
+private:
+	isabelX11 			 	 *x11; 		/* injects the X11 events */
+	isabelEvents 			 *qt_events; /* injects the Qt events */
+	float 					 speed; 	/* the speed multiplier, 0 as fast as possible */
+	std::vector<ReplayStep>  steps; 	/* the steps to replay, unless replaying a file */
+	std::vector< QPointer<QObject> > objects; /* the object of each sync point */
+	isabelJournalReader 	 journal; 	/* the file to replay */
+	bool 					 journaling; /* true when replaying the file */
+	ReplayStep 				 current; 	/* the current step */
+	QPointer<QObject> 		 object; 	/* the object of the current sync point */
+	bool 					 pending; 	/* true while there is a current step */
+	unsigned int 			 index; 	/* index of the step after the current one */
+	int 					 timer; 	/* the timerfd, -1 if none */
+	QSocketNotifier 		 *notifier; /* reports when the timerfd expires */
+	isabelWait 				 *sync; 	/* waits for the current sync point, NULL if none */
+	bool 					 stopped; 	/* true once the replay is over */
+	uint64_t 				 started; 	/* when the replay began, in microseconds */
+	uint64_t 				 base; 		/* when the first event is due, in microseconds */
+	uint64_t 				 origin; 	/* recorded instant of the first event, in microseconds */
+	uint64_t 				 last; 		/* recorded instant of the last event injected */
+	bool 					 first; 	/* true until the first event is injected */
+	uint64_t 				 sync_began; /* when the current sync point began, in microseconds */
+	uint64_t 				 waited; 	/* time spent waiting at the sync points, beyond the schedule */
+	unsigned int 			 events; 	/* number of events injected */
+	unsigned int 			 syncs; 	/* number of sync points reached */
+	std::vector<uint32_t> 	 late; 		/* how late each event was injected, in microseconds */
+};
+
+#endif
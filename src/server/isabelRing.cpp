@@ -0,0 +1,94 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelRing.h"
+
+#include <algorithm>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+/*--------------------- Public Function Definitions ----------------*/
+
+void ring_init(T_EVENT_RING &ring, unsigned int capacity)
+{
+	/* the memory is taken once, never while recording */
+	ring.slots.assign(std::max(1U,capacity),T_USER_EVENT());
+	ring.head 	 = 0;
+	ring.count 	 = 0;
+	ring.dropped = 0;
+}
+
+void ring_push(T_EVENT_RING &ring, const T_USER_EVENT &event)
+{
+	size_t capacity = ring.slots.size();
+
+	if(0 == capacity)
+	{
+		ring_init(ring,1);
+		capacity = 1;
+	}
+
+	if(ring.count < capacity)
+	{
+		ring.slots[(ring.head + ring.count) % capacity] = event;
+		ring.count++;
+	}
+	else
+	{
+		/* full, the oldest event gives its place to the newest */
+		ring.slots[ring.head] = event;
+		ring.head = (ring.head + 1) % capacity;
+		ring.dropped++;
+	}
+}
+
+unsigned int ring_drain(T_EVENT_RING &ring, std::vector<T_USER_EVENT> &events, unsigned int &dropped)
+{
+	size_t capacity = ring.slots.size();
+	size_t removed 	= ring.count;
+
+	/* at most two contiguous runs: from the head to the end, then from the start */
+	if(0 < removed)
+	{
+		size_t first = std::min(removed,capacity - ring.head);
+
+		events.insert(events.end(),ring.slots.begin() + ring.head,ring.slots.begin() + ring.head + first);
+		events.insert(events.end(),ring.slots.begin(),ring.slots.begin() + (removed - first));
+	}
+
+	/* the next events follow the drained ones, so the ring is used evenly */
+	if(0 < capacity)
+	{
+		ring.head = (ring.head + removed) % capacity;
+	}
+
+	dropped 	 = ring.dropped;
+	ring.count 	 = 0;
+	ring.dropped = 0;
+
+	return removed;
+}
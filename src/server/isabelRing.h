@@ -0,0 +1,87 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Bounded buffer of the recorded user events. The events are kept as
+   plain structures in a ring of fixed capacity, allocated once when the
+   recording begins, so recording never allocates memory and a long
+   session never takes more than the ring. Once the ring is full, each
+   new event overwrites the oldest one, which is counted as dropped.
+
+   The client drains the ring while the recording goes on, which frees
+   the room taken by the events it received. The ring is not thread safe,
+   its owner must serialize the accesses.
+ */
+#ifndef __ISABEL_RING_H__
+#define __ISABEL_RING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+typedef struct{
+	uint64_t instant; 		// time, in microseconds, since the recording began
+	int32_t  xpos; 			// for mouse movements, the horizontal position or displacement
+	int32_t  ypos; 			// for mouse movements, the vertical position or displacement
+	uint32_t code; 			// for key events the key symbol, for button events the button number
+	int32_t  jitter; 		// when polled, how much longer than the sampling period the sample took, in microseconds
+	uint8_t  type; 			// the event type, one of UserEvent::Type
+	uint8_t  press; 		// for key and button events, 1 if pressed, 0 if released
+} T_USER_EVENT;
+
+typedef struct{
+	std::vector<T_USER_EVENT> slots; 	// the ring, its size is the capacity
+	size_t 					  head; 	// index of the oldest event
+	size_t 					  count; 	// number of events in the ring
+	uint32_t 				  dropped; 	// number of events overwritten since the last drain
+} T_EVENT_RING;
+
+/*--------------------- Public Function Declarations ----------------*/
+
+/* Empty the ring and set its capacity.
+
+	@ring 		the ring
+	@capacity 	maximum number of events kept, at least 1
+*/
+void ring_init(T_EVENT_RING &ring, unsigned int capacity);
+
+/* Add an event to the ring, overwriting the oldest one if the ring is full.
+
+	@ring 		the ring
+	@event 		the event to add
+*/
+void ring_push(T_EVENT_RING &ring, const T_USER_EVENT &event);
+
+/* Remove all of the events from the ring.
+
+	@ring 		the ring
+	@events 	where the events are appended, the oldest first
+	@dropped 	where the number of events overwritten since the last drain is returned
+
+	#returns the number of events removed
+*/
+unsigned int ring_drain(T_EVENT_RING &ring, std::vector<T_USER_EVENT> &events, unsigned int &dropped);
+
+#endif
@@ -33,6 +33,8 @@ QByteArray slip_encode(const QByteArray &input)
 {
 	QByteArray output;
 
+	/* escaped bytes are rare, avoid growing the output while encoding */
+	output.reserve(input.size() + input.size()/64 + 2);
 	output.append(SLIP_END);
 
 	for(int i = 0; i < input.size(); i++)
@@ -104,3 +106,18 @@ QByteArray slip_decode(const QByteArray &input)
 
 	return output;
 }
+
+int slip_packet_size(const QByteArray &input)
+{
+	/* the packet begins and ends with the delimiter, which never appears inside it */
+	int start = input.indexOf((char)SLIP_END);
+
+	if(0 > start)
+	{
+		return 0;
+	}
+
+	int end = input.indexOf((char)SLIP_END,start + 1);
+
+	return (0 > end) ? 0 : (end + 1);
+}
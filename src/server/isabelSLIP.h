@@ -57,5 +57,14 @@ QByteArray slip_encode(const QByteArray &input);
 */
 QByteArray slip_decode(const QByteArray &input);
 
+/* Find the end of the first complete SLIP packet.
+
+	@input the received bytes, possibly with an incomplete packet at the end
+
+	#returns the number of bytes up to, and including, the end of the first 
+			 packet, or 0 if there is no complete packet yet
+*/
+int slip_packet_size(const QByteArray &input);
+
 
 #endif
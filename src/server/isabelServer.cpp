@@ -28,12 +28,15 @@
 #include "isabelServer.h"
 #include "isabelSLIP.h"
 #include "isabelSerialize.h"
+#include "isabelCompress.h"
 
 #include <QByteArray>
 #include <QFile>
 #include <QApplication>
 #include <QPixmap>
 #include <QScreen>
+#include <QCryptographicHash>
+#include <QtConcurrent>
 
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QWidget>
@@ -44,6 +47,7 @@
 #include <QtCore/QMetaType>
 #include <QtCore/QMetaObject>
 #include <QtCore/QMetaProperty>
+#include <QtCore/QAbstractItemModel>
 
 #include <QtQuick/QQuickItem>
 #include <QtQuick/QQuickView>
@@ -55,14 +59,25 @@
 
 /*--------------------- Private Variable Declarations ----------------*/
 
+#define DELTA_MIN_TILE 	(16)	/* smallest tile, in pixels, of the delta screenshots */
+#define DELTA_MAX_TILE 	(1024)	/* largest tile, in pixels, of the delta screenshots */
+#define IMAGE_STORE_SIZE (64*1024*1024)	/* maximum size, in bytes, of the images kept for the clients */
+
 /*--------------------- Public Class Definitions -------------------*/
 
 isabelServer::isabelServer(int port, QObject *parent)
 : QObject(parent)
 {
 	/* create the X11 interation and TCP server objects */
-	x11    = new isabelX11(this); 
-	server = new QTcpServer(this);
+	x11    	  = new isabelX11(this); 
+	qt_events = new isabelEvents(this);
+	server 	  = new QTcpServer(this);
+
+	image_bytes = 0;
+	request_sequence = 0;
+
+	/* grab the windows through shared memory, when the X11 server supports it */
+	grab_set_x11(x11);
 
 	connect(server,SIGNAL(newConnection()),this,SLOT(new_connection()));
 
@@ -88,6 +103,17 @@ void isabelServer::new_connection(void)
 	/* get the client connection */
 	QTcpSocket *client = server->nextPendingConnection();
 
+	/* the responses are not compressed until the client asks for it */
+	T_CONNECTION state;
+	state.negotiated  = false;
+	state.compression = Compressed::NONE;
+	state.threshold   = COMPRESS_THRESHOLD;
+	state.raw_bytes   = 0;
+	state.sent_bytes  = 0;
+	state.tile_size   = 0;
+
+	connections[client] = state;
+
 	/* handle its requests until the connection is closed */
 	connect(client,SIGNAL(readyRead()),this,SLOT(ready_read()));
 	connect(client,SIGNAL(disconnected()),this,SLOT(disconnected()));
@@ -97,153 +123,381 @@ void isabelServer::ready_read(void)
 {
 	QTcpSocket* client = qobject_cast<QTcpSocket*>(sender());
 
-	/* read the complete request from the client */
-	QByteArray rx_packet = slip_decode(client->readAll());
+	/* large requests, such as uploaded images, arrive in several reads */
+	QByteArray &rx = connections[client].rx;
+	rx.append(client->readAll());
+
+	int size = slip_packet_size(rx);
 
-	if(0 < rx_packet.count())
+	while(0 < size)
 	{
-		Request  request; 
-		Response response; 
-	
-		request.ParseFromArray(rx_packet.constData(),rx_packet.count());
+		QByteArray rx_packet = slip_decode(rx.left(size));
+		rx.remove(0,size);
 
-		switch(request.type())
+		if(0 < rx_packet.count())
 		{
-			case Request::FETCH_OBJECT_TREE:
-				fetch_object_tree(response);
-				break; 
-
-			case Request::FETCH_OBJECT:
-				fetch_object(response,request.id());
-				break; 
-
-			case Request::WRITE_PROPERTY:
-				write_object_property(response,request.id(),request.property());
-				break; 
-
-			case Request::RECORD_USER:
-				record_user(response,request.start());
-				break;
-
-			case Request::SIMULATE_USER:
-				simulate_user(response,request);
-				break; 
-
-			case Request::TAKE_SCREENSHOT:
-				take_screenshot(response,request.id());
-				break;
-
-			case Request::KILL_APP:
-				/* before quitting ,send the reply to the client */
-				{
-					response.set_error(Response::NO_ERROR);
-
-					QByteArray tx_packet(response.ByteSize(),0);
-					response.SerializeToArray(tx_packet.data(),tx_packet.count());
-					client->write(slip_encode(tx_packet));
-					client->waitForBytesWritten();
-				}
-				
-				/* goodbye */
-				QApplication::quit();
-				break;
-			default:
-				response.set_error(Response::INVALID_REQUEST);
-				break; 
+			handle_request(client,rx_packet);
 		}
 
-		QByteArray tx_packet(response.ByteSize(),0);
-		response.SerializeToArray(tx_packet.data(),tx_packet.size());
-		client->write(slip_encode(tx_packet));
-		client->waitForBytesWritten();
+		/* the client might have been disconnected while handling the request */
+		if(connections.end() == connections.find(client))
+		{
+			break;
+		}
+
+		size = slip_packet_size(rx);
+	}
+}
+
+void isabelServer::handle_request(QTcpSocket *client, const QByteArray &rx_packet)
+{
+	Request  request; 
+	Response response; 
+	bool 	 reply = true;
+
+	request.ParseFromArray(rx_packet.constData(),rx_packet.count());
+
+	/* every response to this request, immediate or deferred, echoes its sequence */
+	request_sequence = request.sequence();
+
+	switch(request.type())
+	{
+		case Request::FETCH_OBJECT_TREE:
+			reply = fetch_object_tree(client);
+			break; 
+
+		case Request::FETCH_OBJECT:
+			reply = fetch_object(response,client,request.id());
+			break; 
+
+		case Request::WRITE_PROPERTY:
+			write_object_property(response,request.id(),request.property());
+			break; 
+
+		case Request::RECORD_USER:
+			record_user(response,request);
+			break;
+
+		case Request::DRAIN_EVENTS:
+			drain_events(response);
+			break;
+
+		case Request::SIMULATE_USER:
+			simulate_user(response,request);
+			break; 
+
+		case Request::TAKE_SCREENSHOT:
+			reply = take_screenshot(response,client,request);
+			break;
+
+		case Request::WAIT_FOR:
+			reply = wait_for(response,client,request);
+			break;
+
+		case Request::WAIT_IDLE:
+			reply = wait_idle(client,request);
+			break;
+
+		case Request::FETCH_MODEL_DATA:
+			reply = fetch_model_data(response,client,request.id(),request.model());
+			break;
+
+		case Request::NEGOTIATE:
+			reply = negotiate(response,client,request);
+			break;
+
+		case Request::FIND_IMAGE:
+			reply = find_image(response,client,request);
+			break;
+
+		case Request::STORE_IMAGE:
+			store_image(response,request);
+			break;
+
+		case Request::COMPARE_SCREENSHOT:
+			reply = compare_screenshot(response,client,request);
+			break;
+
+		case Request::WAIT_STABLE:
+			reply = wait_stable(response,client,request);
+			break;
+
+		case Request::REPLAY:
+			reply = replay(response,client,request);
+			break;
+
+		case Request::TYPE_TEXT:
+			reply = type_text(response,client,request);
+			break;
+
+		case Request::POINTER_PATH:
+			reply = pointer_path(response,client,request);
+			break;
+
+		case Request::CAPTURE:
+			reply = capture(response,client,request);
+			break;
+
+		case Request::KILL_APP:
+			/* before quitting ,send the reply to the client */
+			{
+				response.set_error(Response::NO_ERROR);
+				send_response(client,response,request_sequence);
+			}
+			
+			/* goodbye */
+			QApplication::quit();
+			break;
+		default:
+			response.set_error(Response::INVALID_REQUEST);
+			break; 
+	}
+
+	if(reply)
+	{
+		send_response(client,response,request_sequence);
+	}
+}
+
+void isabelServer::send_response(QTcpSocket *client, const Response &response, unsigned int sequence)
+{
+	queue_response(client,response,sequence);
+	client->waitForBytesWritten();
+}
+
+void isabelServer::queue_response(QTcpSocket *client, const Response &response, unsigned int sequence)
+{
+	QByteArray tx_packet(response.ByteSize(),0);
+	response.SerializeToArray(tx_packet.data(),tx_packet.size());
+
+	if(0 != sequence)
+	{
+		/* the parser merges concatenated messages, so the sequence is appended instead of copying
+		   the response, which might carry the encoded screenshots */
+		Response echo;
+		echo.set_sequence(sequence);
+
+		QByteArray field(echo.ByteSize(),0);
+		echo.SerializePartialToArray(field.data(),field.size());
+		tx_packet.append(field);
+	}
+
+	std::map<QTcpSocket *,T_CONNECTION>::iterator iter = connections.find(client);
+
+	if((connections.end() != iter) && iter->second.negotiated)
+	{
+		/* once negotiated, all responses are wrapped, even those left uncompressed */
+		T_CONNECTION &state = iter->second;
+		Compressed frame;
+
+		frame.set_method(Compressed::NONE);
+		frame.set_length(tx_packet.size());
+
+		if((Compressed::NONE != state.compression) && (state.threshold <= (unsigned int)tx_packet.size()))
+		{
+			QByteArray payload = compress_encode(state.compression,tx_packet);
+
+			/* random data, as PNG images, might not compress at all */
+			if(!payload.isEmpty() && (payload.size() < tx_packet.size()))
+			{
+				frame.set_method(state.compression);
+				frame.set_payload(payload.constData(),payload.size());
+			}
+		}
+
+		if(Compressed::NONE == frame.method())
+		{
+			frame.set_payload(tx_packet.constData(),tx_packet.size());
+		}
+
+		state.raw_bytes  += tx_packet.size();
+		state.sent_bytes += frame.payload().size();
+
+		tx_packet.resize(frame.ByteSize());
+		frame.SerializeToArray(tx_packet.data(),tx_packet.size());
+	}
+
+	client->write(slip_encode(tx_packet));
+}
+
+void isabelServer::capture_frame(void)
+{
+	isabelCapture *capture = qobject_cast<isabelCapture*>(sender());
+
+	/* the capture is deleted when the client disconnects */
+	if(NULL == capture->client())
+	{
+		return;
+	}
+
+	/* a slow client is handled by dropping frames, never by blocking the application */
+	queue_response(capture->client(),capture->response(),sequences[capture]);
+
+	if(Response::NO_ERROR != capture->response().error())
+	{
+		/* the capture stopped by itself */
+		connections[capture->client()].capture = NULL;
+		capture->deleteLater();
 	}
 }
 
 void isabelServer::disconnected(void)
 {
 	QTcpSocket* client = qobject_cast<QTcpSocket*>(sender());
+
+	std::map<QTcpSocket *,T_CONNECTION>::iterator iter = connections.find(client);
+
+	if(connections.end() != iter)
+	{
+		if(iter->second.negotiated)
+		{
+			fprintf(stderr,"[isabel] client sent %llu bytes of responses as %llu bytes\n",
+					iter->second.raw_bytes,iter->second.sent_bytes);
+		}
+
+		connections.erase(iter);
+	}
+
 	client->deleteLater();
 }
 
-void isabelServer::fetch_object_tree(Response &response)
+void isabelServer::wait_finished(void)
 {
-	/* clean the list of objects */
-	objects.clear(); 
+	isabelWait 		 *wait 	 = qobject_cast<isabelWait*>(sender());
+	isabelWaitStable *stable = qobject_cast<isabelWaitStable*>(wait);
 
-	/* and rebuild it */
-	QList<QWidget*> widgets = QApplication::topLevelWidgets();
-	QList<QWindow*> windows = QApplication::topLevelWindows();
+	/* the client might have disconnected in the meantime */
+	if(NULL != wait->client())
+	{
+		if((NULL != stable) && stable->send_frame() && (Response::NO_ERROR == wait->response().error()))
+		{
+			/* the stable frame is encoded in the thread pool, and sent along with the result */
+			isabelEncode *encode = create_encode(wait->client());
+
+			sequences[encode] = sequences[wait];
+			encode->start(QList<T_SHOT>() << stable->frame(),false,wait->response());
+		}
+		else
+		{
+			send_response(wait->client(),wait->response(),sequences[wait]);
+		}
+	}
 
-	Q_FOREACH(QObject *object, widgets)
+	wait->deleteLater();
+}
+
+void isabelServer::encode_finished(void)
+{
+	isabelEncode *encode = qobject_cast<isabelEncode*>(sender());
+
+	/* the client might have disconnected in the meantime */
+	if(NULL != encode->client())
 	{
-		add_object(0,object,response);
+		send_response(encode->client(),encode->response(),sequences[encode]);
 	}
-	
-	Q_FOREACH(QObject *object, windows)
+
+	encode->deleteLater();
+}
+
+void isabelServer::task_finished(void)
+{
+	isabelTask *task = qobject_cast<isabelTask*>(sender());
+
+	/* the client might have disconnected in the meantime */
+	if(NULL != task->client())
 	{
-		/* QML based windows are not shown as widgets, need to treat them separately:
-			- first we add the window
-			- then we add the root object of the QQuickView
-		 */
-		add_object(0,object,response);
-		 		
-		QQuickView *viewObj = qobject_cast<QQuickView*>(object);
+		send_response(task->client(),task->response(),sequences[task]);
+	}
+
+	task->deleteLater();
+}
+
+void isabelServer::stream_chunk(void)
+{
+	isabelStream *stream = qobject_cast<isabelStream*>(sender());
 
-		if(NULL != viewObj)
+	if(NULL == stream->client())
+	{
+		/* nobody to send the rest of the response to */
+		stream->deleteLater();
+		return;
+	}
+
+	send_response(stream->client(),stream->response(),sequences[stream]);
+
+	if(stream->finished())
+	{
+		stream->deleteLater();
+	}
+}
+
+bool isabelServer::negotiate(Response &response, QTcpSocket *client, const Request &request)
+{
+	T_CONNECTION &state = connections[client];
+
+	/* select the first method, by order of preference, also supported by the server */
+	Compressed::Method method = Compressed::NONE;
+
+	for(int m = 0; m < request.compression_size(); m++)
+	{
+		if(compress_supported(request.compression(m)))
 		{
-			QQuickItem *rootObject = viewObj->rootObject();
-			add_object(0,rootObject,response);	
+			method = request.compression(m);
+			break;
 		}
 	}
 
+	response.set_compression(method);
 	response.set_error(Response::NO_ERROR);
+
+	/* the client only expects compressed responses after this one */
+	state.negotiated = false;
+	send_response(client,response,request_sequence);
+
+	state.negotiated  = true;
+	state.compression = method;
+	state.threshold   = request.has_threshold() ? request.threshold() : COMPRESS_THRESHOLD;
+
+	return false;
 }
 
-void isabelServer::add_object(unsigned int parent, QObject *obj, Response &response)
+bool isabelServer::fetch_object_tree(QTcpSocket *client)
 {
-	/* first add the object */
-	unsigned int id = objects.size() + 1; 
-	objects.insert(std::pair<unsigned int, QObject *>(id,obj)); 
-	
-	Object *qtObj = response.add_objects(); 
-	qtObj->set_id(id);
-	qtObj->set_parent(parent);
-	qtObj->set_type(obj->metaObject()->className());
-	qtObj->set_name(obj->objectName().toUtf8().constData());
-
-	/* and then its children */
-	Q_FOREACH(QObject* child, obj->children())
+	/* a new walk invalidates the one in progress, since both rebuild the list of objects */
+	if(!tree.isNull())
 	{
-		add_object(id,child,response);
+		if(NULL != tree->client())
+		{
+			/* the client of the walk in progress still expects the end of its response */
+			Response cancelled;
+			cancelled.set_error(Response::UNKNOWN_ERROR);
+			cancelled.set_more(false);
+
+			send_response(tree->client(),cancelled,sequences[tree.data()]);
+		}
+
+		delete tree.data();
 	}
+
+	tree = new isabelStreamTree(client,objects,this);
+	start_stream(client,tree);
+
+	return false;
 }
 
-void isabelServer::fetch_object(Response &response, unsigned int id)
+bool isabelServer::fetch_object(Response &response, QTcpSocket *client, unsigned int id)
 {
 	std::map<unsigned int,QObject *>::iterator iter = objects.find(id);
 
 	if(objects.end() == iter)
 	{
 		response.set_error(Response::UNKNOWN_OBJECT_ID);	
+		return true;
 	}
-	else
-	{
-		QObject *object = iter->second;
-
-		for(int i = 0; i < object->metaObject()->propertyCount(); i++)
-		{
-			Property* prop = response.add_properties();
-			QMetaProperty property = object->metaObject()->property(i);
-			
-			prop->set_name(property.name());
-			prop->set_writable(property.isWritable());
 
-			QByteArray value = serialize_encode(property.read(object));
-			prop->set_value(value.constData(),value.count());
-		}
+	start_stream(client,new isabelStreamProperties(client,iter->second,this));
 
-		response.set_error(Response::NO_ERROR);		
-	}
+	return false;
 }
 
 void isabelServer::write_object_property(Response &response, unsigned int id, const Property &property)
@@ -266,60 +520,660 @@ void isabelServer::write_object_property(Response &response, unsigned int id, co
 	}
 }
 
-void isabelServer::record_user(Response &response, bool start)
+void isabelServer::record_user(Response &response, const Request &request)
+{
+	if(request.start())
+	{
+		Response discarded;
+
+		/* only one recording at a time, the events of the previous one are discarded */
+		qt_events->end();
+		qt_events->drain(discarded);
+		x11->stop_recording(discarded);
+
+		if(request.qt_events())
+		{
+			/* the file only holds the X11 events, which have no target object */
+			if(request.has_record_file())
+			{
+				response.set_error(Response::INVALID_REQUEST);
+				return;
+			}
+
+			qt_events->begin(objects,request.max_events());
+		}
+		else if(!x11->start_recording(request.max_events(),QString::fromUtf8(request.record_file().c_str()),request.path_tolerance()))
+		{
+			response.set_error(Response::UNKNOWN_ERROR);
+			return;
+		}
+	}
+	else if(qt_events->recording())
+	{
+		qt_events->end();
+		qt_events->drain(response);
+	}
+	else if(!x11->stop_recording(response))
+	{
+		response.set_error(Response::UNKNOWN_ERROR);
+		return;
+	}
+
+	response.set_error(Response::NO_ERROR);
+}
+
+void isabelServer::drain_events(Response &response)
+{
+	if(qt_events->recording())
+	{
+		qt_events->drain(response);
+	}
+	else
+	{
+		x11->drain_recording(response);
+	}
+
+	response.set_error(Response::NO_ERROR);
+}
+
+void isabelServer::simulate_user(Response &response, const Request &request)
 {
-	if(start)
+	if(request.user().has_path())
+	{
+		/* recorded from the Qt events, it goes straight to its target object */
+		response.set_error(qt_events->simulate(request.user()));
+	}
+	else if(x11->simulate_user(request.user()))
 	{
-		x11->start_recording(); 
 		response.set_error(Response::NO_ERROR);
 	}
 	else
 	{
-		std::vector<UserEvent *> events = x11->stop_recording(); 
+		/* the keys pressed by the previous events would stay pressed */
+		x11->release_user();
+		response.set_error(Response::X11_ERROR);
+	}
+}
+
+bool isabelServer::wait_for(Response &response, QTcpSocket *client, const Request &request)
+{
+	std::map<unsigned int,QObject *>::iterator iter = objects.find(request.id());
+
+	if(objects.end() == iter)
+	{
+		response.set_error(Response::UNKNOWN_OBJECT_ID);
+		return true;
+	}
+	else if(!request.has_condition())
+	{
+		response.set_error(Response::INVALID_REQUEST);
+		return true;
+	}
+
+	start_wait(client,new isabelWaitProperty(client,iter->second,request.condition(),request.timeout(),this));
+
+	return false;
+}
+
+bool isabelServer::wait_idle(QTcpSocket *client, const Request &request)
+{
+	start_wait(client,new isabelWaitIdle(client,request.animations(),request.timeout(),this));
+
+	return false;
+}
+
+bool isabelServer::wait_stable(Response &response, QTcpSocket *client, const Request &request)
+{
+	QObject *object;
+	QRect 	 region;
+
+	if(!grab_target(response,request,object,region))
+	{
+		return true;
+	}
+
+	/* stable means equal to the previous grab, so there are at least two */
+	if(2 > request.frames())
+	{
+		response.set_error(Response::INVALID_REQUEST);
+		return true;
+	}
 
-		for(unsigned int e = 0; e < events.size(); e++)
+	isabelWaitStable *wait = new isabelWaitStable(client,object,request.id(),region,request.frames(),request.interval(),request.timeout(),this);
+
+	/* the stable frame is only sent if the client selected its format */
+	if(request.has_format())
+	{
+		wait->set_format(request.format());
+	}
+
+	start_wait(client,wait);
+
+	return false;
+}
+
+bool isabelServer::replay(Response &response, QTcpSocket *client, const Request &request)
+{
+	/* either the steps, or the file recorded on the server */
+	if((0 > request.speed()) || (request.has_record_file() && (0 < request.steps_size())))
+	{
+		response.set_error(Response::INVALID_REQUEST);
+		return true;
+	}
+
+	isabelReplay *replay = new isabelReplay(client,x11,qt_events,request.speed(),request.timeout(),this);
+
+	if(request.has_record_file() && !replay->load(QFile::encodeName(QString::fromUtf8(request.record_file().c_str())).constData()))
+	{
+		delete replay;
+		response.set_error(Response::UNKNOWN_ERROR);
+		return true;
+	}
+
+	for(int s = 0; s < request.steps_size(); s++)
+	{
+		const ReplayStep &step 	 = request.steps(s);
+		QObject 		 *object = NULL;
+
+		if(step.has_id())
 		{
-			UserEvent *ev = response.add_events();
-			ev->CopyFrom(*events[e]); 
+			std::map<unsigned int,QObject *>::iterator iter = objects.find(step.id());
+
+			if(objects.end() == iter)
+			{
+				delete replay;
+				response.set_error(Response::UNKNOWN_OBJECT_ID);
+				return true;
+			}
+
+			object = iter->second;
 		}
 
-		response.set_error(Response::NO_ERROR);
+		/* each step is either an event, or a sync point */
+		if(!step.has_event() && !step.idle() && !(step.has_id() && step.has_condition()))
+		{
+			delete replay;
+			response.set_error(Response::INVALID_REQUEST);
+			return true;
+		}
+
+		replay->add(step,object);
 	}
+
+	start_wait(client,replay);
+
+	return false;
 }
 
-void isabelServer::simulate_user(Response &response, const Request &request)
+bool isabelServer::type_text(Response &response, QTcpSocket *client, const Request &request)
+{
+	std::vector<ReplayStep> steps;
+
+	if((0 > request.speed()) || !gesture_text(request,x11->keyboard(),steps))
+	{
+		response.set_error(Response::INVALID_REQUEST);
+		return true;
+	}
+
+	/* the keys removed from the layout in the meantime fail the replay, at their step */
+	isabelReplay *replay = new isabelReplay(client,x11,qt_events,request.speed(),request.timeout(),this);
+
+	for(size_t s = 0; s < steps.size(); s++)
+	{
+		replay->add(steps[s],NULL);
+	}
+
+	start_wait(client,replay);
+
+	return false;
+}
+
+bool isabelServer::pointer_path(Response &response, QTcpSocket *client, const Request &request)
 {
-	if(x11->simulate_user(request.user()))
+	std::vector<ReplayStep> steps;
+
+	if((0 > request.speed()) || !gesture_path(request,steps))
 	{
-		response.set_error(Response::NO_ERROR);
+		response.set_error(Response::INVALID_REQUEST);
+		return true;
+	}
+
+	isabelReplay *replay = new isabelReplay(client,x11,qt_events,request.speed(),request.timeout(),this);
+
+	for(size_t s = 0; s < steps.size(); s++)
+	{
+		replay->add(steps[s],NULL);
+	}
+
+	start_wait(client,replay);
+
+	return false;
+}
+
+bool isabelServer::capture(Response &response, QTcpSocket *client, const Request &request)
+{
+	T_CONNECTION &state = connections[client];
+
+	if(!request.start())
+	{
+		if(state.capture.isNull())
+		{
+			/* nothing to stop */
+			response.set_error(Response::INVALID_REQUEST);
+			return true;
+		}
+
+		/* the response carries the last frame, and ends the stream */
+		state.capture->stop(response);
+		state.capture->deleteLater();
+		state.capture = NULL;
+
+		return true;
+	}
+
+	if(!state.capture.isNull())
+	{
+		/* only one capture per client */
+		response.set_error(Response::INVALID_REQUEST);
+		return true;
+	}
+
+	QObject *object;
+	QRect 	 region;
+
+	if(!grab_target(response,request,object,region))
+	{
+		return true;
+	}
+
+	Capture settings(request.capture());
+	settings.set_tile_size(qBound(DELTA_MIN_TILE,(int)settings.tile_size(),DELTA_MAX_TILE));
+
+	isabelCapture *capture = new isabelCapture(client,object,request.id(),region,settings,request.format(),this);
+
+	if(!capture->start())
+	{
+		delete capture;
+		response.set_error(Response::UNKNOWN_ERROR);
+		return true;
+	}
+
+	connect(capture,SIGNAL(frame_ready()),this,SLOT(capture_frame()));
+	defer(capture);
+
+	/* stop capturing if the client goes away */
+	connect(client,SIGNAL(disconnected()),capture,SLOT(deleteLater()));
+
+	state.capture = capture;
+
+	/* the frames follow this response */
+	response.set_error(Response::NO_ERROR);
+	response.set_more(capture->streaming());
+
+	return true;
+}
+
+void isabelServer::start_wait(QTcpSocket *client, isabelWait *wait)
+{
+	connect(wait,SIGNAL(finished()),this,SLOT(wait_finished()));
+	defer(wait);
+
+	/* stop waiting if the client goes away */
+	connect(client,SIGNAL(disconnected()),wait,SLOT(deleteLater()));
+
+	wait->start();
+}
+
+bool isabelServer::fetch_model_data(Response &response, QTcpSocket *client, unsigned int id, const ModelRange &range)
+{
+	std::map<unsigned int,QObject *>::iterator iter = objects.find(id);
+
+	if(objects.end() == iter)
+	{
+		response.set_error(Response::UNKNOWN_OBJECT_ID);
+		return true;
+	}
+
+	QAbstractItemModel *model = isabelStreamModel::item_model(iter->second);
+
+	if(NULL == model)
+	{
+		response.set_error(Response::NOT_A_MODEL);
+		return true;
+	}
+
+	start_stream(client,new isabelStreamModel(client,model,range,this));
+
+	return false;
+}
+
+void isabelServer::start_stream(QTcpSocket *client, isabelStream *stream)
+{
+	connect(stream,SIGNAL(chunk_ready()),this,SLOT(stream_chunk()));
+	defer(stream);
+
+	/* stop streaming if the client goes away */
+	connect(client,SIGNAL(disconnected()),stream,SLOT(deleteLater()));
+
+	stream->start();
+}
+
+void isabelServer::defer(QObject *deferred)
+{
+	sequences[deferred] = request_sequence;
+
+	connect(deferred,SIGNAL(destroyed(QObject*)),this,SLOT(forget(QObject*)));
+}
+
+void isabelServer::forget(QObject *deferred)
+{
+	sequences.erase(deferred);
+}
+
+bool isabelServer::take_screenshot(Response &response, QTcpSocket *client, const Request &request)
+{
+	T_SHOT shot;
+
+	if((0 < request.windows_size()) || request.all_screens())
+	{
+		return take_screenshots(response,client,request);
+	}
+
+	/* only the grab is done in the GUI thread, the encoding is done in the thread pool */
+	if(!grab(response,request,shot))
+	{
+		return true;
+	}
+
+	if(request.digest())
+	{
+		/* the hashes are computed in the thread pool, only a few bytes are sent */
+		create_task(client)->start(QtConcurrent::run(image_digest,shot),response);
+		return false;
+	}
+
+	shot.encoding = request.format().encoding();
+	shot.quality  = request.format().quality();
+
+	isabelEncode *encode = create_encode(client);
+	QList<T_SHOT> shots;
+
+	if(request.has_delta())
+	{
+		/* the tiles are compared against the previous delta screenshot sent to this client */
+		T_CONNECTION &state = connections[client];
+
+		QRect frame(shot.position,shot.image.size());
+		int   tile = qBound(DELTA_MIN_TILE,(int)request.delta().tile_size(),DELTA_MAX_TILE);
+
+		if(request.delta().key_frame() || (state.frame != frame) || (state.tile_size != tile))
+		{
+			state.tiles.clear();
+		}
+
+		encode->set_frame(frame,state.tiles.empty());
+
+		shots = image_changed_tiles(shot,tile,state.tiles);
+
+		state.frame 	= frame;
+		state.tile_size = tile;
 	}
 	else
+	{
+		shots.append(shot);
+	}
+
+	/* clients that do not select the format expect the PNG image in the field image */
+	encode->start(shots,!request.has_format() && !request.has_delta(),Response());
+
+	return false;
+}
+
+bool isabelServer::take_screenshots(Response &response, QTcpSocket *client, const Request &request)
+{
+	QList<T_SHOT> shots;
+	T_SHOT 		  shot;
+	QObject 	  *object;
+	QRect 		  region;
+
+	if(!grab_target(response,request,object,region))
+	{
+		return true;
+	}
+
+	/* the delta screenshots, the digests and the objects only apply to a single screenshot */
+	if(request.has_delta() || request.digest() || (NULL != object))
+	{
+		response.set_error(Response::INVALID_REQUEST);
+		return true;
+	}
+
+	shot.encoding = request.format().encoding();
+	shot.quality  = request.format().quality();
+
+	/* the grabs share the X11 connection, so only the encoding runs in parallel */
+	if(request.all_screens())
+	{
+		Q_FOREACH(QScreen *screen, QGuiApplication::screens())
+		{
+			if(!grab_screen(shot,screen))
+			{
+				response.set_error(Response::X11_ERROR);
+				return true;
+			}
+
+			shots.append(shot);
+		}
+	}
+
+	for(int w = 0; w < request.windows_size(); w++)
+	{
+		if(!grab_window(shot,request.windows(w),region))
+		{
+			response.set_error(Response::X11_ERROR);
+			return true;
+		}
+
+		shots.append(shot);
+	}
+
+	create_encode(client)->start(shots,false,Response());
+
+	return false;
+}
+
+isabelEncode *isabelServer::create_encode(QTcpSocket *client)
+{
+	isabelEncode *encode = new isabelEncode(client,this);
+
+	connect(encode,SIGNAL(finished()),this,SLOT(encode_finished()));
+	defer(encode);
+
+	/* the result is discarded if the client goes away */
+	connect(client,SIGNAL(disconnected()),encode,SLOT(deleteLater()));
+
+	return encode;
+}
+
+bool isabelServer::grab_target(Response &response, const Request &request, QObject *&object, QRect &region)
+{
+	object = NULL;
+	region = QRect();
+
+	if(request.has_region())
+	{
+		region = QRect(request.region().x(),request.region().y(),request.region().width(),request.region().height());
+
+		if(region.isEmpty())
+		{
+			response.set_error(Response::INVALID_REQUEST);
+			return false;
+		}
+	}
+
+	if(request.has_object())
+	{
+		std::map<unsigned int,QObject *>::iterator iter = objects.find(request.object());
+
+		if(objects.end() == iter)
+		{
+			response.set_error(Response::UNKNOWN_OBJECT_ID);
+			return false;
+		}
+
+		object = iter->second;
+	}
+
+	return true;
+}
+
+bool isabelServer::grab(Response &response, const Request &request, T_SHOT &shot)
+{
+	QObject *object;
+	QRect 	 region;
+
+	if(!grab_target(response,request,object,region))
+	{
+		return false;
+	}
+
+	if(NULL != object)
+	{
+		if(!grab_object(shot,object,region))
+		{
+			response.set_error(Response::NOT_VISIBLE);
+			return false;
+		}
+	}
+	else if(!grab_window(shot,request.id(),region))
 	{
 		response.set_error(Response::X11_ERROR);
+		return false;
 	}
+
+	return true;
 }
 
-void isabelServer::take_screenshot(Response &response, uint32_t win_id)
+QImage isabelServer::stored_image(Response &response, const Request &request)
 {
-	/* platform indepent way of taking a screenshot of the whole screen */
-	QScreen *screen = QGuiApplication::primaryScreen();
+	QImage image;
 
-    if(screen)
+	if(request.has_image())
 	{
-		/* take a screenshot of the whole screen and convert it to PNG */
-		QPixmap shot = screen->grabWindow(win_id);
-		
-		QByteArray blob;
-		QBuffer buffer(&blob);
-		buffer.open(QIODevice::WriteOnly);
-		shot.save(&buffer,"PNG");
+		image = image_decode(request.image());
 
-		/* send the image back to the client */
-		response.set_image(blob.constData(),blob.size());
-		response.set_error(Response::NO_ERROR);
+		if(image.isNull())
+		{
+			response.set_error(Response::INVALID_REQUEST);
+			return image;
+		}
+
+		/* the key is either given by the client, or the hash of the image */
+		std::string key = request.image_key();
+
+		if(!request.has_image_key())
+		{
+			QByteArray hash = QCryptographicHash::hash(QByteArray::fromRawData(request.image().data().data(),
+															request.image().data().size()),QCryptographicHash::Sha1);
+			key = std::string(hash.constData(),hash.size());
+		}
+
+		/* the clients upload the images again when they are gone */
+		if(IMAGE_STORE_SIZE < image_bytes + image.byteCount())
+		{
+			images.clear();
+			image_bytes = 0;
+		}
+
+		std::map<std::string,QImage>::iterator iter = images.find(key);
+
+		if(images.end() != iter)
+		{
+			image_bytes -= iter->second.byteCount();
+		}
+
+		images[key]  = image;
+		image_bytes += image.byteCount();
+
+		response.set_image_key(key);
 	}
 	else
 	{
-		response.set_error(Response::X11_ERROR);
+		std::map<std::string,QImage>::iterator iter = images.find(request.image_key());
+
+		if(images.end() == iter)
+		{
+			response.set_error(Response::UNKNOWN_IMAGE);
+			return image;
+		}
+
+		image = iter->second;
 	}
+
+	return image;
+}
+
+isabelTask *isabelServer::create_task(QTcpSocket *client)
+{
+	isabelTask *task = new isabelTask(client,this);
+
+	connect(task,SIGNAL(finished()),this,SLOT(task_finished()));
+	defer(task);
+
+	/* the result is discarded if the client goes away */
+	connect(client,SIGNAL(disconnected()),task,SLOT(deleteLater()));
+
+	return task;
+}
+
+bool isabelServer::find_image(Response &response, QTcpSocket *client, const Request &request)
+{
+	T_SHOT shot;
+	QImage needle = stored_image(response,request);
+
+	if(needle.isNull() || !grab(response,request,shot))
+	{
+		return true;
+	}
+
+	/* the search runs in the thread pool, the application is only blocked while grabbing */
+	create_task(client)->start(QtConcurrent::run(image_find,shot,needle,(int)request.count()),response);
+
+	return false;
+}
+
+void isabelServer::store_image(Response &response, const Request &request)
+{
+	if(!request.has_image())
+	{
+		response.set_error(Response::INVALID_REQUEST);
+		return;
+	}
+
+	if(!stored_image(response,request).isNull())
+	{
+		response.set_error(Response::NO_ERROR);
+	}
+}
+
+bool isabelServer::compare_screenshot(Response &response, QTcpSocket *client, const Request &request)
+{
+	T_SHOT shot;
+	QImage baseline = stored_image(response,request);
+
+	if(baseline.isNull() || !grab(response,request,shot))
+	{
+		return true;
+	}
+
+	if(baseline.size() != shot.image.size())
+	{
+		response.set_error(Response::SIZE_MISMATCH);
+		return true;
+	}
+
+	/* the comparison runs in the thread pool, the application is only blocked while grabbing */
+	create_task(client)->start(QtConcurrent::run(image_compare,shot,baseline,request.comparison(),request.format()),response);
+
+	return false;
 }
@@ -34,15 +34,37 @@
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QPointer>
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "protocol.pb.h"
 #include "isabelX11.h"
+#include "isabelEvents.h"
+#include "isabelWait.h"
+#include "isabelReplay.h"
+#include "isabelGesture.h"
+#include "isabelStream.h"
+#include "isabelImage.h"
+#include "isabelCapture.h"
 
 /*--------------------- Public Variable Declarations ----------------*/
 
+typedef struct{
+	bool 			   negotiated; 	// true once the client has selected the compression
+	Compressed::Method compression; // how the responses are compressed
+	unsigned int 	   threshold; 	// responses smaller than this, in bytes, are not compressed
+	quint64 		   raw_bytes; 	// total size of the serialized responses
+	quint64 		   sent_bytes; 	// total size of the responses, after compression
+	std::vector<uint64_t> tiles; 	// hashes of the tiles of the previous delta screenshot
+	QRect 			   frame; 		// geometry of the previous delta screenshot
+	int 			   tile_size; 	// tile size of the previous delta screenshot
+	QByteArray 		   rx; 			// bytes received, but not yet a complete request
+	QPointer<isabelCapture> capture; // the continuous capture started by this client, if any
+} T_CONNECTION;
+
 /*--------------------- Public Class Declarations -------------------*/
 
 class isabelServer : public QObject {
@@ -80,19 +102,89 @@ public slots:
 	*/
 	void disconnected(void);	
 
+	/* Send the response of a wait request, once it has finished.
+	*/
+	void wait_finished(void);
+
+	/* Send the screenshots, once they are encoded.
+	*/
+	void encode_finished(void);
+
+	/* Send the response computed in the thread pool, once it is ready.
+	*/
+	void task_finished(void);
+
+	/* Send the next slice of a streamed response.
+	*/
+	void stream_chunk(void);
+
+	/* Send the next frame of a continuous capture.
+	*/
+	void capture_frame(void);
+
+	/* Forget the sequence of a deferred response, once it is deleted.
+
+		@deferred 	the wait, stream, encoding, computation or capture being deleted
+	*/
+	void forget(QObject *deferred);
+
 private:
-	/* Return the complete list of object in the application.
+	/* Handle a complete request.
+
+		@client 	the client connection
+		@rx_packet 	the request, after being SLIP decoded
+	*/
+	void handle_request(QTcpSocket *client, const QByteArray &rx_packet);
+
+	/* Serialize the response and send it to the client.
+
+		@client 	the client connection
+		@response 	protobuff with the response to send
+		@sequence 	the sequence of the request it responds to, 0 if it had none
+	*/
+	void send_response(QTcpSocket *client, const Response &response, unsigned int sequence);
+
+	/* Serialize the response and queue it, without waiting for it to be sent.
+
+		@client 	the client connection
+		@response 	protobuff with the response to send
+		@sequence 	the sequence of the request it responds to, 0 if it had none
+	*/
+	void queue_response(QTcpSocket *client, const Response &response, unsigned int sequence);
+
+	/* Remember the sequence of the request being handled, to echo it in the deferred response.
+
+		@deferred 	the wait, stream, encoding, computation or capture that sends the response later on
+	*/
+	void defer(QObject *deferred);
+
+	/* Select the compression of the responses sent to the client.
 
 		@response  protobuff where the response is returned
+		@client    the client connection
+		@request   protobuff with the request, listing the methods supported by the client
+
+		#returns false, the response is sent before the compression is enabled
+	*/
+	bool negotiate(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Return the complete list of object in the application.
+
+		@client    the client connection, where the response is streamed
+
+		#returns false, since the response is always sent later on
 	*/
-	void fetch_object_tree(Response &response);
+	bool fetch_object_tree(QTcpSocket *client);
 
 	/* Return all of the given object properties.
 
 		@response  protobuff where the response is returned
+		@client    the client connection, where the response is streamed
 		@id  	   object identifier
+
+		#returns true if the response is ready, false if it is streamed
 	*/
-	void fetch_object(Response &response, unsigned int id);
+	bool fetch_object(Response &response, QTcpSocket *client, unsigned int id);
 
 	/* Modify, or add, an object property.
 
@@ -104,12 +196,23 @@ private:
 	/* Begin, or stop, the recording of the user input events.
 
 		@response  protobuff where the response is returned
-		@start 	   if true, begin recording the user, otherwise end the recording
+		@request   protobuff with the request, the field start begins the recording if
+				   true, and ends it otherwise. If the field qt_events is set, the Qt
+				   events are recorded, relative to their target objects. If the field
+				   record_file is set, the X11 events are written to that file instead.
+				   If the field path_tolerance is set, the X11 mouse paths are simplified.
 		
 		In case the function stops the recording, the response contains
 		the list of events recorded until that instant.
 	*/
-	void record_user(Response &response, bool start);
+	void record_user(Response &response, const Request &request);
+
+	/* Return the user events recorded so far, while the recording goes on.
+
+		@response  protobuff where the events, and the number of those dropped
+				   since the previous drain, are returned
+	*/
+	void drain_events(Response &response);
 
 	/* Simulate the user interaction.
 
@@ -118,25 +221,209 @@ private:
 	*/
 	void simulate_user(Response &response, const Request &request);
 
-	/* Take a shot of the whole screen.
+	/* Take a shot of the whole screen, of a window or of an object.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request, the field id is the X11 window
+				   identifier, use 0 for the whole screen. If the field object
+				   is set, the shot is taken of that object instead.
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool take_screenshot(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Take the screenshots of all screens, or of a list of windows, in a single request.
 
 		@response  protobuff where the response is returned
-		@win_id    the X11 window identifier, use 0 for the whole screen
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request, with the windows and, or, the flag all_screens.
+				   The region, if any, applies to each of the windows.
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool take_screenshots(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Create the encoding of screenshots, whose response is sent once done.
+
+		@client    the client connection, where the deferred response is sent
+
+		#returns the encoding, ready to be started
+	*/
+	isabelEncode *create_encode(QTcpSocket *client);
+
+	/* Create the computation of a response in the thread pool, which is sent once done.
+
+		@client    the client connection, where the deferred response is sent
+
+		#returns the computation, ready to be started
+	*/
+	isabelTask *create_task(QTcpSocket *client);
+
+	/* Find what to grab, as selected by the request.
+
+		@response  protobuff where the error is returned, in case of failure
+		@request   protobuff with the request
+		@object    where the object to grab is returned, NULL to grab the window
+		@region    where the region to grab is returned, a null rectangle for all of it
+
+		#returns true if successfull, false otherwise
+	*/
+	bool grab_target(Response &response, const Request &request, QObject *&object, QRect &region);
+
+	/* Grab the screen, a window or an object, as selected by the request.
+
+		@response  protobuff where the error is returned, in case of failure
+		@request   protobuff with the request
+		@shot 	   where the grabbed image, and its position, are returned
+
+		#returns true if successfull, false otherwise
+	*/
+	bool grab(Response &response, const Request &request, T_SHOT &shot);
+
+	/* Return the image uploaded with the request, or kept from a previous request.
+
+		@response  protobuff where the key of an uploaded image, or the error, is returned
+		@request   protobuff with the request, either with the image or its key
+
+		#returns the image, a null image in case of error
+	*/
+	QImage stored_image(Response &response, const Request &request);
+
+	/* Find an image on the screen, or on a region of it.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool find_image(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Keep an image on the server, under the given key.
+
+		@response  protobuff where the response is returned
+		@request   protobuff with the request, with the image and optionally its key
+	*/
+	void store_image(Response &response, const Request &request);
+
+	/* Compare a screenshot against an image kept on the server.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool compare_screenshot(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Wait until the object property satisfies the condition.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool wait_for(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Wait until the application has processed all of the pending events.
+
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request
+
+		#returns false, since the response is always sent later on
+	*/
+	bool wait_idle(QTcpSocket *client, const Request &request);
+
+	/* Wait until the screen, a window, an object or a region stops changing.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool wait_stable(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Replay a sequence of user events, on the server timeline.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request, the steps to replay, or the file recorded
+				   on the server in the field record_file, and the speed multiplier
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool replay(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Type a text, one key every cadence milliseconds, on the server timeline.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request, the text and the cadence
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool type_text(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Move the mouse through the waypoints, on the server timeline.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the deferred response is sent
+		@request   protobuff with the request, the waypoints, the duration, the time between
+				   moves, the mouse button held along the path and the interpolation
+
+		#returns true if the response is ready, false if it is sent later on
+	*/
+	bool pointer_path(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Begin, or stop, the continuous capture of the screen.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the frames are sent
+		@request   protobuff with the request
+
+		#returns true, the frames are sent after the response
+	*/
+	bool capture(Response &response, QTcpSocket *client, const Request &request);
+
+	/* Start waiting and send the response once done.
+
+		@client    the client connection, where the deferred response is sent
+		@wait      the condition to wait for
+	*/
+	void start_wait(QTcpSocket *client, isabelWait *wait);
+
+	/* Read the contents of an item model, in columnar form.
+
+		@response  protobuff where the response is returned
+		@client    the client connection, where the response is streamed
+		@id  	   identifier of the model, or of a view with a model
+		@range     the rows, columns and roles to read
+
+		#returns true if the response is ready, false if it is streamed
 	*/
-	void take_screenshot(Response &response, uint32_t win_id);
+	bool fetch_model_data(Response &response, QTcpSocket *client, unsigned int id, const ModelRange &range);
 
-	/* Add the object to the list of objects.
+	/* Start streaming the response to the client.
 
-		@parent 	the ID of the parent
-		@obj 		the Qt object to add
-		@response 	the protobuff response, which gets build incrementally
+		@client    the client connection, where the response is streamed
+		@stream    the producer of the response
 	*/
-	void add_object(unsigned int parent, QObject *obj, Response &response);
+	void start_stream(QTcpSocket *client, isabelStream *stream);
 
 private:
 	QTcpServer   *server;						/* the TCP server that listens to client requests */
 	isabelX11    *x11;							/* interface with the X11 server */
+	isabelEvents *qt_events; 					/* records and replays the Qt events */
 	std::map<unsigned int, QObject *> objects; 	/* the current list of Qt objects */
+	QPointer<isabelStream> 			  tree; 	/* the walk of the object tree in progress, if any */
+	std::map<QTcpSocket *, T_CONNECTION> connections; /* the state of each client connection */
+	std::map<std::string, QImage> 		 images; 	  /* the images uploaded by the clients, by key */
+	qint64 								 image_bytes; /* total size of the uploaded images */
+	unsigned int 						 request_sequence; /* the sequence of the request being handled */
+	std::map<QObject *, unsigned int> 	 sequences;   /* the sequence echoed by each deferred response */
 }; 
 
 #endif
@@ -0,0 +1,399 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelStream.h"
+#include "isabelSerialize.h"
+
+#include <QTimer>
+#include <QApplication>
+#include <QWindow>
+
+#include <QtWidgets/QWidget>
+#include <QtWidgets/QAbstractItemView>
+
+#include <QtCore/QMetaObject>
+#include <QtCore/QMetaProperty>
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickView>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+#define STREAM_TIME_SLICE 	(10)		/* maximum time, in milliseconds, spent building a slice */
+#define STREAM_SLICE_ITEMS 	(1000)		/* maximum number of objects, or properties, in a slice */
+#define MODEL_SLICE_VALUES 	(20000)		/* maximum number of model values in a slice */
+#define MODEL_PAGE_SIZE 	(200000)	/* maximum number of model values returned for a single request */
+
+/*--------------------- Public Class Definitions -------------------*/
+
+isabelStream::isabelStream(QTcpSocket *client, QObject *parent)
+: QObject(parent)
+{
+	socket = client;
+	done   = false;
+}
+
+isabelStream::~isabelStream()
+{
+}
+
+void isabelStream::start(void)
+{
+	step();
+}
+
+QTcpSocket *isabelStream::client(void)
+{
+	return socket.data();
+}
+
+const Response &isabelStream::response(void)
+{
+	return chunk;
+}
+
+bool isabelStream::finished(void)
+{
+	return done;
+}
+
+void isabelStream::step(void)
+{
+	chunk.Clear();
+	chunk.set_error(Response::NO_ERROR);
+
+	clock.start();
+
+	if(produce(chunk))
+	{
+		chunk.set_more(true);
+
+		/* let the application handle its events before producing the next slice */
+		QTimer::singleShot(0,this,SLOT(step()));
+	}
+	else
+	{
+		done = true;
+	}
+
+	emit chunk_ready();
+}
+
+bool isabelStream::exhausted(int items, int limit)
+{
+	return (STREAM_TIME_SLICE <= clock.elapsed()) || (limit <= items);
+}
+
+isabelStreamTree::isabelStreamTree(QTcpSocket *client, std::map<unsigned int, QObject *> &objects, QObject *parent)
+: isabelStream(client,parent), objects(objects)
+{
+	QList<QObject*> roots;
+
+	/* clean the list of objects, it is rebuilt while walking the tree */
+	objects.clear();
+
+	Q_FOREACH(QWidget *widget, QApplication::topLevelWidgets())
+	{
+		roots.append(widget);
+	}
+
+	Q_FOREACH(QWindow *window, QApplication::topLevelWindows())
+	{
+		/* QML based windows are not shown as widgets, need to treat them separately:
+			- first we add the window
+			- then we add the root object of the QQuickView
+		 */
+		roots.append(window);
+
+		QQuickView *viewObj = qobject_cast<QQuickView*>(window);
+
+		if((NULL != viewObj) && (NULL != viewObj->rootObject()))
+		{
+			roots.append(viewObj->rootObject());
+		}
+	}
+
+	/* the last object pushed is the first visited */
+	for(int r = roots.size() - 1; r >= 0; r--)
+	{
+		push(0,roots[r]);
+	}
+}
+
+bool isabelStreamTree::produce(Response &chunk)
+{
+	while(!pending.empty())
+	{
+		T_PENDING next = pending.back();
+		pending.pop_back();
+
+		/* the object might have been destroyed between slices */
+		QObject *obj = next.second.data();
+
+		if(NULL == obj)
+		{
+			continue;
+		}
+
+		/* first add the object */
+		unsigned int id = objects.size() + 1;
+		objects.insert(std::pair<unsigned int, QObject *>(id,obj));
+
+		Object *qtObj = chunk.add_objects();
+		qtObj->set_id(id);
+		qtObj->set_parent(next.first);
+		qtObj->set_type(obj->metaObject()->className());
+		qtObj->set_name(obj->objectName().toUtf8().constData());
+
+		/* and then its children, in the same order as they were created */
+		const QObjectList &children = obj->children();
+
+		for(int c = children.size() - 1; c >= 0; c--)
+		{
+			push(id,children[c]);
+		}
+
+		if(exhausted(chunk.objects_size(),STREAM_SLICE_ITEMS))
+		{
+			break;
+		}
+	}
+
+	return !pending.empty();
+}
+
+void isabelStreamTree::push(unsigned int parent, QObject *object)
+{
+	pending.push_back(T_PENDING(parent,QPointer<QObject>(object)));
+}
+
+isabelStreamProperties::isabelStreamProperties(QTcpSocket *client, QObject *object, QObject *parent)
+: isabelStream(client,parent)
+{
+	target = object;
+	index  = 0;
+}
+
+bool isabelStreamProperties::produce(Response &chunk)
+{
+	if(target.isNull())
+	{
+		chunk.set_error(Response::UNKNOWN_OBJECT_ID);
+		return false;
+	}
+
+	const QMetaObject *meta = target->metaObject();
+
+	while(index < meta->propertyCount())
+	{
+		Property* prop = chunk.add_properties();
+		QMetaProperty property = meta->property(index);
+
+		prop->set_name(property.name());
+		prop->set_writable(property.isWritable());
+
+		QByteArray value = serialize_encode(property.read(target.data()));
+		prop->set_value(value.constData(),value.count());
+
+		index++;
+
+		if(exhausted(chunk.properties_size(),STREAM_SLICE_ITEMS))
+		{
+			break;
+		}
+	}
+
+	return index < meta->propertyCount();
+}
+
+isabelStreamModel::isabelStreamModel(QTcpSocket *client, QAbstractItemModel *model, const ModelRange &range, QObject *parent)
+: isabelStream(client,parent)
+{
+	this->model = model;
+	this->names = model->roleNames();
+	this->valid = true;
+
+	/* resolve the roles to read, either by number or by name */
+	for(int r = 0; r < range.roles_size(); r++)
+	{
+		roles.append(range.roles(r));
+	}
+
+	for(int r = 0; r < range.role_names_size(); r++)
+	{
+		int role = names.key(QByteArray(range.role_names(r).c_str()),-1);
+
+		if(0 > role)
+		{
+			valid = false;
+		}
+
+		roles.append(role);
+	}
+
+	if(roles.isEmpty())
+	{
+		roles.append(Qt::DisplayRole);
+	}
+
+	/* clip the range to the model size */
+	int row_count    = model->rowCount();
+	int column_count = model->columnCount();
+	int rows;
+
+	row      = qBound(0,range.row(),row_count);
+	column   = qBound(0,range.column(),column_count);
+	rows 	 = (0 < range.rows()) ? qMin(range.rows(),row_count - row) : (row_count - row);
+	columns  = (0 < range.columns()) ? qMin(range.columns(),column_count - column) : (column_count - column);
+
+	/* and then to the page size, the client asks for the next page if needed */
+	if(0 < columns)
+	{
+		rows = qMin(rows,qMax(1,MODEL_PAGE_SIZE/(columns*roles.size())));
+	}
+
+	last_row = row + rows;
+}
+
+bool isabelStreamModel::produce(Response &chunk)
+{
+	if(!valid)
+	{
+		chunk.set_error(Response::PROPERTY_NOT_FOUND);
+		return false;
+	}
+
+	if(model.isNull())
+	{
+		chunk.set_error(Response::UNKNOWN_OBJECT_ID);
+		return false;
+	}
+
+	/* the model might have shrunk between slices */
+	int row_count = model->rowCount();
+	int first_row = row;
+	int values 	  = 0;
+
+	last_row = qMin(last_row,row_count);
+
+	/* the values are stored column by column, one JSON array for each role */
+	QList<QByteArray> arrays;
+
+	for(int a = 0; a < columns*roles.size(); a++)
+	{
+		arrays.append(QByteArray("["));
+	}
+
+	while(row < last_row)
+	{
+		int a = 0;
+
+		for(int c = column; c < column + columns; c++)
+		{
+			Q_FOREACH(int role, roles)
+			{
+				QByteArray value = serialize_encode(model->data(model->index(row,c),role));
+
+				if(row > first_row)
+				{
+					arrays[a].append(',');
+				}
+
+				/* values that cannot be serialized are sent as null */
+				arrays[a].append(value.isNull() ? QByteArray("null") : value);
+				a++;
+			}
+		}
+
+		row++;
+		values += a;
+
+		if(exhausted(values,MODEL_SLICE_VALUES))
+		{
+			break;
+		}
+	}
+
+	ModelData *data = chunk.mutable_model();
+	data->set_row_count(row_count);
+	data->set_column_count(model->columnCount());
+	data->set_row(first_row);
+	data->set_rows(row - first_row);
+
+	if((row >= last_row) && (last_row < row_count))
+	{
+		data->set_next_row(last_row);
+	}
+
+	int a = 0;
+
+	for(int c = column; c < column + columns; c++)
+	{
+		Q_FOREACH(int role, roles)
+		{
+			arrays[a].append(']');
+
+			ModelColumn *entry = data->add_columns();
+			entry->set_column(c);
+			entry->set_role(role);
+			entry->set_values(arrays[a].constData(),arrays[a].size());
+
+			if(names.contains(role))
+			{
+				entry->set_name(names.value(role).constData());
+			}
+
+			a++;
+		}
+	}
+
+	return row < last_row;
+}
+
+QAbstractItemModel *isabelStreamModel::item_model(QObject *object)
+{
+	QAbstractItemModel *model = qobject_cast<QAbstractItemModel*>(object);
+
+	if(NULL == model)
+	{
+		QAbstractItemView *view = qobject_cast<QAbstractItemView*>(object);
+
+		if(NULL != view)
+		{
+			model = view->model();
+		}
+		else
+		{
+			/* QML views, such as ListView or TableView, expose the model as a property */
+			model = qobject_cast<QAbstractItemModel*>(object->property("model").value<QObject*>());
+		}
+	}
+
+	return model;
+}
+
+/*--------------------- Private Function Definitions ----------------*/
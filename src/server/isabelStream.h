@@ -0,0 +1,225 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   This module implements the requests whose response can be large: the
+   object tree, the object properties and the item model contents. The
+   response is produced in time slices, each one running in a separate
+   iteration of the event loop, and each slice is sent to the client as
+   soon as it is ready. All but the last response have the field `more`
+   set, so the client knows that it must keep reading.
+
+   This keeps the application responsive while the response is being
+   built, and the server only holds one slice in memory at a time.
+ */
+#ifndef __ISABEL_STREAM_H__
+#define __ISABEL_STREAM_H__
+
+#include <QObject>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QTcpSocket>
+#include <QAbstractItemModel>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+
+#include <map>
+#include <vector>
+
+#include "protocol.pb.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelStream : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@parent 	the parent QObject
+	*/
+	isabelStream(QTcpSocket *client, QObject *parent);
+
+	/* Class destructor.
+	*/
+	virtual ~isabelStream();
+
+	/* Begin producing the response.
+
+		The first slice is produced right away, so the signal chunk_ready()
+		is emitted before this function returns.
+	*/
+	void start(void);
+
+	/* Return the client connection, NULL if it was already closed.
+	*/
+	QTcpSocket *client(void);
+
+	/* Return the last slice of the response, valid after chunk_ready().
+	*/
+	const Response &response(void);
+
+	/* Return true once the last slice of the response was produced.
+	*/
+	bool finished(void);
+
+Q_SIGNALS:
+	void chunk_ready(void);		/* emitted when a slice of the response is ready to be sent */
+
+public slots:
+	/* Produce the next slice of the response.
+	 */
+	void step(void);
+
+protected:
+	/* Add the next items to the slice of the response.
+
+		@chunk 	the slice of the response to fill
+
+		#returns true if there are more items to produce, false otherwise
+
+		The implementation must call exhausted() after each item and
+		return as soon as it returns true.
+	*/
+	virtual bool produce(Response &chunk) = 0;
+
+	/* Verify if the current slice is complete.
+
+		@items 	number of items already in the slice
+		@limit 	maximum number of items in a slice
+
+		#returns true if the slice took too long, or has too many items
+	*/
+	bool exhausted(int items, int limit);
+
+private:
+	QPointer<QTcpSocket> socket;	/* the client connection */
+	QElapsedTimer 		 clock; 	/* measures the time spent in the current slice */
+	Response 			 chunk; 	/* the current slice of the response */
+	bool 				 done; 		/* true once the last slice was produced */
+};
+
+class isabelStreamTree : public isabelStream {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@objects 	the list of objects, it is rebuilt while walking the tree
+		@parent 	the parent QObject
+	*/
+	isabelStreamTree(QTcpSocket *client, std::map<unsigned int, QObject *> &objects, QObject *parent);
+
+protected:
+	/* Add the next objects of the tree to the slice.
+	*/
+	bool produce(Response &chunk);
+
+private:
+	/* Push the object onto the list of objects to visit.
+
+		@parent 	the ID of the parent
+		@object 	the Qt object to visit
+	*/
+	void push(unsigned int parent, QObject *object);
+
+private:
+	typedef std::pair<unsigned int, QPointer<QObject> > T_PENDING;
+
+	std::map<unsigned int, QObject *> &objects; 	/* the list of objects, shared with the server */
+	std::vector<T_PENDING> 			  pending; 		/* objects still to visit, the top is visited first */
+};
+
+class isabelStreamProperties : public isabelStream {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@object 	the object whose properties are read
+		@parent 	the parent QObject
+	*/
+	isabelStreamProperties(QTcpSocket *client, QObject *object, QObject *parent);
+
+protected:
+	/* Add the next properties to the slice.
+	*/
+	bool produce(Response &chunk);
+
+private:
+	QPointer<QObject> target; 	/* the object whose properties are read */
+	int 			  index; 	/* the next property to read */
+};
+
+class isabelStreamModel : public isabelStream {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@model 		the item model to read
+		@range 		the range of the model to read
+		@parent 	the parent QObject
+	*/
+	isabelStreamModel(QTcpSocket *client, QAbstractItemModel *model, const ModelRange &range, QObject *parent);
+
+	/* Return the item model of the given object.
+
+		@object  either an item model, a widget view or a QML view with a model property
+
+		#returns the item model, NULL if the object does not have one
+	*/
+	static QAbstractItemModel *item_model(QObject *object);
+
+protected:
+	/* Add the next rows of the model to the slice.
+	*/
+	bool produce(Response &chunk);
+
+private:
+	QPointer<QAbstractItemModel> model; 	/* the model being read */
+	QHash<int,QByteArray> 		 names; 	/* the model role names */
+	QList<int> 					 roles; 	/* the roles to read */
+	bool 						 valid; 	/* false if one of the requested roles does not exist */
+	int 						 row; 		/* the next row to read */
+	int 						 last_row; 	/* one past the last row to read */
+	int 						 column; 	/* first column to read */
+	int 						 columns; 	/* number of columns to read */
+};
+
+#endif
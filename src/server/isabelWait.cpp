@@ -0,0 +1,502 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+
+ */
+#include "isabelWait.h"
+#include "isabelSerialize.h"
+#include "isabelImage.h"
+
+#include <QAbstractEventDispatcher>
+#include <QAbstractAnimation>
+#include <QApplication>
+#include <QByteArray>
+#include <QEvent>
+#include <QString>
+#include <QWindow>
+
+#include <QtWidgets/QWidget>
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickView>
+#include <QtQuick/QQuickWindow>
+
+#include <QtCore/QMetaObject>
+#include <QtCore/QMetaMethod>
+#include <QtCore/QMetaProperty>
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+#define IDLE_QUIET_TIME 	(50)	/* time, in milliseconds, without frames for the application to be idle */
+#define IDLE_CONFIRM_TIME 	(10)	/* time, in milliseconds, for the render loop to pick up a pending update */
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Search the object, and its children, for running animations.
+
+	@object 	the object to search
+
+	#returns true if there is an animation running, false otherwise
+*/
+static bool animation_running(QObject *object);
+
+/*--------------------- Public Class Definitions -------------------*/
+
+isabelWait::isabelWait(QTcpSocket *client, unsigned int timeout, QObject *parent)
+: QObject(parent)
+{
+	socket = client;
+	done   = false;
+	timer  = new QTimer(this);
+
+	timer->setSingleShot(true);
+	timer->setInterval(timeout);
+
+	connect(timer,SIGNAL(timeout()),this,SLOT(expired()));
+
+	clock.start();
+}
+
+isabelWait::~isabelWait()
+{
+	delete timer;
+}
+
+void isabelWait::start(void)
+{
+	/* a timeout of zero means waiting until the client disconnects */
+	if(0 < timer->interval())
+	{
+		timer->start();
+	}
+
+	/* the condition might be already met */
+	evaluate();
+}
+
+QTcpSocket *isabelWait::client(void)
+{
+	return socket.data();
+}
+
+const Response &isabelWait::response(void)
+{
+	return result;
+}
+
+void isabelWait::evaluate(void)
+{
+	if(!done && condition())
+	{
+		finish(Response::NO_ERROR);
+	}
+}
+
+void isabelWait::expired(void)
+{
+	if(!done)
+	{
+		finish(Response::TIMEOUT);
+	}
+}
+
+void isabelWait::watch_idle(void)
+{
+	/* the dispatcher is about to block when there are no more events to process */
+	connect(QAbstractEventDispatcher::instance(),SIGNAL(aboutToBlock()),this,SLOT(evaluate()),Qt::UniqueConnection);
+}
+
+void isabelWait::finish(Response::Error error)
+{
+	done = true;
+	timer->stop();
+
+	result.set_error(error);
+	result.set_elapsed(clock.elapsed());
+
+	emit finished();
+}
+
+isabelWaitProperty::isabelWaitProperty(QTcpSocket *client, QObject *object, const Condition &condition, unsigned int timeout, QObject *parent)
+: isabelWait(client,timeout,parent)
+{
+	target = object;
+	predicate.CopyFrom(condition);
+
+	QByteArray buffer(condition.value().c_str(),condition.value().size());
+	expected = serialize_decode(buffer);
+}
+
+void isabelWaitProperty::start(void)
+{
+	const QMetaObject *meta = target->metaObject();
+	int index = meta->indexOfProperty(predicate.name().c_str());
+
+	if((0 > index) && !target->dynamicPropertyNames().contains(predicate.name().c_str()))
+	{
+		/* nothing to wait for */
+		finish(Response::PROPERTY_NOT_FOUND);
+		return;
+	}
+
+	if((0 <= index) && meta->property(index).hasNotifySignal())
+	{
+		/* evaluate the condition every time the property changes */
+		QMetaMethod signal = meta->property(index).notifySignal();
+		QMetaMethod slot   = metaObject()->method(metaObject()->indexOfSlot("evaluate()"));
+
+		connect(target.data(),signal,this,slot);
+	}
+	else
+	{
+		/* properties without notify signal are evaluated when there is nothing else to do */
+		watch_idle();
+	}
+
+	isabelWait::start();
+}
+
+bool isabelWaitProperty::condition(void)
+{
+	bool met = false;
+
+	if(target.isNull())
+	{
+		/* the object was destroyed while waiting */
+		finish(Response::UNKNOWN_OBJECT_ID);
+		return false;
+	}
+
+	QVariant value = target->property(predicate.name().c_str());
+
+	switch(predicate.op())
+	{
+		case Condition::EQUAL:
+			met = (value == expected);
+			break;
+
+		case Condition::NOT_EQUAL:
+			met = (value != expected);
+			break;
+
+		case Condition::LESS_THAN:
+			met = (value.toDouble() < expected.toDouble());
+			break;
+
+		case Condition::GREATER_THAN:
+			met = (value.toDouble() > expected.toDouble());
+			break;
+
+		case Condition::CONTAINS:
+			met = value.toString().contains(expected.toString());
+			break;
+
+		default:
+			break;
+	}
+
+	return met;
+}
+
+isabelWaitIdle::isabelWaitIdle(QTcpSocket *client, bool animations, unsigned int timeout, QObject *parent)
+: isabelWait(client,timeout,parent)
+{
+	this->animations = animations;
+	this->frames 	 = 0;
+	this->settle 	 = new QTimer(this);
+
+	settle->setSingleShot(true);
+	connect(settle,SIGNAL(timeout()),this,SLOT(settled()));
+
+	activity.start();
+}
+
+void isabelWaitIdle::start(void)
+{
+	/* the QtQuick scene graph might render in its own thread, so follow the frames */
+	Q_FOREACH(QWindow *window, QApplication::topLevelWindows())
+	{
+		QQuickWindow *quick = qobject_cast<QQuickWindow*>(window);
+
+		if(NULL != quick)
+		{
+			connect(quick,SIGNAL(afterAnimating()),this,SLOT(frame_requested()));
+			connect(quick,SIGNAL(beforeRendering()),this,SLOT(frame_started()),Qt::QueuedConnection);
+			connect(quick,SIGNAL(frameSwapped()),this,SLOT(frame_swapped()),Qt::QueuedConnection);
+
+			quick->installEventFilter(this);
+		}
+	}
+
+	/* posted events, including the UpdateRequest ones, are all delivered before the loop blocks,
+	   so the condition is only evaluated from there, never from a timer or a signal */
+	watch_idle();
+
+	isabelWait::start();
+}
+
+void isabelWaitIdle::frame_started(void)
+{
+	frames++;
+	activity.restart();
+	confirm.invalidate();
+}
+
+void isabelWaitIdle::frame_swapped(void)
+{
+	if(0 < frames)
+	{
+		frames--;
+	}
+
+	activity.restart();
+	confirm.invalidate();
+}
+
+void isabelWaitIdle::frame_requested(void)
+{
+	activity.restart();
+	confirm.invalidate();
+}
+
+void isabelWaitIdle::settled(void)
+{
+	/* the timer woke the event loop, which evaluates the condition before blocking again */
+	watch_idle();
+}
+
+bool isabelWaitIdle::eventFilter(QObject *object, QEvent *event)
+{
+	/* the window is about to start a frame */
+	if(QEvent::UpdateRequest == event->type())
+	{
+		activity.restart();
+		confirm.invalidate();
+	}
+
+	return QObject::eventFilter(object,event);
+}
+
+bool isabelWaitIdle::condition(void)
+{
+	/* a frame is still being rendered */
+	if(0 < frames)
+	{
+		confirm.invalidate();
+		return false;
+	}
+
+	/* a frame was rendered recently, check again once the quiet period is over */
+	if(IDLE_QUIET_TIME > activity.elapsed())
+	{
+		/* the application must look idle for the whole confirmation, after the quiet period */
+		confirm.invalidate();
+
+		if(!settle->isActive())
+		{
+			settle->start(IDLE_QUIET_TIME - activity.elapsed());
+		}
+
+		return false;
+	}
+
+	if(animations)
+	{
+		/* same roots as used for the object tree */
+		QList<QObject*> roots;
+
+		Q_FOREACH(QWidget *widget, QApplication::topLevelWidgets())
+		{
+			roots.append(widget);
+		}
+
+		Q_FOREACH(QWindow *window, QApplication::topLevelWindows())
+		{
+			QQuickView *view = qobject_cast<QQuickView*>(window);
+
+			roots.append(window);
+
+			if((NULL != view) && (NULL != view->rootObject()))
+			{
+				roots.append(view->rootObject());
+			}
+		}
+
+		roots.append(QCoreApplication::instance());
+
+		Q_FOREACH(QObject *object, roots)
+		{
+			if(animation_running(object))
+			{
+				confirm.invalidate();
+				return false;
+			}
+		}
+	}
+
+	/* an update requested by now is only picked up by the render loop a few milliseconds later,
+	   the window is busy until it had the chance to start the frame */
+	if(!confirm.isValid())
+	{
+		confirm.start();
+	}
+
+	if(IDLE_CONFIRM_TIME > confirm.elapsed())
+	{
+		if(!settle->isActive())
+		{
+			settle->start(IDLE_CONFIRM_TIME - confirm.elapsed());
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+isabelWaitStable::isabelWaitStable(QTcpSocket *client, QObject *object, WId win_id, const QRect &region,
+								   unsigned int frames, unsigned int interval, unsigned int timeout, QObject *parent)
+: isabelWait(client,timeout,parent)
+{
+	this->target = object;
+	this->object = (NULL != object);
+	this->window = win_id;
+	this->region = region;
+	this->frames = frames;
+	this->equal  = 0;
+	this->hash 	 = 0;
+	this->send 	 = false;
+	this->ticker = new QTimer(this);
+
+	shot.encoding = Image::PNG;
+	shot.quality  = -1;
+
+	ticker->setInterval(interval);
+	connect(ticker,SIGNAL(timeout()),this,SLOT(evaluate()));
+}
+
+void isabelWaitStable::set_format(const ImageFormat &format)
+{
+	send 		  = true;
+	shot.encoding = format.encoding();
+	shot.quality  = format.quality();
+}
+
+bool isabelWaitStable::send_frame(void)
+{
+	return send;
+}
+
+const T_SHOT &isabelWaitStable::frame(void)
+{
+	return shot;
+}
+
+void isabelWaitStable::start(void)
+{
+	ticker->start();
+
+	isabelWait::start();
+}
+
+bool isabelWaitStable::condition(void)
+{
+	bool grabbed;
+
+	if(object)
+	{
+		if(target.isNull())
+		{
+			/* the object was destroyed while waiting */
+			ticker->stop();
+			finish(Response::UNKNOWN_OBJECT_ID);
+			return false;
+		}
+
+		grabbed = grab_object(shot,target.data(),region);
+	}
+	else
+	{
+		grabbed = grab_window(shot,window,region);
+	}
+
+	if(!grabbed)
+	{
+		ticker->stop();
+		finish(object ? Response::NOT_VISIBLE : Response::X11_ERROR);
+		return false;
+	}
+
+	/* the hash of the whole grab is much cheaper than encoding it */
+	uint64_t current = image_hash(shot);
+
+	if((0 < equal) && (current == hash) && (shot.image.size() == size))
+	{
+		equal++;
+	}
+	else
+	{
+		equal = 1;
+	}
+
+	hash = current;
+	size = shot.image.size();
+
+	if(equal >= frames)
+	{
+		ticker->stop();
+		return true;
+	}
+
+	return false;
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static bool animation_running(QObject *object)
+{
+	QAbstractAnimation *animation = qobject_cast<QAbstractAnimation*>(object);
+
+	if((NULL != animation) && (QAbstractAnimation::Running == animation->state()))
+	{
+		return true;
+	}
+
+	/* the QML animations are not QAbstractAnimation, but they do have the running property */
+	if(object->inherits("QQuickAbstractAnimation") && object->property("running").toBool())
+	{
+		return true;
+	}
+
+	Q_FOREACH(QObject *child, object->children())
+	{
+		if(animation_running(child))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
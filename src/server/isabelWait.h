@@ -0,0 +1,279 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   This module implements the requests which only reply once a given
+   condition is met on the application under test. Instead of the client
+   polling the server, the condition is evaluated here whenever it might
+   have changed:
+   	- when the property notify signal is emitted
+   	- when the event loop becomes idle, for properties without one
+
+   It also implements the barrier that waits until the application has
+   finished handling all of its events, frames and, optionally, animations,
+   and the one that waits until the pixels on the screen stop changing.
+ */
+#ifndef __ISABEL_WAIT_H__
+#define __ISABEL_WAIT_H__
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QTcpSocket>
+#include <QVariant>
+#include <QRect>
+#include <QSize>
+
+#include "protocol.pb.h"
+#include "isabelImage.h"
+
+/*--------------------- Public Variable Declarations ----------------*/
+
+/*--------------------- Public Class Declarations -------------------*/
+
+class isabelWait : public QObject {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@timeout 	how long to wait, in milliseconds, 0 waits forever
+		@parent 	the parent QObject
+	*/
+	isabelWait(QTcpSocket *client, unsigned int timeout, QObject *parent);
+
+	/* Class destructor.
+	*/
+	virtual ~isabelWait();
+
+	/* Begin waiting for the condition.
+
+		The condition is evaluated right away, so the signal finished()
+		might be emitted before this function returns.
+	*/
+	virtual void start(void);
+
+	/* Return the client connection, NULL if it was already closed.
+	*/
+	QTcpSocket *client(void);
+
+	/* Return the response to send to the client, valid after finished().
+	*/
+	const Response &response(void);
+
+Q_SIGNALS:
+	void finished(void);	/* emitted once the condition is met, or the timeout expired */
+
+public slots:
+	/* Evaluate the condition and finish the waiting if it was met.
+	 */
+	void evaluate(void);
+
+	/* The timeout expired before the condition was met.
+	 */
+	void expired(void);
+
+protected:
+	/* Evaluate the condition.
+
+		#returns true if the condition is met, false otherwise
+	*/
+	virtual bool condition(void) = 0;
+
+	/* Evaluate the condition whenever the event loop becomes idle.
+	*/
+	void watch_idle(void);
+
+	/* Stop waiting and report the result.
+
+		@error 	the error code to send to the client
+	*/
+	void finish(Response::Error error);
+
+protected:
+	Response 			 result;	/* the response to send to the client */
+
+private:
+	QPointer<QTcpSocket> socket;	/* the client connection */
+	QTimer 				 *timer;	/* expires when the condition is not met in time */
+	QElapsedTimer		 clock;		/* measures how long the waiting took */
+	bool 				 done; 		/* true once the response is ready */
+};
+
+class isabelWaitProperty : public isabelWait {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@object 	the object whose property is evaluated
+		@condition 	the condition to evaluate on the object property
+		@timeout 	how long to wait, in milliseconds, 0 waits forever
+		@parent 	the parent QObject
+	*/
+	isabelWaitProperty(QTcpSocket *client, QObject *object, const Condition &condition, unsigned int timeout, QObject *parent);
+
+	/* Begin waiting for the property to satisfy the condition.
+	*/
+	void start(void);
+
+protected:
+	/* Compare the current property value with the expected one.
+
+		#returns true if the condition is met, false otherwise
+	*/
+	bool condition(void);
+
+private:
+	QPointer<QObject> target;		/* the object whose property is evaluated */
+	Condition 		  predicate; 	/* the condition to evaluate */
+	QVariant 		  expected; 	/* the decoded value to compare against */
+};
+
+class isabelWaitIdle : public isabelWait {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@animations if true, also wait for the running animations to stop
+		@timeout 	how long to wait, in milliseconds, 0 waits forever
+		@parent 	the parent QObject
+	*/
+	isabelWaitIdle(QTcpSocket *client, bool animations, unsigned int timeout, QObject *parent);
+
+	/* Begin waiting for the application to become idle.
+	*/
+	void start(void);
+
+public slots:
+	/* A QtQuick window began rendering a frame.
+	 */
+	void frame_started(void);
+
+	/* A QtQuick window finished rendering a frame.
+	 */
+	void frame_swapped(void);
+
+	/* A QtQuick window began animating and synchronizing a frame, before rendering it.
+	 */
+	void frame_requested(void);
+
+	/* The quiet period is over, evaluate the condition once the event loop becomes idle.
+	 */
+	void settled(void);
+
+protected:
+	/* Verify that there are no events, frames or animations pending.
+
+		#returns true if the application is idle, false otherwise
+	*/
+	bool condition(void);
+
+	/* Follow the update requests of the QtQuick windows.
+
+		@object 	the window receiving the event
+		@event 		the event
+
+		#returns false, the event is always delivered
+	*/
+	bool eventFilter(QObject *object, QEvent *event);
+
+private:
+	QTimer 		  *settle; 		/* wakes the event loop once the quiet period is over */
+	QElapsedTimer activity; 	/* time since the last rendered frame */
+	QElapsedTimer confirm; 		/* time since the application looked idle, invalid if it did not */
+	int 		  frames; 		/* number of frames being rendered */
+	bool 		  animations; 	/* if true, wait for the animations to stop */
+};
+
+class isabelWaitStable : public isabelWait {
+
+	Q_OBJECT
+
+public:
+
+	/* Class initialization.
+
+		@client 	the connection to where the response is sent
+		@object 	the object to grab, NULL to grab the window
+		@win_id 	the X11 window identifier, use 0 for the whole screen
+		@region 	the region to grab, use a null rectangle to grab all of it
+		@frames 	number of consecutive identical grabs for the screen to be stable, at least 2
+		@interval 	time between grabs, in milliseconds
+		@timeout 	how long to wait, in milliseconds, 0 waits forever
+		@parent 	the parent QObject
+	*/
+	isabelWaitStable(QTcpSocket *client, QObject *object, WId win_id, const QRect &region,
+					 unsigned int frames, unsigned int interval, unsigned int timeout, QObject *parent);
+
+	/* Send the stable frame along with the response.
+
+		@format 	how to encode the frame
+	*/
+	void set_format(const ImageFormat &format);
+
+	/* Return true if the stable frame is to be sent to the client.
+	*/
+	bool send_frame(void);
+
+	/* Return the last grabbed frame, the stable one after finished().
+	*/
+	const T_SHOT &frame(void);
+
+	/* Begin grabbing the screen periodically.
+	*/
+	void start(void);
+
+protected:
+	/* Grab the screen and compare it with the previous grab.
+
+		#returns true if the last grabs were all identical, false otherwise
+	*/
+	bool condition(void);
+
+private:
+	QPointer<QObject> target; 		/* the object to grab */
+	bool 			  object; 		/* if true, grab the object instead of the window */
+	WId 			  window; 		/* the window to grab */
+	QRect 			  region; 		/* the region to grab */
+	QTimer 			  *ticker; 		/* grabs the screen periodically */
+	T_SHOT 			  shot; 		/* the last grab */
+	uint64_t 		  hash; 		/* hash of the last grab */
+	QSize 			  size; 		/* size of the last grab */
+	unsigned int 	  equal; 		/* number of consecutive identical grabs */
+	unsigned int 	  frames; 		/* number of identical grabs for the screen to be stable */
+	bool 			  send; 		/* if true, the stable frame is sent to the client */
+};
+
+#endif
@@ -25,6 +25,8 @@
 
  */
 #include "isabelX11.h"
+#include "isabelRecord.h"
+#include "isabelPath.h"
 
 #include <cairo/cairo.h>
 #include <cairo/cairo-xlib.h>
@@ -32,11 +34,18 @@
 #include <unistd.h>
 #include <cstring>
 
+#include <QFile>
+#include <QMutexLocker>
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
 extern "C"
 {
 	#include <X11/Xlib.h>
-	#include <X11/XKBlib.h>
+	#include <X11/Xutil.h>
 	#include <X11/extensions/XTest.h>
+	#include <X11/extensions/XShm.h>
 }
 
 #include <cassert>
@@ -44,87 +53,268 @@ extern "C"
 /*--------------------- Private Data Declarations ----------------*/
 
 #define USER_SAMPLE_TIME (10)	/* sampling at 100 Hz */
+#define JOURNAL_FLUSH_TIME (100)	/* the recorded events are written to the file 10 times per second */
+
+static bool x11_failed = false; 	/* set when the X11 server reports an error */
 
 /*--------------------- Private Function Declarations ----------------*/
 
+/* Record the X11 errors, instead of exiting the application as done by default.
+
+	@display 	the X11 client
+	@error 		the error reported by the X11 server
+
+	#returns ignored
+*/
+static int x11_error(Display *display, XErrorEvent *error);
+
 /*--------------------- Public Class Declarations -------------------*/
 
 isabelX11::isabelX11(QObject *parent)
 : QObject(parent)
 {
-	timer = new QTimer(this); 
+	timer 	 = new QTimer(this); 
+	flusher  = new QTimer(this);
+	recorder = new isabelRecord(this);
 
 	connect(timer,SIGNAL(timeout()),this,SLOT(record_user())); 
+	connect(flusher,SIGNAL(timeout()),this,SLOT(write_journal())); 
 
 	display    = (void *)XOpenDisplay(NULL);
 	last_state = new T_X11_STATE();
+	shm_image  = NULL;
+	shm_info   = NULL;
+
+	ring_init(ring,1);
+
+	journaling 		= false;
+	journal_dropped = 0;
+	path_tolerance 	= 0;
+	held 			= 0;
+
+	memset(pressed,0,sizeof(pressed));
 
 	assert(display != NULL);
 	assert(last_state != NULL);
+
+	keymap.read(display);
+
+	/* remote displays do not share memory with the application */
+	shm_available = XShmQueryExtension((Display *)display);
 }
 
 isabelX11::~isabelX11()
 {
+	/* the recorder thread fills the ring, which is about to be destroyed */
+	recorder->end();
+
 	delete timer; 
-	events.clear();
+	shm_destroy();
 	XCloseDisplay((Display *)display);
 	delete last_state;
 }
 
-void isabelX11::start_recording(void)
+bool isabelX11::start_recording(unsigned int max_events, const QString &file, double tolerance)
 {
-	/* stop the timer and clear the previous recorded events */
-	if(timer->isActive())
+	/* stop the previous recording and discard its events */
+	Response discarded;
+	stop_recording(discarded);
+
+	refresh_keymap();
+
+	ring_init(ring,max_events);
+	sampled 	   = 0; 
+	path_tolerance = tolerance;
+	path_open.clear();
+	path_idle.start();
+
+	if(!file.isEmpty())
 	{
-		timer->stop();		
-	}
+		if(!journal.open(QFile::encodeName(file).constData()))
+		{
+			return false;
+		}
 
-	/* clear the queue and the event instant counter */
-	events.clear(); 
-	instant = 0; 
+		journaling 		= true;
+		journal_dropped = 0;
+		flusher->start(JOURNAL_FLUSH_TIME);
+	}
 
 	/* get the current state */
 	get_x11_state(last_state);
 
 	/* and begin the recording with the mouse absolute position */
-	UserEvent *event = new UserEvent(); 
-	event->set_type(UserEvent::MOUSE_MOVE_ABS);
-	event->set_instant(instant); 
-	event->set_xpos(last_state->xpos); 
-	event->set_ypos(last_state->ypos); 
-	events.push_back(event);
+	T_USER_EVENT event = T_USER_EVENT();
+	event.type = UserEvent::MOUSE_MOVE_ABS;
+	event.xpos = last_state->xpos;
+	event.ypos = last_state->ypos;
+
+	ring_push(ring,event);
 
 	/* reset the keyboard state */
 	memset(last_state->keys,0x00,X11_KEYS_SIZE); 
 
-	/* start the timer */
-	timer->start(USER_SAMPLE_TIME);
+	/* the X11 server sends the events as they happen, poll it only if it cannot */
+	if(!recorder->begin(last_state->xpos,last_state->ypos,&ring,&lock,&keymap))
+	{
+		clock.start();
+		timer->start(USER_SAMPLE_TIME);
+	}
+
+	return true;
+}
+
+void isabelX11::drain_recording(Response &response)
+{
+	drain_events(response,false);
 }
 
-std::vector<UserEvent *> &isabelX11::stop_recording(void)
+void isabelX11::drain_events(Response &response, bool close)
 {
+	std::vector<T_USER_EVENT> events;
+	unsigned int 			  dropped;
+
+	if(journaling)
+	{
+		/* the events are in the file, not for the client */
+		journal_events(close);
+
+		response.set_recorded(journal.events());
+		response.set_dropped(journal_dropped);
+		return;
+	}
+
+	lock.lock();
+	ring_drain(ring,events,dropped);
+	lock.unlock();
+
+	simplify_paths(events,close);
+
+	for(unsigned int e = 0; e < events.size(); e++)
+	{
+		const T_USER_EVENT &event = events[e];
+		UserEvent 		   *ev 	  = response.add_events();
+
+		ev->set_type((UserEvent::Type)event.type);
+		ev->set_instant(event.instant/1000);
+		ev->set_instant_us(event.instant);
+
+		if(0 != event.jitter)
+		{
+			ev->set_jitter(event.jitter);
+		}
+
+		if(UserEvent::KEYBOARD == event.type)
+		{
+			const char *name = keymap.name(event.code);
+
+			ev->set_press(event.press);
+			ev->set_key((NULL != name) ? name : "");
+		}
+		else if(UserEvent::MOUSE_BUTTON == event.type)
+		{
+			ev->set_press(event.press);
+			ev->set_button(event.code);
+		}
+		else
+		{
+			ev->set_xpos(event.xpos);
+			ev->set_ypos(event.ypos);
+		}
+	}
+
+	response.set_dropped(dropped);
+}
+
+bool isabelX11::stop_recording(Response &response)
+{
+	bool written = true;
+
 	timer->stop(); 
+	recorder->end();
+
+	drain_events(response,true);
+
+	if(journaling)
+	{
+		flusher->stop();
+		written    = journal.close();
+		journaling = false;
+	}
+
+	return written;
+}
 
-	return events;
+void isabelX11::write_journal(void)
+{
+	journal_events(false);
+}
+
+void isabelX11::journal_events(bool close)
+{
+	std::vector<T_USER_EVENT> events;
+	unsigned int 			  dropped;
+
+	lock.lock();
+	ring_drain(ring,events,dropped);
+	lock.unlock();
+
+	simplify_paths(events,close);
+
+	journal_dropped += dropped;
+
+	for(unsigned int e = 0; e < events.size(); e++)
+	{
+		const char *name = (UserEvent::KEYBOARD == events[e].type) ? keymap.name(events[e].code) : NULL;
+
+		journal.write(events[e],name);
+	}
+
+	journal.flush();
+}
+
+void isabelX11::simplify_paths(std::vector<T_USER_EVENT> &events, bool close)
+{
+	if(0 >= path_tolerance)
+	{
+		return;
+	}
+
+	/* a mouse still since the last drain ended its path, nothing else will */
+	if(!events.empty())
+	{
+		path_idle.restart();
+	}
+	else if(path_idle.hasExpired(PATH_PAUSE_TIME))
+	{
+		close = true;
+	}
+
+	path_simplify_chunk(events,path_open,path_tolerance,close);
 }
 
 void isabelX11::record_user(void)
 {
-	T_X11_STATE state;
+	T_X11_STATE  state;
+	T_USER_EVENT event = T_USER_EVENT();
 
 	get_x11_state(&state);
+	refresh_keymap();
+
+	/* the timer slips when the application is busy, so the sample is stamped when it is taken */
+	event.instant = clock.nsecsElapsed()/1000;
+	event.jitter  = (int32_t)(event.instant - sampled) - 1000*USER_SAMPLE_TIME;
+	sampled 	  = event.instant;
 
 	/* did the mouse moved from its last position ? */
 	if((state.xpos != last_state->xpos) || (state.ypos != last_state->ypos))
 	{
 		/* add a mouse relative movement event */
-		UserEvent *event = new UserEvent(); 
-		event->set_type(UserEvent::MOUSE_MOVE_REL);
-		event->set_instant(instant); 
-		event->set_xpos(state.xpos - last_state->xpos); 
-		event->set_ypos(state.ypos - last_state->ypos); 
+		event.type = UserEvent::MOUSE_MOVE_REL;
+		event.xpos = state.xpos - last_state->xpos;
+		event.ypos = state.ypos - last_state->ypos;
 
-		events.push_back(event);
+		ring_push(ring,event);
 
 		/* save the current mouse position */
 		last_state->xpos = state.xpos; 
@@ -139,16 +329,12 @@ void isabelX11::record_user(void)
 		{
 			if(changed & (1 << i))
 			{
-				bool pressed = last_state->buttons & (1 << i) ? false : true; 
-
 				/* add a mouse button event */
-				UserEvent *event = new UserEvent(); 
-				event->set_type(UserEvent::MOUSE_BUTTON);
-				event->set_instant(instant);
-				event->set_press(pressed); 
-				event->set_button(i + 1);
+				event.type  = UserEvent::MOUSE_BUTTON;
+				event.press = last_state->buttons & (1 << i) ? 0 : 1;
+				event.code  = i + 1;
 
-				events.push_back(event);		
+				ring_push(ring,event);
 			}	
 		}
 		
@@ -167,109 +353,299 @@ void isabelX11::record_user(void)
 			{
 				if((difference >> i) & 0x01)
 				{
-					UserEvent *event = new UserEvent(); 
-					event->set_type(UserEvent::KEYBOARD);
-					event->set_instant(instant); 
-					
-					if((state.keys[k] >> i) & 0x01)
-					{
-						event->set_press(true);
-					}
-					else
+					/* named when drained, so nothing is allocated while recording */
+					event.type  = UserEvent::KEYBOARD;
+					event.press = (state.keys[k] >> i) & 0x01;
+					event.code  = keymap.keysym(8*k + i,state.modifiers);
+
+					if(NoSymbol != event.code)
 					{
-						event->set_press(false); 
+						ring_push(ring,event);
 					}
-
-					int shift = state.modifiers & ShiftMask ? 1 : 0;
-					event->set_key(XKeysymToString(XkbKeycodeToKeysym((Display *)display,8*k + i,0,shift))); 
-
-					events.push_back(event); 
 				}	
 			}
 		}
 					
 		last_state->keys[k] = state.keys[k];
 	}
-
-	/* increment the elapsed time */
-	instant += USER_SAMPLE_TIME;
 }
 
 
 bool isabelX11::simulate_user(const UserEvent &event)
 {
-	bool result = true; 
-	
+	refresh_keymap();
+
+	return inject_user(event) && flush_user();
+}
+
+bool isabelX11::inject_user(const UserEvent &event)
+{
+	Display *x11 = (Display *)display;
+
 	switch(event.type())
 	{
 		case UserEvent::MOUSE_MOVE_REL:
-			XWarpPointer((Display *)display,None,None,0,0,0,0,event.xpos(),event.ypos());
-			XFlush((Display *)display);
+			XWarpPointer(x11,None,None,0,0,0,0,event.xpos(),event.ypos());
 			break; 
 
 		case UserEvent::MOUSE_MOVE_ABS:
-			/* first move the mouse to the origin, then to the absolute position */
-			{
-				T_X11_STATE state;
-				get_x11_state(&state); 
-
-				XWarpPointer((Display *)display,None,None,0,0,0,0,-state.xpos,-state.ypos);
-				XWarpPointer((Display *)display,None,None,0,0,0,0,event.xpos(),event.ypos());
-				XFlush((Display *)display);
-			}
+			/* relative to the root window, so the current position is not needed */
+			XWarpPointer(x11,None,DefaultRootWindow(x11),0,0,0,0,event.xpos(),event.ypos());
 			break; 
 
 		case UserEvent::MOUSE_BUTTON:
-			{
-				XTestFakeButtonEvent((Display *)display,event.button(),event.press(),CurrentTime);
-				XFlush((Display *)display);
-  			}
+			XTestFakeButtonEvent(x11,event.button(),event.press(),CurrentTime);
 			break; 
 
 		case UserEvent::KEYBOARD:
 			{
-  				/* take from here: http://www.doctort.org/adam/nerd-notes/x11-fake-keypress-event.html */
-				/* get the window with the current focus */
-				Window winFocus;
-   				int    revert;
-   				XGetInputFocus((Display *)display,&winFocus,&revert);
-
-				/* build the event */
-				XKeyEvent ev;
-				memset(&ev,0,sizeof(ev));
-
-   				ev.display     = (Display *)display;
-   				ev.window      = winFocus;  
-   				ev.root        = XDefaultRootWindow((Display *)display);
-   				ev.subwindow   = None;
-   				ev.time        = CurrentTime;
-   				ev.x           = 1;
-   				ev.y           = 1;
-   				ev.x_root      = 1;
-   				ev.y_root      = 1;
-   				ev.same_screen = True;
-   				ev.keycode     = XKeysymToKeycode((Display *)display,XStringToKeysym(event.key().c_str()));
-   				ev.state       = XkbKeysymToModifiers((Display *)display,XStringToKeysym(event.key().c_str()));
-
-   				if(event.press())
-   				{
-   					ev.type = KeyPress;		
-   				}
-   				else
-   				{
-   					ev.type = KeyRelease;				
-   				}
-      
-   				XSendEvent(ev.display, ev.window, True, KeyPressMask, (XEvent *)&ev);
+				T_KEY_CODE code;
+
+				if(!keymap.find(event.key(),code))
+				{
+					return false;
+				}
+
+				if(event.press())
+				{
+					/* the modifiers of the key level, unless the previous keys already hold them */
+					uint32_t missing = code.modifiers & ~held;
+
+					fake_modifiers(missing,true);
+					XTestFakeKeyEvent(x11,code.keycode,True,CurrentTime);
+					fake_modifiers(missing,false);
+
+					held |= keymap.modifiers(code.keycode);
+					pressed[code.keycode/8] |= 1 << (code.keycode % 8);
+				}
+				else
+				{
+					XTestFakeKeyEvent(x11,code.keycode,False,CurrentTime);
+
+					held &= ~keymap.modifiers(code.keycode);
+					pressed[code.keycode/8] &= ~(1 << (code.keycode % 8));
+				}
 			} 
 			break; 
 
 		default:
-			result = false;
-			break; 
+			return false;
 	}
 
-	return result;
+	return true;
+}
+
+bool isabelX11::flush_user(void)
+{
+	XErrorHandler previous = XSetErrorHandler(x11_error);
+	x11_failed = false;
+
+	/* a single round trip for all of the queued events */
+	XSync((Display *)display,False);
+
+	XSetErrorHandler(previous);
+
+	return !x11_failed;
+}
+
+void isabelX11::release_user(void)
+{
+	for(int keycode = 0; keycode < 8*X11_KEYS_SIZE; keycode++)
+	{
+		if((pressed[keycode/8] >> (keycode % 8)) & 0x01)
+		{
+			XTestFakeKeyEvent((Display *)display,keycode,False,CurrentTime);
+		}
+	}
+
+	/* the modifiers are only held by the pressed keys */
+	memset(pressed,0,sizeof(pressed));
+	held = 0;
+
+	flush_user();
+}
+
+bool isabelX11::grab_window(QImage &image, QPoint &position, unsigned long win_id, const QRect &region)
+{
+	if(!shm_available)
+	{
+		return false;
+	}
+
+	Display 		  *x11 	  = (Display *)display;
+	Window 			  window  = (0 == win_id) ? DefaultRootWindow(x11) : (Window)win_id;
+	XWindowAttributes attributes;
+	bool 			  grabbed = false;
+
+	/* the X11 server reports a bad window, or a window not shown, as an error */
+	XErrorHandler previous = XSetErrorHandler(x11_error);
+	x11_failed = false;
+
+	if(XGetWindowAttributes(x11,window,&attributes) && (IsViewable == attributes.map_state))
+	{
+		QRect bounds(0,0,attributes.width,attributes.height);
+		QRect area = region.isNull() ? bounds : (region & bounds);
+
+		if(!area.isEmpty() && shm_create(area.width(),area.height()))
+		{
+			XImage *shared = (XImage *)shm_image;
+
+			if(XShmGetImage(x11,window,shared,area.x(),area.y(),AllPlanes) && !x11_failed)
+			{
+				/* the segment is reused by the next grab, so the pixels are copied */
+				int 	x;
+				int 	y;
+				Window 	child;
+
+				/* the window position is needed to place the pixels on the screen */
+				XTranslateCoordinates(x11,window,DefaultRootWindow(x11),area.x(),area.y(),&x,&y,&child);
+
+				image 	 = QImage(area.width(),area.height(),QImage::Format_RGB32);
+				position = QPoint(x,y);
+				grabbed  = !x11_failed && !image.isNull();
+
+				/* the X11 server leaves the padding byte at zero, Format_RGB32 expects it at 255,
+				   so it is set while copying the pixels out of the segment, not in a second pass */
+				for(int row = 0; grabbed && (row < image.height()); row++)
+				{
+					const uint32_t *source = (const uint32_t *)(shared->data + row*shared->bytes_per_line);
+					uint32_t 	   *target = (uint32_t *)image.scanLine(row);
+
+					for(int column = 0; column < image.width(); column++)
+					{
+						target[column] = source[column] | 0xFF000000;
+					}
+				}
+			}
+		}
+	}
+
+	XSetErrorHandler(previous);
+
+	return grabbed;
+}
+
+bool isabelX11::window_origin(QPoint &origin, unsigned long win_id)
+{
+	Display *x11 = (Display *)display;
+	Window 	root = DefaultRootWindow(x11);
+	Window 	child;
+	int 	x = 0;
+	int 	y = 0;
+
+	XErrorHandler previous = XSetErrorHandler(x11_error);
+	x11_failed = false;
+
+	if(0 != win_id)
+	{
+		XTranslateCoordinates(x11,(Window)win_id,root,0,0,&x,&y,&child);
+		XSync(x11,False);
+	}
+
+	XSetErrorHandler(previous);
+
+	origin = QPoint(x,y);
+
+	return !x11_failed;
+}
+
+bool isabelX11::shm_create(int width, int height)
+{
+	XImage *shared = (XImage *)shm_image;
+
+	if((NULL != shared) && (width == shared->width) && (height == shared->height))
+	{
+		return true;
+	}
+
+	shm_destroy();
+
+	Display 		*x11  = (Display *)display;
+	int 			screen = DefaultScreen(x11);
+	XShmSegmentInfo *info = new XShmSegmentInfo();
+
+	shared = XShmCreateImage(x11,DefaultVisual(x11,screen),DefaultDepth(x11,screen),ZPixmap,NULL,info,width,height);
+
+	/* only the layout of Format_RGB32 is supported, as used by 24 and 32 bits displays */
+	if((NULL == shared) || (32 != shared->bits_per_pixel) || (LSBFirst != shared->byte_order) || (0x00FF0000 != shared->red_mask))
+	{
+		if(NULL != shared)
+		{
+			XDestroyImage(shared);
+		}
+
+		delete info;
+		shm_available = false;
+		return false;
+	}
+
+	info->shmid = shmget(IPC_PRIVATE,shared->bytes_per_line*shared->height,IPC_CREAT | 0600);
+	info->shmaddr = (char *)((-1 == info->shmid) ? (void *)-1 : shmat(info->shmid,NULL,0));
+	info->readOnly = False;
+	shared->data = info->shmaddr;
+
+	if((void *)-1 == (void *)info->shmaddr)
+	{
+		if(-1 != info->shmid)
+		{
+			shmctl(info->shmid,IPC_RMID,NULL);
+		}
+
+		shared->data = NULL;
+		XDestroyImage(shared);
+		delete info;
+		shm_available = false;
+		return false;
+	}
+
+	x11_failed = false;
+
+	Bool attached = XShmAttach(x11,info);
+
+	/* the error, if any, only arrives once the X11 server handled the request */
+	XSync(x11,False);
+
+	if(!attached || x11_failed)
+	{
+		/* the X11 server is on another machine, it cannot attach the segment */
+		shmdt(info->shmaddr);
+		shmctl(info->shmid,IPC_RMID,NULL);
+		shared->data = NULL;
+		XDestroyImage(shared);
+		delete info;
+		shm_available = false;
+		return false;
+	}
+
+	/* the segment is released as soon as both processes detach from it, even if the application crashes */
+	shmctl(info->shmid,IPC_RMID,NULL);
+
+	shm_image = shared;
+	shm_info  = info;
+
+	return true;
+}
+
+void isabelX11::shm_destroy(void)
+{
+	if(NULL == shm_image)
+	{
+		return;
+	}
+
+	XImage 			*shared = (XImage *)shm_image;
+	XShmSegmentInfo *info 	= (XShmSegmentInfo *)shm_info;
+
+	XShmDetach((Display *)display,info);
+	XSync((Display *)display,False);
+
+	shmdt(info->shmaddr);
+	shared->data = NULL;
+	XDestroyImage(shared);
+	delete info;
+
+	shm_image = NULL;
+	shm_info  = NULL;
 }
 
 void isabelX11::get_x11_state(T_X11_STATE *state)
@@ -299,5 +675,59 @@ void isabelX11::get_x11_state(T_X11_STATE *state)
 	state->modifiers = event.xbutton.state & 0x00FF;
 }
 
+void isabelX11::fake_modifiers(uint32_t modifiers, bool press)
+{
+	for(int m = 0; m < KEYMAP_MODIFIERS; m++)
+	{
+		int keycode = keymap.modifier_key(modifiers & (1 << m));
+
+		if(0 != keycode)
+		{
+			XTestFakeKeyEvent((Display *)display,keycode,press,CurrentTime);
+		}
+	}
+}
+
+const isabelKeymap &isabelX11::keyboard(void)
+{
+	refresh_keymap();
+
+	return keymap;
+}
+
+void isabelX11::refresh_keymap(void)
+{
+	XEvent event;
+	bool   changed = false;
+
+	/* sent to every client, so it is queued even though no event is selected */
+	while(XCheckTypedEvent((Display *)display,MappingNotify,&event))
+	{
+		if((MappingModifier == event.xmapping.request) || (MappingKeyboard == event.xmapping.request))
+		{
+			/* also the mapping cached by Xlib */
+			XRefreshKeyboardMapping(&event.xmapping);
+			changed = true;
+		}
+	}
+
+	if(changed)
+	{
+		QMutexLocker locker(&lock);
+
+		keymap.read(display);
+	}
+}
+
 
 /*--------------------- Private Function Definitions ----------------*/
+
+static int x11_error(Display *display, XErrorEvent *error)
+{
+	Q_UNUSED(display);
+	Q_UNUSED(error);
+
+	x11_failed = true;
+
+	return 0;
+}
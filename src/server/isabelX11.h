@@ -25,17 +25,46 @@
    This module interfaces the X11 server, providing the functionality to:
    	- capture user mouse and keyboard events
    	- replay user events
+   	- grab the screen, or a window, through a shared memory segment
+
+   The grab uses the MIT-SHM extension: the X server copies the pixels
+   straight into a segment shared with the application, which is kept
+   from one grab to the next, so nothing is sent over the X11 socket.
+   Whenever the extension is not available, as with remote displays,
+   the grab fails and the caller falls back to QScreen::grabWindow().
+
+   The user events are recorded with the RECORD extension, see isabelRecord.
+   When it is not available, the mouse and keyboard state is polled every
+   10 milliseconds instead, which misses the presses shorter than that.
+   The samples are stamped from a monotonic clock, in microseconds, along
+   with how late they were, as the timer slips when the application is
+   busy.
+
+   The keys are named, and converted back to key codes, with the tables
+   of isabelKeymap, which are read again only when the X11 server reports
+   a change of the keyboard mapping.
  */
 #ifndef __ISABEL_X11_H__
 #define __ISABEL_X11_H__
 
 #include <QObject>
 #include <QTimer>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QString>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
 
 #include <string>
 #include <vector>
 
 #include "protocol.pb.h"
+#include "isabelRing.h"
+#include "isabelJournal.h"
+#include "isabelKeymap.h"
+
+class isabelRecord;
 
 /*--------------------- Public Variable Declarations ----------------*/
 
@@ -66,16 +95,32 @@ public:
 	~isabelX11();
 
 	/* Begin recording the user events.
+
+		@max_events 	number of events kept until drained, the oldest are dropped first
+		@file 			if not empty, the events are written to this file as they happen,
+						instead of being kept for the client
+		@tolerance 		the mouse paths are simplified within this distance, in pixels, 0 keeps every move
+
+		#returns true if successfull, false if the file cannot be created
 	 */
-	void start_recording(void); 
+	bool start_recording(unsigned int max_events, const QString &file, double tolerance); 
+
+	/* Return the events recorded so far, while the recording goes on.
+
+		@response 	where the events, and the number of those dropped, are returned.
+					When recording to a file, only the number of events written to it.
+	 */
+	void drain_recording(Response &response);
 
 	/* Stop recording the user events.
 
-		#returns the list of recorded events
+		@response 	where the events not yet drained, and the number of those dropped, are returned
+
+		#returns true if successfull, false if the events could not be written to the file
 	 */
-	std::vector<UserEvent *> &stop_recording(void); 
+	bool stop_recording(Response &response); 
 
-	/* Simulate user an user
+	/* Simulate an user event, and wait until the X11 server processed it.
 
 		@user the user event to simulate
 
@@ -83,11 +128,74 @@ public:
 	 */
 	bool simulate_user(const UserEvent &event);
 
+	/* Queue an user event, it is sent to the X11 server on the next flush.
+
+		The keys are pressed through the XTEST extension, as if typed on the
+		keyboard, along with the modifiers of their level not already held.
+		The keyboard mapping is not read again, see refresh_keymap().
+
+		@user the user event to simulate
+
+		#returns true if successfull, false if the event or its key are unknown
+	 */
+	bool inject_user(const UserEvent &event);
+
+	/* Send the queued user events to the X11 server, and wait until it processed them.
+
+		#returns true if successfull, false if the X11 server reported an error
+	 */
+	bool flush_user(void);
+
+	/* Release the keys still pressed by the simulated user events, after a failure.
+
+		Otherwise the keys, and the modifiers they hold, stay pressed for the
+		next user events, and for the user of the X11 server.
+	*/
+	void release_user(void);
+
+	/* Read the keyboard mapping again, if the X11 server reported it changed.
+
+		Called once before injecting a batch of user events, not for each key.
+	*/
+	void refresh_keymap(void);
+
+	/* Return the keyboard mapping, read again first if it changed.
+
+		Only the GUI thread changes the mapping, so it reads it without the lock.
+
+		#returns the keyboard mapping
+	*/
+	const isabelKeymap &keyboard(void);
+
+	/* Grab a region of a X11 window, or of the whole screen, using shared memory.
+
+		@image 		where the grabbed pixels are returned
+		@position 	where the position of the grabbed pixels on the screen is returned
+		@win_id 	the X11 window identifier, use 0 for the whole screen
+		@region 	the region to grab, relative to the window, use a null rectangle to grab all of it
+
+		#returns true if successfull, false if shared memory cannot be used, or the window is not shown
+	*/
+	bool grab_window(QImage &image, QPoint &position, unsigned long win_id, const QRect &region);
+
+	/* Return the position of a X11 window on the screen.
+
+		@origin 	where the position of the window top left corner is returned
+		@win_id 	the X11 window identifier, use 0 for the whole screen
+
+		#returns true if successfull, false if the window does not exist
+	*/
+	bool window_origin(QPoint &origin, unsigned long win_id);
+
 public slots:
 	/* Record the user events.
 	 */
 	void record_user(void);
 
+	/* Write the events recorded so far to the file.
+	 */
+	void write_journal(void);
+
 private:
 	/* Return the current mouse state and the keybaord modifiers
 
@@ -95,12 +203,68 @@ private:
 	*/
 	void get_x11_state(T_X11_STATE *state); 
 
+	/* Return the events recorded so far.
+
+		@response 	where the events, and the number of those dropped, are returned
+		@close 		true to end the open mouse path, at the end of the recording
+	*/
+	void drain_events(Response &response, bool close);
+
+	/* Write the events recorded so far to the file.
+
+		@close 		true to end the open mouse path, at the end of the recording
+	*/
+	void journal_events(bool close);
+
+	/* Simplify the mouse paths of the events drained from the ring.
+
+		@events 	the drained events, replaced by those ready to be sent
+		@close 		true to end the open mouse path, at the end of the recording
+	*/
+	void simplify_paths(std::vector<T_USER_EVENT> &events, bool close);
+
+	/* Press, or release, the keys that set the modifiers.
+
+		@modifiers 	the modifier mask
+		@press 		true to press the keys, false to release them
+	*/
+	void fake_modifiers(uint32_t modifiers, bool press);
+
+	/* Create the shared memory image, if it does not exist or has a different size.
+
+		@width 		width of the image, in pixels
+		@height 	height of the image, in pixels
+
+		#returns true if successfull, false otherwise
+	*/
+	bool shm_create(int width, int height);
+
+	/* Release the shared memory image.
+	*/
+	void shm_destroy(void);
+
 private:
 	QTimer 					 *timer; 					/* sets the rate at which user events are captured */
-	std::vector<UserEvent *> events; 					/* list of recorded user events */
-	unsigned int             instant;					/* count the elapsed time, when recording events */
+	isabelRecord 			 *recorder; 				/* records the user events as they happen */
+	T_EVENT_RING 			 ring; 						/* the recorded user events, until drained */
+	QMutex 					 lock; 						/* protects the ring and the keymap, also used by the recorder thread */
+	isabelKeymap 			 keymap; 					/* the keyboard mapping */
+	uint32_t 				 held; 						/* the modifiers held by the simulated keys */
+	char 					 pressed[X11_KEYS_SIZE]; 	/* the keys pressed by the simulated events, a bit per keycode */
+	QTimer 					 *flusher; 					/* sets the rate at which the events are written to the file */
+	isabelJournalWriter 	 journal; 					/* the file where the events are written */
+	bool 					 journaling; 				/* true when recording to the file */
+	unsigned int 			 journal_dropped; 			/* number of events dropped before reaching the file */
+	double 					 path_tolerance; 			/* the mouse paths are simplified within this distance, 0 if not */
+	std::vector<T_USER_EVENT> path_open; 				/* the moves of the mouse path not yet ended */
+	QElapsedTimer 			 path_idle; 				/* time since the last events were drained */
+	QElapsedTimer 			 clock; 					/* time since the recording began, when polling */
+	uint64_t 				 sampled; 					/* instant of the last sample, in microseconds */
 	T_X11_STATE			 	 *last_state; 				/* last state of X11 mouse and keyboard */
 	void 			 	 	 *display;					/* X11 client */
+	void 					 *shm_image; 				/* the image kept in shared memory, NULL if none */
+	void 					 *shm_info; 				/* the shared memory segment of the image */
+	bool 					 shm_available; 			/* false once the shared memory failed */
 }; 
 
 #endif
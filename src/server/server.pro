@@ -12,8 +12,22 @@ HEADERS  	= isabel.h \
 			  isabelStartup.h \
 			  isabelServer.h \
 			  isabelX11.h \
+			  isabelRecord.h \
+			  isabelEvents.h \
+			  isabelRing.h \
+			  isabelJournal.h \
+			  isabelPath.h \
+			  isabelKeymap.h \
 			  isabelSLIP.h \
 			  isabelSerialize.h \
+			  isabelWait.h \
+			  isabelReplay.h \
+			  isabelGesture.h \
+			  isabelStream.h \
+			  isabelCompress.h \
+			  isabelImage.h \
+			  isabelCapture.h \
+			  isabelPixels.h \
 			  json.h \
 			  protocol.pb.h
 
@@ -21,7 +35,27 @@ SOURCES  	= isabel.cpp \
 			  isabelStartup.cpp \
 			  isabelServer.cpp \
 			  isabelX11.cpp \
+			  isabelRecord.cpp \
+			  isabelEvents.cpp \
+			  isabelRing.cpp \
+			  isabelJournal.cpp \
+			  isabelPath.cpp \
+			  isabelKeymap.cpp \
 			  isabelSLIP.cpp \
 			  isabelSerialize.cpp \
+			  isabelWait.cpp \
+			  isabelReplay.cpp \
+			  isabelGesture.cpp \
+			  isabelStream.cpp \
+			  isabelCompress.cpp \
+			  isabelImage.cpp \
+			  isabelCapture.cpp \
+			  isabelPixels.cpp \
 			  json.cpp \
 			  protocol.pb.cc
+
+# optional zstd compression of the responses: qmake CONFIG+=zstd
+zstd {
+	DEFINES 	+= ISABEL_ZSTD
+	LIBS 		+= -lzstd
+}
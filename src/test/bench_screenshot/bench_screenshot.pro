@@ -0,0 +1,28 @@
+QT 			+= concurrent network widgets quick
+CONFIG      += release
+OBJECTS_DIR = ../../build
+MOC_DIR     = ../../build
+DESTDIR 	= ../../build
+INCLUDEPATH += ../../server /usr/include/google/protobuf
+LIBS        += -L /usr/lib -lprotobuf -lcairo -lX11 -lXtst -lXext
+
+HEADERS  	= ../../server/isabelImage.h \
+			  ../../server/isabelPixels.h \
+			  ../../server/isabelX11.h \
+			  ../../server/isabelRecord.h \
+			  ../../server/isabelRing.h \
+			  ../../server/isabelJournal.h \
+			  ../../server/isabelPath.h \
+			  ../../server/isabelKeymap.h \
+			  ../../server/protocol.pb.h
+
+SOURCES  	= ../../server/isabelImage.cpp \
+			  ../../server/isabelPixels.cpp \
+			  ../../server/isabelX11.cpp \
+			  ../../server/isabelRecord.cpp \
+			  ../../server/isabelRing.cpp \
+			  ../../server/isabelJournal.cpp \
+			  ../../server/isabelPath.cpp \
+			  ../../server/isabelKeymap.cpp \
+			  ../../server/protocol.pb.cc \
+			  main.cpp
@@ -0,0 +1,157 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+   
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Benchmark of the screenshots: measures how long it takes to grab the
+   screen and to encode it with each of the supported encodings. The time
+   spent encoding is no longer spent in the GUI thread of the application
+   under test, but it still delays the response.
+
+   The grab is measured both with QScreen::grabWindow() and through the
+   X11 shared memory, for instance when running under Xvfb.
+
+   Usage: bench_screenshot [iterations]
+*/
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QScreen>
+#include <QPixmap>
+#include <QImage>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "isabelImage.h"
+#include "isabelX11.h"
+
+/*--------------------- Private Variable Declarations ----------------*/
+
+#define BENCH_ITERATIONS (20)	/* default number of times each step is measured */
+
+typedef struct{
+	const char *name; 		// name of the encoding
+	int 		encoding; 	// one of Image::Encoding
+	int 		quality; 	// the encoding quality, as in QImage::save
+} T_BENCH;
+
+/*--------------------- Private Function Declarations ----------------*/
+
+/* Print the timing of a benchmark step.
+
+	@name 		 the name of the step
+	@iterations  number of times the step was executed
+	@elapsed 	 total time, in nanoseconds, spent in the step
+	@size 		 size, in bytes, of the step output
+*/
+static void report(const char *name, int iterations, qint64 elapsed, int size);
+
+/*--------------------- Public Function Definitions ----------------*/
+
+int main(int argc, char *argv[])
+{
+	QApplication app(argc,argv);
+
+	int iterations = (1 < argc) ? atoi(argv[1]) : BENCH_ITERATIONS;
+
+	if(0 >= iterations)
+	{
+		iterations = BENCH_ITERATIONS;
+	}
+
+	QScreen *screen = QGuiApplication::primaryScreen();
+
+	if(NULL == screen)
+	{
+		fprintf(stderr,"no screen available\n");
+		return 1;
+	}
+
+	/* for PNG, the quality sets the compression level: 100 is the fastest, 0 the smallest */
+	const T_BENCH encodings[] = {
+		{ "png", 	  Image::PNG,  -1 },
+		{ "png q=100",Image::PNG, 100 },
+		{ "png q=0",  Image::PNG,   0 },
+		{ "raw", 	  Image::RAW,  -1 },
+		{ "qoi", 	  Image::QOI,  -1 },
+		{ "jpeg q=90",Image::JPEG, 90 },
+		{ "jpeg q=50",Image::JPEG, 50 },
+	};
+
+	QElapsedTimer clock;
+	QImage image;
+
+	/* the grab is the only step left in the GUI thread */
+	clock.start();
+
+	for(int i = 0; i < iterations; i++)
+	{
+		image = screen->grabWindow(0).toImage();
+	}
+
+	report("grab",iterations,clock.nsecsElapsed(),image.byteCount());
+
+	/* the same grab, through the X11 shared memory */
+	isabelX11 x11(NULL);
+	QImage 	  shared;
+	QPoint 	  position;
+
+	if(x11.grab_window(shared,position,0,QRect()))
+	{
+		clock.restart();
+
+		for(int i = 0; i < iterations; i++)
+		{
+			x11.grab_window(shared,position,0,QRect());
+		}
+
+		report("grab shm",iterations,clock.nsecsElapsed(),shared.byteCount());
+	}
+	else
+	{
+		printf(" - %-10s: not available\n","grab shm");
+	}
+
+	for(unsigned int e = 0; e < sizeof(encodings)/sizeof(encodings[0]); e++)
+	{
+		QByteArray blob;
+
+		clock.restart();
+
+		for(int i = 0; i < iterations; i++)
+		{
+			blob = image_encode(image,(Image::Encoding)encodings[e].encoding,encodings[e].quality);
+		}
+
+		report(encodings[e].name,iterations,clock.nsecsElapsed(),blob.size());
+	}
+
+	return 0;
+}
+
+/*--------------------- Private Function Definitions ----------------*/
+
+static void report(const char *name, int iterations, qint64 elapsed, int size)
+{
+	printf(" - %-10s: %8.2f ms, %10d bytes\n",name,elapsed/(1e6*iterations),size);
+}
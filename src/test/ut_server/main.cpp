@@ -30,10 +30,24 @@
 #include <cassert>
 
 #include "ut_slip.h"
+#include "ut_compress.h"
+#include "ut_pixels.h"
+#include "ut_ring.h"
+#include "ut_journal.h"
+#include "ut_path.h"
+#include "ut_keymap.h"
+#include "ut_gesture.h"
 
 int main(void)
 {
 	assert(0 == ut_slip());
+	assert(0 == ut_compress());
+	assert(0 == ut_pixels());
+	assert(0 == ut_ring());
+	assert(0 == ut_journal());
+	assert(0 == ut_path());
+	assert(0 == ut_keymap());
+	assert(0 == ut_gesture());
 
 	return 0;
 }
@@ -0,0 +1,147 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+*/
+
+#include "ut_compress.h"
+#include "isabelCompress.h"
+
+#include <cassert>
+#include <QByteArray>
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+
+/*-------------------- Test Cases Declaration -------------------------- */
+/* Verify which compression methods are always available.
+*/
+static void compress_supported_methods(void);
+
+/* Compress and decompress an array of repetitive text.
+*/
+static void compress_encdec_text(void);
+
+/* Compress and decompress an arbitrary array, with every method.
+*/
+static void compress_encdec_arbitrary(void);
+
+/* Decompress an array with the wrong length.
+*/
+static void compress_decode_invalid(void);
+
+/*-------------------- Test Cases Main -------------------------- */
+int ut_compress(void)
+{
+	std::cerr << "---------------------------" << std::endl; 
+	std::cerr << "Response compression       " << std::endl; 
+	std::cerr << "---------------------------" << std::endl; 
+
+	/* run all of the test cases */
+	compress_supported_methods();
+	compress_encdec_text();
+	compress_encdec_arbitrary();
+	compress_decode_invalid();
+
+	return 0; 
+}
+
+/*-------------------- Test Cases Implementation ---------------------- */
+
+static void compress_supported_methods(void)
+{
+	std::cerr << " - supported compression methods: "; 
+
+	assert(compress_supported(Compressed::NONE));
+	assert(compress_supported(Compressed::ZLIB));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void compress_encdec_text(void)
+{
+	std::cerr << " - compressing/decompressing repetitive text: "; 
+
+	/* something that looks like an object tree */
+	QByteArray text;
+
+	for(int i = 0; i < 1000; i++)
+	{
+		text.append("QQuickRectangle:QQuickItem:QObject{\"visible\":true,\"opacity\":1.0}");
+	}
+
+	QByteArray text_enc = compress_encode(Compressed::ZLIB,text);
+	assert(0 < text_enc.size());
+	assert(text.size() > 10*text_enc.size());
+
+	QByteArray text_dec = compress_decode(Compressed::ZLIB,text_enc,text.size());
+	assert(text_dec == text);
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void compress_encdec_arbitrary(void)
+{
+	std::cerr << " - compressing/decompressing an arbitrary array: "; 
+
+	int length = 50*1024; 
+
+	QByteArray arbitrary(length,0x00);
+
+	srand(time(NULL));
+
+	for(int i = 0; i < arbitrary.size(); i++)
+	{
+		arbitrary[i] = rand() % 256;
+ 	}
+
+	Compressed::Method methods[] = { Compressed::NONE, Compressed::ZLIB, Compressed::ZSTD };
+
+	for(unsigned int m = 0; m < sizeof(methods)/sizeof(methods[0]); m++)
+	{
+		if(compress_supported(methods[m]))
+		{
+			QByteArray arbitrary_enc = compress_encode(methods[m],arbitrary);
+			assert(0 < arbitrary_enc.size());
+
+			QByteArray arbitrary_dec = compress_decode(methods[m],arbitrary_enc,arbitrary.size());
+			assert(arbitrary_dec == arbitrary);
+		}
+	}
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void compress_decode_invalid(void)
+{
+	std::cerr << " - decompressing with the wrong length: "; 
+
+	QByteArray text("isabel isabel isabel isabel isabel isabel");
+	QByteArray text_enc = compress_encode(Compressed::ZLIB,text);
+
+	assert(compress_decode(Compressed::ZLIB,text_enc,text.size() + 1).isEmpty());
+	assert(compress_decode(Compressed::NONE,text,text.size() - 1).isEmpty());
+
+	std::cerr << "PASS" << std::endl; 
+}
@@ -0,0 +1,257 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+*/
+
+#include "ut_gesture.h"
+#include "isabelGesture.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+extern "C"
+{
+	#include <X11/Xlib.h>
+	#include <X11/keysym.h>
+}
+
+/*-------------------- Test Cases Declaration -------------------------- */
+/* Type a text, with its special and non Latin-1 characters.
+*/
+static void gesture_typing(void);
+
+/* Move the mouse along straight segments, at a constant speed.
+*/
+static void gesture_linear(void);
+
+/* Drag along a smooth curve through the waypoints.
+*/
+static void gesture_smooth(void);
+
+/*-------------------- Test Cases Main -------------------------- */
+int ut_gesture(void)
+{
+	std::cerr << "---------------------------" << std::endl; 
+	std::cerr << "Text and mouse path gestures" << std::endl; 
+	std::cerr << "---------------------------" << std::endl; 
+
+	/* run all of the test cases */
+	gesture_typing();
+	gesture_linear();
+	gesture_smooth();
+
+	return 0; 
+}
+
+/*-------------------- Test Cases Implementation ---------------------- */
+
+/* Add a waypoint to the request.
+*/
+static void gesture_waypoint(Request &request, int x, int y)
+{
+	Point *point = request.add_waypoints();
+
+	point->set_x(x);
+	point->set_y(y);
+}
+
+/* A keyboard with Latin-1, legacy and Unicode key symbols, and Shift.
+*/
+static const unsigned long gesture_mapping[] = {
+	XK_a, 		 	XK_A,
+	XK_space, 	 	NoSymbol,
+	XK_b, 		 	XK_B,
+	XK_eacute, 	 	XK_Eacute,
+	XK_EuroSign, 	NoSymbol,
+	XK_Greek_alpha, XK_Greek_ALPHA,
+	0x0101F600, 	NoSymbol,
+	XK_Shift_L, 	NoSymbol,
+};
+
+/* The modifier map, Shift only.
+*/
+static const uint8_t gesture_modmap[] = {
+	17, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static void gesture_typing(void)
+{
+	std::cerr << " - typing a text: "; 
+
+	Request 				request;
+	std::vector<ReplayStep> steps;
+	isabelKeymap 			keymap;
+
+	keymap.build(10,17,2,gesture_mapping,1,gesture_modmap);
+
+	request.set_type(Request::TYPE_TEXT);
+	request.set_text("a B\n\xC3\xA9\xE2\x82\xAC\xCE\xB1\xF0\x9F\x98\x80");
+	request.set_cadence(40);
+
+	assert(gesture_text(request,keymap,steps));
+	assert(16 == steps.size());
+
+	/* the key symbols of the layout, whichever they are for each character */
+	const char *names[] = {"a", "space", "B", "Return", "eacute", "EuroSign", "Greek_alpha", "U0001F600"};
+
+	for(size_t s = 0; s < steps.size(); s++)
+	{
+		const UserEvent &event = steps[s].event();
+
+		assert(UserEvent::KEYBOARD == event.type());
+		assert(names[s/2] == event.key());
+		assert((0 == s % 2) == event.press());
+
+		/* a key every 40 milliseconds, held for 20 */
+		assert(40000*(s/2) + 20000*(s % 2) == event.instant_us());
+		assert(event.instant_us()/1000 == event.instant());
+	}
+
+	/* the text must be valid UTF-8 */
+	steps.clear();
+	request.set_text("a\xC3");
+	assert(!gesture_text(request,keymap,steps));
+
+	steps.clear();
+	request.set_text("\xFF");
+	assert(!gesture_text(request,keymap,steps));
+
+	/* the characters must be on the layout */
+	steps.clear();
+	request.set_text("abz");
+	assert(!gesture_text(request,keymap,steps));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void gesture_linear(void)
+{
+	std::cerr << " - moving along straight segments: "; 
+
+	Request 				request;
+	std::vector<ReplayStep> steps;
+
+	request.set_type(Request::POINTER_PATH);
+
+	/* there must be somewhere to move to */
+	assert(!gesture_path(request,steps));
+
+	/* 300 pixels to the right, then 100 down, in 400 milliseconds */
+	gesture_waypoint(request,100,100);
+	gesture_waypoint(request,400,100);
+	gesture_waypoint(request,400,200);
+	request.set_duration(400);
+	request.set_move_interval(10);
+
+	assert(gesture_path(request,steps));
+	assert(41 == steps.size());
+
+	for(size_t s = 0; s < steps.size(); s++)
+	{
+		const UserEvent &event = steps[s].event();
+
+		/* a pixel every millisecond, the corner is at 300 milliseconds */
+		assert(UserEvent::MOUSE_MOVE_ABS == event.type());
+		assert(10000*s == event.instant_us());
+
+		if(300 >= 10*s)
+		{
+			assert((100 + 10*(int)s == event.xpos()) && (100 == event.ypos()));
+		}
+		else
+		{
+			assert((400 == event.xpos()) && (10*(int)s - 200 == event.ypos()));
+		}
+	}
+
+	/* a single waypoint moves there, and nothing else */
+	steps.clear();
+	request.clear_waypoints();
+	gesture_waypoint(request,50,60);
+
+	assert(gesture_path(request,steps));
+	assert(1 == steps.size());
+	assert((50 == steps[0].event().xpos()) && (60 == steps[0].event().ypos()));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void gesture_smooth(void)
+{
+	std::cerr << " - dragging along a smooth curve: "; 
+
+	Request 				request;
+	std::vector<ReplayStep> steps;
+
+	request.set_type(Request::POINTER_PATH);
+	gesture_waypoint(request,0,0);
+	gesture_waypoint(request,200,200);
+	gesture_waypoint(request,400,0);
+	request.set_duration(500);
+	request.set_move_interval(5);
+	request.set_button(1);
+	request.set_smooth(true);
+
+	assert(gesture_path(request,steps));
+
+	/* the button is held from the first waypoint to the last */
+	const UserEvent &first = steps.front().event();
+	const UserEvent &last  = steps.back().event();
+
+	assert((UserEvent::MOUSE_MOVE_ABS == steps[0].event().type()) && (0 == first.xpos()) && (0 == first.ypos()));
+	assert((UserEvent::MOUSE_BUTTON == steps[1].event().type()) && (1 == steps[1].event().button()) && steps[1].event().press());
+	assert((UserEvent::MOUSE_BUTTON == last.type()) && (1 == last.button()) && !last.press());
+	assert(500000 == last.instant_us());
+
+	const UserEvent &end = steps[steps.size() - 2].event();
+
+	assert((400 == end.xpos()) && (0 == end.ypos()));
+
+	/* the curve goes through the middle waypoint, and never jumps */
+	bool 	 through = false;
+	int 	 xpos 	 = 0;
+	int 	 ypos 	 = 0;
+	uint64_t instant = 0;
+
+	for(size_t s = 2; s < steps.size() - 1; s++)
+	{
+		const UserEvent &event = steps[s].event();
+
+		assert(UserEvent::MOUSE_MOVE_ABS == event.type());
+		assert(instant < event.instant_us());
+		assert((abs(event.xpos() - xpos) <= 10) && (abs(event.ypos() - ypos) <= 10));
+		assert(!((event.xpos() == xpos) && (event.ypos() == ypos)));
+
+		through = through || ((200 == event.xpos()) && (200 == event.ypos()));
+		xpos 	= event.xpos();
+		ypos 	= event.ypos();
+		instant = event.instant_us();
+	}
+
+	assert(through);
+
+	std::cerr << "PASS" << std::endl; 
+}
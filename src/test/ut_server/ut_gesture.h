@@ -0,0 +1,37 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   Unit tests the expansion of the text and mouse path gestures.
+*/
+
+#ifndef __UNIT_TEST_GESTURE_H__
+#define __UNIT_TEST_GESTURE_H__
+
+/* Run the entire test suite for the gestures.
+
+   #returns 0 if successfull, different than zero otherwise
+*/ 
+int ut_gesture(void);
+
+#endif
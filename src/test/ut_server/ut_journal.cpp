@@ -0,0 +1,285 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+*/
+
+#include "ut_journal.h"
+#include "isabelJournal.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+/*-------------------- Test Cases Declaration -------------------------- */
+/* Write the events and read them back.
+*/
+static void journal_write_read(void);
+
+/* Each key name is written only once.
+*/
+static void journal_dictionary(void);
+
+/* Read a file cut short while writing.
+*/
+static void journal_truncated(void);
+
+/* Keep the sampling jitter, and read the files of the first version.
+*/
+static void journal_jitter(void);
+
+/*-------------------- Test Cases Main -------------------------- */
+int ut_journal(void)
+{
+	std::cerr << "---------------------------" << std::endl; 
+	std::cerr << "File of recorded events    " << std::endl; 
+	std::cerr << "---------------------------" << std::endl; 
+
+	/* run all of the test cases */
+	journal_write_read();
+	journal_dictionary();
+	journal_truncated();
+	journal_jitter();
+
+	return 0; 
+}
+
+/*-------------------- Test Cases Implementation ---------------------- */
+
+#define JOURNAL_FILE 	"/tmp/ut_journal.rec"
+
+/* Build an event.
+*/
+static T_USER_EVENT journal_event(uint8_t type, uint32_t instant, int32_t xpos, int32_t ypos, uint32_t code, uint8_t press)
+{
+	T_USER_EVENT event = T_USER_EVENT();
+
+	event.type 	  = type;
+	event.instant = instant;
+	event.xpos 	  = xpos;
+	event.ypos 	  = ypos;
+	event.code 	  = code;
+	event.press   = press;
+
+	return event;
+}
+
+/* Return the size of a file, in bytes.
+*/
+static long journal_size(const char *path)
+{
+	FILE *file = fopen(path,"rb");
+	long size;
+
+	assert(NULL != file);
+	fseek(file,0,SEEK_END);
+	size = ftell(file);
+	fclose(file);
+
+	return size;
+}
+
+static void journal_write_read(void)
+{
+	std::cerr << " - writing and reading the events: "; 
+
+	isabelJournalWriter writer;
+	isabelJournalReader reader;
+	T_USER_EVENT 		event;
+
+	assert(writer.open(JOURNAL_FILE));
+
+	writer.write(journal_event(2,0,640,480,0,0),NULL);
+	writer.write(journal_event(1,10,-3,70000,0,0),NULL);
+	writer.write(journal_event(3,25,0,0,1,1),NULL);
+	writer.write(journal_event(0,30,0,0,0,1),"a");
+	writer.write(journal_event(0,4000000,0,0,0,0),"a");
+
+	assert(5 == writer.events());
+	assert(writer.close());
+
+	assert(reader.open(JOURNAL_FILE));
+
+	assert(reader.next(event));
+	assert((2 == event.type) && (0 == event.instant) && (640 == event.xpos) && (480 == event.ypos));
+
+	assert(reader.next(event));
+	assert((1 == event.type) && (10 == event.instant) && (-3 == event.xpos) && (70000 == event.ypos));
+
+	assert(reader.next(event));
+	assert((3 == event.type) && (25 == event.instant) && (1 == event.code) && (1 == event.press));
+
+	assert(reader.next(event));
+	assert((0 == event.type) && (30 == event.instant) && (1 == event.press));
+	assert("a" == reader.key(event.code));
+
+	assert(reader.next(event));
+	assert((0 == event.type) && (4000000 == event.instant) && (0 == event.press));
+	assert("a" == reader.key(event.code));
+
+	assert(!reader.next(event));
+
+	/* the events can be read again */
+	reader.rewind();
+	assert(reader.next(event));
+	assert(640 == event.xpos);
+
+	reader.close();
+	unlink(JOURNAL_FILE);
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void journal_dictionary(void)
+{
+	std::cerr << " - writing each key name once: "; 
+
+	isabelJournalWriter writer;
+	isabelJournalReader reader;
+	T_USER_EVENT 		event;
+	const char 			*names[] = {"Shift_L","Return","Shift_L","space","Return"};
+
+	assert(writer.open(JOURNAL_FILE));
+
+	for(unsigned int k = 0; k < 1000; k++)
+	{
+		writer.write(journal_event(0,10*k,0,0,0,k & 1),names[k % 5]);
+	}
+
+	assert(writer.close());
+
+	/* the header, then 3 bytes per event and the names of the 3 keys */
+	assert(9 + 3*1000 + 7 + 6 + 5 == journal_size(JOURNAL_FILE));
+
+	assert(reader.open(JOURNAL_FILE));
+
+	for(unsigned int k = 0; k < 1000; k++)
+	{
+		assert(reader.next(event));
+		assert(10*k == event.instant);
+		assert((k & 1) == event.press);
+		assert(names[k % 5] == reader.key(event.code));
+	}
+
+	assert(!reader.next(event));
+
+	reader.close();
+	unlink(JOURNAL_FILE);
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void journal_truncated(void)
+{
+	std::cerr << " - reading a file cut short: "; 
+
+	isabelJournalWriter writer;
+	isabelJournalReader reader;
+	T_USER_EVENT 		event;
+
+	assert(writer.open(JOURNAL_FILE));
+
+	writer.write(journal_event(1,5,1,1,0,0),NULL);
+	writer.write(journal_event(0,8,0,0,0,1),"BackSpace");
+
+	assert(writer.close());
+
+	/* drop the end of the key name */
+	assert(0 == truncate(JOURNAL_FILE,journal_size(JOURNAL_FILE) - 2));
+
+	assert(reader.open(JOURNAL_FILE));
+	assert(reader.next(event));
+	assert((1 == event.type) && (5 == event.instant));
+	assert(!reader.next(event));
+	reader.close();
+
+	/* neither a missing file, nor one of another kind, is read */
+	assert(!reader.open("/tmp/ut_journal.missing"));
+
+	FILE *other = fopen(JOURNAL_FILE,"wb");
+	fputs("not a file of events",other);
+	fclose(other);
+
+	assert(!reader.open(JOURNAL_FILE));
+	unlink(JOURNAL_FILE);
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void journal_jitter(void)
+{
+	std::cerr << " - keeping the jitter, reading the first version: "; 
+
+	isabelJournalWriter writer;
+	isabelJournalReader reader;
+	T_USER_EVENT 		event = journal_event(1,10123,4,0,0,0);
+
+	assert(writer.open(JOURNAL_FILE));
+
+	event.jitter = -70;
+	writer.write(event,NULL);
+
+	event.instant = 35000;
+	event.jitter  = 15000;
+	writer.write(event,NULL);
+
+	assert(writer.close());
+
+	assert(reader.open(JOURNAL_FILE));
+	assert(reader.next(event));
+	assert((10123 == event.instant) && (-70 == event.jitter) && (4 == event.xpos));
+	assert(reader.next(event));
+	assert((35000 == event.instant) && (15000 == event.jitter));
+	assert(!reader.next(event));
+	reader.close();
+
+	/* the first version has the time in milliseconds, and no jitter */
+	const uint8_t first[] = {'I','S','A','B','E','L','E','V',1, 0x01,10,4,1, 0x03,5,2};
+
+	FILE *old = fopen(JOURNAL_FILE,"wb");
+	fwrite(first,1,sizeof(first),old);
+	fclose(old);
+
+	assert(reader.open(JOURNAL_FILE));
+	assert(reader.next(event));
+	assert((1 == event.type) && (10000 == event.instant) && (2 == event.xpos) && (-1 == event.ypos) && (0 == event.jitter));
+	assert(reader.next(event));
+	assert((3 == event.type) && (15000 == event.instant) && (2 == event.code));
+	assert(!reader.next(event));
+	reader.close();
+
+	/* nor a file of a later version */
+	old = fopen(JOURNAL_FILE,"r+b");
+	fseek(old,8,SEEK_SET);
+	fputc(JOURNAL_VERSION + 1,old);
+	fclose(old);
+
+	assert(!reader.open(JOURNAL_FILE));
+	unlink(JOURNAL_FILE);
+
+	std::cerr << "PASS" << std::endl; 
+}
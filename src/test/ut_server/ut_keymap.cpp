@@ -0,0 +1,274 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+*/
+
+#include "ut_keymap.h"
+#include "isabelKeymap.h"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+extern "C"
+{
+	#include <X11/Xlib.h>
+	#include <X11/keysym.h>
+}
+
+/*-------------------- Test Cases Declaration -------------------------- */
+/* Name the key codes, with and without modifiers.
+*/
+static void keymap_keysyms(void);
+
+/* Find the key code, and modifiers, of the key names.
+*/
+static void keymap_find(void);
+
+/* Replace the tables when the mapping changes.
+*/
+static void keymap_rebuild(void);
+
+/* Find the keys that set the modifiers.
+*/
+static void keymap_modifiers(void);
+
+/* Reach the levels of the ISO_Level3_Shift (AltGr) modifier.
+*/
+static void keymap_level3(void);
+
+/*-------------------- Test Cases Main -------------------------- */
+int ut_keymap(void)
+{
+	std::cerr << "---------------------------" << std::endl; 
+	std::cerr << "Keyboard mapping tables    " << std::endl; 
+	std::cerr << "---------------------------" << std::endl; 
+
+	/* run all of the test cases */
+	keymap_keysyms();
+	keymap_find();
+	keymap_rebuild();
+	keymap_modifiers();
+	keymap_level3();
+
+	return 0; 
+}
+
+/*-------------------- Test Cases Implementation ---------------------- */
+
+#define KEYMAP_MODE_SWITCH (Mod5Mask)	/* the modifier of the Mode_switch key in the tests */
+
+/* A small keyboard: a letter, a digit, a letter on its own, Return, Mode_switch,
+   Shift and a key without symbols.
+*/
+static const unsigned long keymap_mapping[] = {
+	XK_a, 		 XK_A, 		   XK_ae, 	 XK_AE,
+	XK_1, 		 XK_exclam,    NoSymbol, NoSymbol,
+	XK_q, 		 NoSymbol, 	   NoSymbol, NoSymbol,
+	XK_Return, 	 NoSymbol, 	   NoSymbol, NoSymbol,
+	XK_Mode_switch, NoSymbol,  NoSymbol, NoSymbol,
+	XK_Shift_L,  NoSymbol, 	   NoSymbol, NoSymbol,
+	NoSymbol, 	 NoSymbol, 	   NoSymbol, NoSymbol,
+};
+
+/* The modifier map, two key codes for each modifier: Shift, then Mode_switch on Mod5.
+*/
+static const uint8_t keymap_modmap[] = {
+	15, 0,  0, 0,  0, 0,  0, 0,  0, 0,  0, 0,  0, 0,  14, 0,
+};
+
+/* The same, without Mode_switch.
+*/
+static const uint8_t keymap_shift_only[] = {
+	15, 0,  0, 0,  0, 0,  0, 0,  0, 0,  0, 0,  0, 0,  0, 0,
+};
+
+static void keymap_keysyms(void)
+{
+	std::cerr << " - naming the key codes: "; 
+
+	isabelKeymap keymap;
+
+	keymap.build(10,16,4,keymap_mapping,2,keymap_modmap);
+
+	assert(XK_a 	 == keymap.keysym(10,0));
+	assert(XK_A 	 == keymap.keysym(10,ShiftMask));
+	assert(XK_ae 	 == keymap.keysym(10,KEYMAP_MODE_SWITCH));
+	assert(XK_AE 	 == keymap.keysym(10,ShiftMask | KEYMAP_MODE_SWITCH));
+	assert(XK_exclam == keymap.keysym(11,ShiftMask | KEYMAP_MODE_SWITCH));
+	assert(XK_1 	 == keymap.keysym(11,KEYMAP_MODE_SWITCH));
+
+	/* a letter on its own is in upper case with Shift */
+	assert(XK_q == keymap.keysym(12,0));
+	assert(XK_Q == keymap.keysym(12,ShiftMask));
+
+	/* the keys not in the mapping, or without symbols */
+	assert(XK_Return == keymap.keysym(13,ShiftMask | ControlMask));
+	assert(NoSymbol  == keymap.keysym(16,0));
+	assert(NoSymbol  == keymap.keysym(9,0));
+	assert(NoSymbol  == keymap.keysym(17,0));
+	assert(NoSymbol  == keymap.keysym(-1,0));
+
+	assert(0 == strcmp("exclam",keymap.name(XK_exclam)));
+	assert(0 == strcmp("Q",keymap.name(XK_Q)));
+	assert(NULL == keymap.name(XK_z));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void keymap_find(void)
+{
+	std::cerr << " - finding the key codes: "; 
+
+	isabelKeymap keymap;
+	T_KEY_CODE   code;
+
+	keymap.build(10,16,4,keymap_mapping,2,keymap_modmap);
+
+	assert(keymap.find("a",code) && (10 == code.keycode) && (0 == code.modifiers));
+	assert(keymap.find("A",code) && (10 == code.keycode) && (ShiftMask == code.modifiers));
+	assert(keymap.find("ae",code) && (10 == code.keycode) && (KEYMAP_MODE_SWITCH == code.modifiers));
+	assert(keymap.find("AE",code) && (10 == code.keycode) && ((ShiftMask | KEYMAP_MODE_SWITCH) == code.modifiers));
+	assert(keymap.find("exclam",code) && (11 == code.keycode) && (ShiftMask == code.modifiers));
+	assert(keymap.find("Q",code) && (12 == code.keycode) && (ShiftMask == code.modifiers));
+	assert(keymap.find("Return",code) && (13 == code.keycode) && (0 == code.modifiers));
+
+	assert(!keymap.find("z",code));
+	assert(!keymap.find("",code));
+
+	/* the key symbol typing each character */
+	assert(0 == strcmp("exclam",keymap.character('!')));
+	assert(0 == strcmp("ae",keymap.character(0xE6)));
+	assert(NULL == keymap.character('z'));
+
+	/* without the Mode_switch modifier, its levels cannot be reached */
+	keymap.build(10,16,4,keymap_mapping,2,keymap_shift_only);
+
+	assert(!keymap.find("ae",code));
+	assert(XK_A == keymap.keysym(10,ShiftMask | KEYMAP_MODE_SWITCH));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void keymap_rebuild(void)
+{
+	std::cerr << " - rebuilding the tables: "; 
+
+	isabelKeymap  keymap;
+	T_KEY_CODE 	  code;
+	unsigned long remapped[] = { XK_z, XK_Z };
+
+	keymap.build(10,16,4,keymap_mapping,2,keymap_modmap);
+	keymap.build(20,20,2,remapped,0,NULL);
+
+	assert(keymap.find("Z",code) && (20 == code.keycode) && (ShiftMask == code.modifiers));
+	assert(!keymap.find("a",code));
+	assert(NoSymbol == keymap.keysym(10,0));
+	assert(XK_z == keymap.keysym(20,0));
+
+	/* the events recorded before the change are still named */
+	assert(0 == strcmp("a",keymap.name(XK_a)));
+
+	/* an empty mapping */
+	keymap.build(8,7,0,NULL,0,NULL);
+
+	assert(NoSymbol == keymap.keysym(8,0));
+	assert(!keymap.find("z",code));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void keymap_modifiers(void)
+{
+	std::cerr << " - finding the modifier keys: "; 
+
+	isabelKeymap keymap;
+
+	keymap.build(10,16,4,keymap_mapping,2,keymap_modmap);
+
+	assert(ShiftMask == keymap.modifiers(15));
+	assert(KEYMAP_MODE_SWITCH == keymap.modifiers(14));
+	assert(0 == keymap.modifiers(10));
+
+	assert(15 == keymap.modifier_key(ShiftMask));
+	assert(14 == keymap.modifier_key(KEYMAP_MODE_SWITCH));
+	assert(0 == keymap.modifier_key(ControlMask));
+	assert(0 == keymap.modifier_key(ShiftMask | KEYMAP_MODE_SWITCH));
+
+	/* the modifiers go away with the mapping */
+	keymap.build(8,7,0,NULL,0,NULL);
+
+	assert(0 == keymap.modifiers(15));
+	assert(0 == keymap.modifier_key(ShiftMask));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+/* A keyboard with the six columns of the core mapping, as with a German layout:
+   q with the at sign on AltGr, 2 with the superscript two on AltGr and AltGr
+   on Mod5, the second group repeats the first.
+*/
+static const unsigned long keymap_level3_mapping[] = {
+	XK_q, 		 XK_Q, 		  XK_q, 	   XK_Q, 		  XK_at, 		  NoSymbol,
+	XK_2, 		 XK_quotedbl, XK_2, 	   XK_quotedbl,   XK_twosuperior, XK_onehalf,
+	XK_ISO_Level3_Shift, NoSymbol, XK_ISO_Level3_Shift, NoSymbol, NoSymbol, NoSymbol,
+	XK_Shift_L,  NoSymbol, 	  XK_Shift_L,  NoSymbol, 	  NoSymbol, 	  NoSymbol,
+};
+
+/* The modifier map, one key code for each modifier: Shift, then AltGr on Mod5.
+*/
+static const uint8_t keymap_level3_modmap[] = {
+	13, 0, 0, 0, 0, 0, 0, 12,
+};
+
+static void keymap_level3(void)
+{
+	std::cerr << " - reaching the AltGr levels: "; 
+
+	isabelKeymap keymap;
+	T_KEY_CODE   code;
+
+	keymap.build(10,13,6,keymap_level3_mapping,1,keymap_level3_modmap);
+
+	assert(keymap.find("at",code) && (10 == code.keycode) && (Mod5Mask == code.modifiers));
+	assert(keymap.find("onehalf",code) && (11 == code.keycode) && ((ShiftMask | Mod5Mask) == code.modifiers));
+	assert(keymap.find("twosuperior",code) && (11 == code.keycode) && (Mod5Mask == code.modifiers));
+	assert(keymap.find("Q",code) && (10 == code.keycode) && (ShiftMask == code.modifiers));
+
+	assert(XK_at 		  == keymap.keysym(10,Mod5Mask));
+	assert(XK_Q 		  == keymap.keysym(10,ShiftMask | Mod5Mask));
+	assert(XK_onehalf 	  == keymap.keysym(11,ShiftMask | Mod5Mask));
+	assert(XK_twosuperior == keymap.keysym(11,Mod5Mask));
+	assert(XK_quotedbl 	  == keymap.keysym(11,ShiftMask));
+	assert(0 == strcmp("at",keymap.character('@')));
+
+	/* without the AltGr modifier, its levels cannot be reached */
+	keymap.build(10,13,6,keymap_level3_mapping,1,keymap_shift_only);
+
+	assert(!keymap.find("at",code));
+	assert(XK_q == keymap.keysym(10,Mod5Mask));
+
+	std::cerr << "PASS" << std::endl; 
+}
@@ -0,0 +1,294 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+*/
+
+#include "ut_path.h"
+#include "isabelPath.h"
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+/*-------------------- Test Cases Declaration -------------------------- */
+/* Reduce a straight path to a single move.
+*/
+static void path_straight(void);
+
+/* Keep the corners of a path, and the clicks along it.
+*/
+static void path_corners(void);
+
+/* Keep the simplified path within the tolerance.
+*/
+static void path_tolerance(void);
+
+/* Keep the path open from one chunk of events to the next.
+*/
+static void path_chunks(void);
+
+/*-------------------- Test Cases Main -------------------------- */
+int ut_path(void)
+{
+	std::cerr << "---------------------------" << std::endl; 
+	std::cerr << "Mouse path simplification  " << std::endl; 
+	std::cerr << "---------------------------" << std::endl; 
+
+	/* run all of the test cases */
+	path_straight();
+	path_corners();
+	path_tolerance();
+	path_chunks();
+
+	return 0; 
+}
+
+/*-------------------- Test Cases Implementation ---------------------- */
+
+/* Build a relative mouse move, at an instant in milliseconds.
+*/
+static T_USER_EVENT path_move(uint32_t instant, int32_t dx, int32_t dy)
+{
+	T_USER_EVENT event = T_USER_EVENT();
+
+	event.type 	  = 1;
+	event.instant = 1000*(uint64_t)instant;
+	event.xpos 	  = dx;
+	event.ypos 	  = dy;
+
+	return event;
+}
+
+/* Build a mouse button event, at an instant in milliseconds.
+*/
+static T_USER_EVENT path_click(uint32_t instant, uint8_t press)
+{
+	T_USER_EVENT event = T_USER_EVENT();
+
+	event.type 	  = 3;
+	event.instant = 1000*(uint64_t)instant;
+	event.code 	  = 1;
+	event.press   = press;
+
+	return event;
+}
+
+static void path_straight(void)
+{
+	std::cerr << " - reducing a straight path: "; 
+
+	std::vector<T_USER_EVENT> events;
+
+	for(uint32_t i = 0; i < 500; i++)
+	{
+		events.push_back(path_move(10*i,2,1));
+	}
+
+	assert(499 == path_simplify(events,1.0));
+	assert(1 == events.size());
+
+	/* the mouse ends where it was recorded, at the time it was recorded */
+	assert((1000 == events[0].xpos) && (500 == events[0].ypos));
+	assert(4990000 == events[0].instant);
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void path_corners(void)
+{
+	std::cerr << " - keeping the corners and the clicks: "; 
+
+	std::vector<T_USER_EVENT> events;
+	uint32_t 				  instant = 0;
+
+	/* right, down, click, then drag to the left */
+	for(int i = 0; i < 50; i++, instant += 10) events.push_back(path_move(instant,3,0));
+	for(int i = 0; i < 50; i++, instant += 10) events.push_back(path_move(instant,0,3));
+	events.push_back(path_click(instant,1));
+	for(int i = 0; i < 50; i++, instant += 10) events.push_back(path_move(instant,-2,0));
+	events.push_back(path_click(instant,0));
+
+	path_simplify(events,2.0);
+
+	assert(5 == events.size());
+
+	assert((1 == events[0].type) && (150 == events[0].xpos) && (0 == events[0].ypos) && (490000 == events[0].instant));
+	assert((1 == events[1].type) && (0 == events[1].xpos) && (150 == events[1].ypos) && (990000 == events[1].instant));
+	assert((3 == events[2].type) && (1 == events[2].press));
+	assert((1 == events[3].type) && (-100 == events[3].xpos) && (0 == events[3].ypos));
+	assert((3 == events[4].type) && (0 == events[4].press));
+
+	/* a pause of the mouse splits the path, so the hovering is replayed */
+	events.clear();
+	events.push_back(path_move(0,5,0));
+	events.push_back(path_move(10,5,0));
+	events.push_back(path_move(10 + PATH_PAUSE_TIME,5,0));
+	events.push_back(path_move(20 + PATH_PAUSE_TIME,5,0));
+
+	path_simplify(events,2.0);
+
+	assert(2 == events.size());
+	assert((10 == events[0].xpos) && (10000 == events[0].instant));
+	assert((10 == events[1].xpos) && (1000*(20 + PATH_PAUSE_TIME) == events[1].instant));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void path_tolerance(void)
+{
+	std::cerr << " - staying within the tolerance: "; 
+
+	std::vector<T_USER_EVENT> events;
+	std::vector<double> 	  xs;
+	std::vector<double> 	  ys;
+	int 					  x = 0;
+	int 					  y = 0;
+
+	/* a circle, as the mouse would record it */
+	for(int i = 1; i <= 720; i++)
+	{
+		int nx = (int)lround(200*cos(i*M_PI/360.0)) - 200;
+		int ny = (int)lround(200*sin(i*M_PI/360.0));
+
+		events.push_back(path_move(5*i,nx - x,ny - y));
+		x = nx;
+		y = ny;
+
+		xs.push_back(x);
+		ys.push_back(y);
+	}
+
+	path_simplify(events,1.5);
+
+	assert(10 < events.size());
+	assert(100 > events.size());
+
+	/* every recorded point is close to one of the simplified segments */
+	std::vector<double> px(1,0);
+	std::vector<double> py(1,0);
+
+	for(size_t e = 0; e < events.size(); e++)
+	{
+		px.push_back(px.back() + events[e].xpos);
+		py.push_back(py.back() + events[e].ypos);
+	}
+
+	assert((0 == px.back()) && (0 == py.back()));
+
+	for(size_t p = 0; p < xs.size(); p++)
+	{
+		double best = 1e9;
+
+		for(size_t s = 1; s < px.size(); s++)
+		{
+			double dx = px[s] - px[s - 1];
+			double dy = py[s] - py[s - 1];
+			double l  = dx*dx + dy*dy;
+			double t  = (0 < l) ? ((xs[p] - px[s - 1])*dx + (ys[p] - py[s - 1])*dy)/l : 0;
+
+			t = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+
+			double ex = xs[p] - (px[s - 1] + t*dx);
+			double ey = ys[p] - (py[s - 1] + t*dy);
+
+			best = std::min(best,sqrt(ex*ex + ey*ey));
+		}
+
+		assert(1.5 >= best);
+	}
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void path_chunks(void)
+{
+	std::cerr << " - keeping the path open between chunks: "; 
+
+	std::vector<T_USER_EVENT> events;
+	std::vector<T_USER_EVENT> open;
+	std::vector<T_USER_EVENT> sent;
+	unsigned int 			  removed = 0;
+
+	/* a straight drag, drained every 100 milliseconds */
+	for(uint32_t chunk = 0; chunk < 10; chunk++)
+	{
+		events.clear();
+
+		for(uint32_t i = 0; i < 10; i++)
+		{
+			events.push_back(path_move(100*chunk + 10*i,2,1));
+		}
+
+		removed += path_simplify_chunk(events,open,1.0,false);
+		sent.insert(sent.end(),events.begin(),events.end());
+	}
+
+	/* nothing is sent while the path goes on */
+	assert(sent.empty());
+	assert(100 == open.size());
+
+	/* the click ends the path */
+	events.assign(1,path_click(1000,1));
+	removed += path_simplify_chunk(events,open,1.0,false);
+
+	assert(open.empty());
+	assert(99 == removed);
+	assert(2 == events.size());
+	assert((200 == events[0].xpos) && (100 == events[0].ypos) && (990000 == events[0].instant));
+	assert(3 == events[1].type);
+
+	/* a pause inside the chunk ends the path before it, the moves after it stay open */
+	events.clear();
+	events.push_back(path_move(2000,5,0));
+	events.push_back(path_move(2010,5,0));
+	events.push_back(path_move(2010 + PATH_PAUSE_TIME,5,0));
+	events.push_back(path_move(2020 + PATH_PAUSE_TIME,5,0));
+
+	path_simplify_chunk(events,open,2.0,false);
+
+	assert(1 == events.size());
+	assert((10 == events[0].xpos) && (2010000 == events[0].instant));
+	assert(2 == open.size());
+
+	/* a pause between the chunks also ends it */
+	events.assign(1,path_move(2020 + 2*PATH_PAUSE_TIME,5,0));
+
+	path_simplify_chunk(events,open,2.0,false);
+
+	assert(1 == events.size());
+	assert((10 == events[0].xpos) && (1000*(2020 + PATH_PAUSE_TIME) == events[0].instant));
+	assert(1 == open.size());
+
+	/* and so does the end of the recording */
+	events.clear();
+
+	path_simplify_chunk(events,open,2.0,true);
+
+	assert(open.empty());
+	assert(1 == events.size());
+	assert(5 == events[0].xpos);
+
+	std::cerr << "PASS" << std::endl; 
+}
@@ -0,0 +1,610 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+*/
+
+#include "ut_pixels.h"
+#include "isabelPixels.h"
+
+#include <cassert>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+/*-------------------- Test Cases Declaration -------------------------- */
+/* Hash the same pixels, stored with different strides.
+*/
+static void pixels_hash_stride(void);
+
+/* Verify that changing a single bit changes the hash.
+*/
+static void pixels_hash_single_bit(void);
+
+/* Find the tiles that changed between two images.
+*/
+static void pixels_tiles_changed(void);
+
+/* Compute the sum of the absolute differences, ignoring the alpha channel.
+*/
+static void pixels_sad_alpha(void);
+
+/* Find a needle copied from the haystack.
+*/
+static void pixels_find_needle(void);
+
+/* Compare two images, with a tolerance and ignored pixels.
+*/
+static void pixels_compare_images(void);
+
+/* Compute the perceptual hashes of similar, and different, images.
+*/
+static void pixels_perceptual_hashes(void);
+
+/* Encode images with QOI, and decode them back.
+*/
+static void pixels_qoi_roundtrip(void);
+
+/* Verify that the SSE and the plain C implementations give the same results.
+*/
+static void pixels_simd_scalar(void);
+
+/*-------------------- Test Cases Main -------------------------- */
+int ut_pixels(void)
+{
+	std::cerr << "---------------------------" << std::endl; 
+	std::cerr << "Screenshot pixels          " << std::endl; 
+	std::cerr << "---------------------------" << std::endl; 
+
+	srand(time(NULL));
+
+	/* run all of the test cases */
+	pixels_hash_stride();
+	pixels_hash_single_bit();
+	pixels_tiles_changed();
+	pixels_sad_alpha();
+	pixels_find_needle();
+	pixels_compare_images();
+	pixels_perceptual_hashes();
+	pixels_qoi_roundtrip();
+	pixels_simd_scalar();
+
+	return 0; 
+}
+
+/*-------------------- Test Cases Implementation ---------------------- */
+
+static void pixels_hash_stride(void)
+{
+	std::cerr << " - hashing pixels with different strides: "; 
+
+	int width  = 37;
+	int height = 23;
+
+	std::vector<uint32_t> packed(width*height);
+	std::vector<uint32_t> padded((width + 3)*height,0xDEADBEEF);
+
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			packed[y*width + x] 	  = rand();
+			padded[y*(width + 3) + x] = packed[y*width + x];
+		}
+	}
+
+	uint64_t hash_packed = pixels_hash((const uint8_t *)&packed[0],width*4,width,height);
+	uint64_t hash_padded = pixels_hash((const uint8_t *)&padded[0],(width + 3)*4,width,height);
+
+	assert(hash_packed == hash_padded);
+
+	/* same pixels, different shape */
+	assert(hash_packed != pixels_hash((const uint8_t *)&packed[0],height*4,height,width));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void pixels_hash_single_bit(void)
+{
+	std::cerr << " - hashing pixels that differ in a single bit: "; 
+
+	int width  = 64;
+	int height = 64;
+
+	std::vector<uint32_t> pixels(width*height,0xFF808080);
+
+	uint64_t hash = pixels_hash((const uint8_t *)&pixels[0],width*4,width,height);
+
+	for(int p = 0; p < width*height; p += 97)
+	{
+		for(int bit = 0; bit < 32; bit += 7)
+		{
+			pixels[p] ^= (1U << bit);
+			assert(hash != pixels_hash((const uint8_t *)&pixels[0],width*4,width,height));
+			pixels[p] ^= (1U << bit);
+		}
+	}
+
+	assert(hash == pixels_hash((const uint8_t *)&pixels[0],width*4,width,height));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void pixels_tiles_changed(void)
+{
+	std::cerr << " - finding the tiles that changed: "; 
+
+	int width  = 200;
+	int height = 130;
+	int tile   = 64;
+
+	std::vector<uint32_t> pixels(width*height);
+	std::vector<uint64_t> hashes;
+	std::vector<int> 	  changed;
+
+	for(int p = 0; p < width*height; p++)
+	{
+		pixels[p] = rand();
+	}
+
+	/* 4 columns and 3 rows, the last ones are smaller */
+	int columns = pixels_changed_tiles((const uint8_t *)&pixels[0],width*4,width,height,tile,hashes,changed);
+	assert(4 == columns);
+	assert(12 == changed.size());
+	assert(12 == hashes.size());
+
+	/* nothing changed */
+	pixels_changed_tiles((const uint8_t *)&pixels[0],width*4,width,height,tile,hashes,changed);
+	assert(changed.empty());
+
+	/* change a pixel in the last tile, and another in the second row */
+	pixels[(height - 1)*width + width - 1] ^= 1;
+	pixels[70*width + 10] ^= 1;
+
+	pixels_changed_tiles((const uint8_t *)&pixels[0],width*4,width,height,tile,hashes,changed);
+	assert(2 == changed.size());
+	assert(4 == changed[0]);
+	assert(11 == changed[1]);
+
+	/* a different number of tiles, everything changed */
+	pixels_changed_tiles((const uint8_t *)&pixels[0],width*4,width,height/3,tile,hashes,changed);
+	assert(4 == changed.size());
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void pixels_sad_alpha(void)
+{
+	std::cerr << " - summing the differences of the color channels: "; 
+
+	int width  = 13;
+	int height = 5;
+
+	std::vector<uint32_t> first(width*height,0xFF102030);
+	std::vector<uint32_t> second(width*height,0x00102030);
+
+	/* only the alpha differs */
+	assert(0 == pixels_sad((const uint8_t *)&first[0],width*4,(const uint8_t *)&second[0],width*4,width,height,PIXELS_NO_LIMIT));
+
+	/* each channel of the last pixel differs by 16, which is not handled by the SSE path */
+	second[width*height - 1] = 0x00203040;
+	assert(48 == pixels_sad((const uint8_t *)&first[0],width*4,(const uint8_t *)&second[0],width*4,width,height,PIXELS_NO_LIMIT));
+
+	/* every pixel differs by 1 in the blue channel, the sum stops after the row exceeding the limit */
+	second.assign(width*height,0xFF102031);
+	assert((uint64_t)(2*width) == pixels_sad((const uint8_t *)&first[0],width*4,(const uint8_t *)&second[0],width*4,width,height,width + 1));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void pixels_find_needle(void)
+{
+	std::cerr << " - finding a needle in a haystack: "; 
+
+	int width  = 320;
+	int height = 240;
+
+	std::vector<uint32_t> haystack(width*height);
+	std::vector<T_MATCH>  matches;
+
+	/* a smooth gradient, with some noise */
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			haystack[y*width + x] = 0xFF000000 | ((x*255/width) << 16) | ((y*255/height) << 8) | (rand() % 64);
+		}
+	}
+
+	int needle_sizes[][2] = { { 40, 30 }, { 9, 7 } };
+
+	for(unsigned int n = 0; n < sizeof(needle_sizes)/sizeof(needle_sizes[0]); n++)
+	{
+		int needle_width  = needle_sizes[n][0];
+		int needle_height = needle_sizes[n][1];
+		int x 			  = rand() % (width - needle_width);
+		int y 			  = rand() % (height - needle_height);
+
+		const uint8_t *needle = (const uint8_t *)&haystack[y*width + x];
+
+		pixels_find((const uint8_t *)&haystack[0],width*4,width,height,needle,width*4,needle_width,needle_height,3,matches);
+
+		assert(3 == matches.size());
+		assert(x == matches[0].x);
+		assert(y == matches[0].y);
+		assert(0 == matches[0].sad);
+		assert(matches[0].sad <= matches[1].sad);
+		assert(matches[1].sad <= matches[2].sad);
+	}
+
+	/* the needle does not fit in the haystack */
+	pixels_find((const uint8_t *)&haystack[0],width*4,width,height,(const uint8_t *)&haystack[0],width*4,width + 1,1,1,matches);
+	assert(matches.empty());
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void pixels_compare_images(void)
+{
+	std::cerr << " - comparing two images: "; 
+
+	int width  = 21;
+	int height = 9;
+
+	std::vector<uint32_t> first(width*height);
+	std::vector<uint8_t>  ignore(width*height,0);
+	std::vector<uint8_t>  mismatches(width*height);
+	T_DIFFERENCE 		  difference;
+
+	for(int p = 0; p < width*height; p++)
+	{
+		first[p] = rand();
+	}
+
+	std::vector<uint32_t> second(first);
+
+	/* equal images, even with different alpha */
+	second[0] ^= 0xFF000000;
+
+	pixels_compare((const uint8_t *)&first[0],width*4,(const uint8_t *)&second[0],width*4,width,height,0,NULL,difference,&mismatches[0]);
+	assert(0 == difference.count);
+	assert(std::vector<uint8_t>(width*height,0) == mismatches);
+
+	/* small differences, one in a SSE block and one in the remainder of the row */
+	second[2*width + 5] 		  ^= 0x00000300;
+	second[6*width + width - 1] ^= 0x00030000;
+
+	pixels_compare((const uint8_t *)&first[0],width*4,(const uint8_t *)&second[0],width*4,width,height,0,NULL,difference,&mismatches[0]);
+	assert(2 == difference.count);
+	assert((5 == difference.left) && (2 == difference.top));
+	assert((width - 1 == difference.right) && (6 == difference.bottom));
+	assert(mismatches[2*width + 5] && mismatches[6*width + width - 1]);
+
+	/* within the tolerance */
+	pixels_compare((const uint8_t *)&first[0],width*4,(const uint8_t *)&second[0],width*4,width,height,3,NULL,difference,NULL);
+	assert(0 == difference.count);
+
+	/* one of them is ignored */
+	ignore[2*width + 5] = 1;
+
+	pixels_compare((const uint8_t *)&first[0],width*4,(const uint8_t *)&second[0],width*4,width,height,0,&ignore[0],difference,NULL);
+	assert(1 == difference.count);
+	assert((width - 1 == difference.left) && (6 == difference.top));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void pixels_perceptual_hashes(void)
+{
+	std::cerr << " - perceptual hashes of similar images: "; 
+
+	int width  = 131;
+	int height = 67;
+
+	std::vector<uint32_t> gradient(width*height);
+	std::vector<uint32_t> reversed(width*height);
+	std::vector<uint32_t> cells;
+
+	/* gray levels increasing from left to right, with some noise */
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			uint32_t level = (x*250)/width + (rand() % 3);
+
+			gradient[y*width + x] 			= 0xFF000000 | (level << 16) | (level << 8) | level;
+			reversed[y*width + width - 1 - x] = gradient[y*width + x];
+		}
+	}
+
+	pixels_gray_cells((const uint8_t *)&gradient[0],width*4,width,height,9,8,cells);
+	assert(72 == cells.size());
+	assert((cells[0] < cells[8]) && (cells[63] < cells[71]));
+
+	/* every cell is brighter than the one to its left */
+	assert(~(uint64_t)0 == pixels_dhash((const uint8_t *)&gradient[0],width*4,width,height));
+	assert(0 == pixels_dhash((const uint8_t *)&reversed[0],width*4,width,height));
+
+	/* the alpha channel, and a few pixels, do not change the difference hash */
+	std::vector<uint32_t> similar(gradient);
+
+	for(int p = 0; p < width*height; p += 97)
+	{
+		similar[p] ^= 0xFF000001;
+	}
+
+	assert(~(uint64_t)0 == pixels_dhash((const uint8_t *)&similar[0],width*4,width,height));
+
+	/* the perceptual hash of similar images differs in a few bits, at most */
+	std::vector<uint32_t> blocks(width*height);
+
+	for(int b = 0; b < 64; b++)
+	{
+		uint32_t level = rand() % 256;
+
+		for(int y = (b / 8)*height/8; y < (b / 8 + 1)*height/8; y++)
+		{
+			for(int x = (b % 8)*width/8; x < (b % 8 + 1)*width/8; x++)
+			{
+				blocks[y*width + x] = 0xFF000000 | (level << 16) | (level << 8) | level;
+			}
+		}
+	}
+
+	similar = blocks;
+
+	for(int p = 0; p < width*height; p += 97)
+	{
+		similar[p] ^= 0xFF000001;
+	}
+
+	uint64_t phash 	 = pixels_phash((const uint8_t *)&blocks[0],width*4,width,height);
+	uint64_t nearby  = pixels_phash((const uint8_t *)&similar[0],width*4,width,height);
+	uint64_t distant = pixels_phash((const uint8_t *)&reversed[0],width*4,width,height);
+
+	assert(4 >= __builtin_popcountll(phash ^ nearby));
+	assert(16 <= __builtin_popcountll(phash ^ distant));
+
+	/* images smaller than the grayscale image are stretched */
+	uint32_t pixel = 0xFF808080;
+
+	pixels_gray_cells((const uint8_t *)&pixel,4,1,1,32,32,cells);
+	assert(std::vector<uint32_t>(32*32,0x80) == cells);
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+/* Decode a QOI image, as the reference decoder does.
+*/
+static void pixels_qoi_decode(const std::vector<uint8_t> &data, int &width, int &height, std::vector<uint32_t> &pixels)
+{
+	uint32_t index[64];
+	uint32_t pixel = 0xFF000000;
+	size_t 	 p 	   = 14;
+	int 	 run   = 0;
+
+	assert(0 == memcmp(&data[0],"qoif",4));
+
+	width  = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+	height = (data[8] << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
+
+	memset(index,0x00,sizeof(index));
+	pixels.resize(width*height);
+
+	for(int i = 0; i < width*height; i++)
+	{
+		if(0 < run)
+		{
+			run--;
+		}
+		else
+		{
+			uint8_t op = data[p++];
+			int 	r  = (pixel >> 16) & 0xFF;
+			int 	g  = (pixel >> 8) & 0xFF;
+			int 	b  = pixel & 0xFF;
+			int 	a  = pixel >> 24;
+
+			if(0xFE == op)
+			{
+				r = data[p++];
+				g = data[p++];
+				b = data[p++];
+			}
+			else if(0xFF == op)
+			{
+				r = data[p++];
+				g = data[p++];
+				b = data[p++];
+				a = data[p++];
+			}
+			else if(0x00 == (op & 0xC0))
+			{
+				r = (index[op] >> 16) & 0xFF;
+				g = (index[op] >> 8) & 0xFF;
+				b = index[op] & 0xFF;
+				a = index[op] >> 24;
+			}
+			else if(0x40 == (op & 0xC0))
+			{
+				r += ((op >> 4) & 0x03) - 2;
+				g += ((op >> 2) & 0x03) - 2;
+				b += (op & 0x03) - 2;
+			}
+			else if(0x80 == (op & 0xC0))
+			{
+				int vg 	  = (op & 0x3F) - 32;
+				uint8_t d = data[p++];
+
+				r += vg - 8 + (d >> 4);
+				g += vg;
+				b += vg - 8 + (d & 0x0F);
+			}
+			else
+			{
+				run = op & 0x3F;
+			}
+
+			pixel = ((uint32_t)(a & 0xFF) << 24) | ((r & 0xFF) << 16) | ((g & 0xFF) << 8) | (b & 0xFF);
+			index[((pixel >> 16 & 0xFF)*3 + (pixel >> 8 & 0xFF)*5 + (pixel & 0xFF)*7 + (pixel >> 24)*11) % 64] = pixel;
+		}
+
+		pixels[i] = pixel;
+	}
+
+	/* the end marker follows the last pixel */
+	const uint8_t padding[] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+	assert(data.size() == p + sizeof(padding));
+	assert(0 == memcmp(&data[p],padding,sizeof(padding)));
+}
+
+static void pixels_qoi_roundtrip(void)
+{
+	std::cerr << " - encoding with QOI: "; 
+
+	/* black, black, brown: the run of the initial pixel, then the whole color */
+	const uint32_t line[] = { 0xFF000000, 0xFF000000, 0xFF804020 };
+	const uint8_t  known[] = {
+		'q', 'o', 'i', 'f', 0, 0, 0, 3, 0, 0, 0, 1, 3, 0,
+		0xC1, 0xFE, 0x80, 0x40, 0x20,
+		0, 0, 0, 0, 0, 0, 0, 1
+	};
+
+	std::vector<uint8_t> data(pixels_qoi_size(3,1));
+
+	data.resize(pixels_qoi((const uint8_t *)line,3*4,3,1,true,&data[0]));
+	assert(std::vector<uint8_t>(known,known + sizeof(known)) == data);
+
+	/* every operation, on an odd sized image with padding between the rows */
+	int width  = 77;
+	int height = 41;
+	int stride = width + 3;
+
+	std::vector<uint32_t> image(stride*height,0xDEADBEEF);
+
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			uint32_t pixel;
+
+			switch((x / 7 + y) % 6)
+			{
+				case 0:  pixel = 0xFF102030; break;						// runs
+				case 1:  pixel = 0xFF102030 + ((x % 2) << 8); break; 	// small differences
+				case 2:  pixel = 0xFF102030 + (x << 9); break;			// luma differences
+				case 3:  pixel = 0xFF000000 | (rand() & 0xFFFFFF); break;
+				case 4:  pixel = (rand() % 2) ? 0xFF102030 : 0xFF405060; break; 	// index
+				default: pixel = rand(); break; 						// alpha
+			}
+
+			image[y*stride + x] = pixel;
+		}
+	}
+
+	std::vector<uint32_t> decoded;
+	int 				  w;
+	int 				  h;
+
+	for(int opaque = 0; opaque < 2; opaque++)
+	{
+		data.assign(pixels_qoi_size(width,height),0);
+		data.resize(pixels_qoi((const uint8_t *)&image[0],stride*4,width,height,opaque,&data[0]));
+
+		assert((4 - opaque) == data[12]);
+
+		pixels_qoi_decode(data,w,h,decoded);
+		assert((width == w) && (height == h));
+
+		for(int y = 0; y < height; y++)
+		{
+			for(int x = 0; x < width; x++)
+			{
+				uint32_t pixel = image[y*stride + x] | (opaque ? 0xFF000000 : 0);
+
+				assert(pixel == decoded[y*width + x]);
+			}
+		}
+	}
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void pixels_simd_scalar(void)
+{
+	std::cerr << " - same results with and without SSE: "; 
+
+	for(int width = 1; width < 40; width += 2)
+	{
+		int height = 5 + width % 7;
+		int stride = width + 1;
+
+		/* the rows start one pixel past a 16 bytes boundary, and are not aligned between them */
+		std::vector<uint32_t> first(stride*height + 1);
+		std::vector<uint32_t> second(stride*height + 1);
+
+		for(size_t p = 0; p < first.size(); p++)
+		{
+			first[p]  = rand();
+			second[p] = (rand() % 4) ? first[p] ^ (rand() % 8) : rand();
+		}
+
+		const uint8_t *a = (const uint8_t *)&first[1];
+		const uint8_t *b = (const uint8_t *)&second[1];
+
+		uint64_t 			  hash[2];
+		uint64_t 			  sad[2];
+		T_DIFFERENCE 		  difference[2];
+		std::vector<uint8_t>  mismatches[2];
+		std::vector<uint32_t> cells[2];
+
+		for(int s = 0; s < 2; s++)
+		{
+			pixels_use_simd(0 == s);
+
+			mismatches[s].assign(width*height,0xFF);
+
+			hash[s] = pixels_hash(a,stride*4,width,height);
+			sad[s] 	= pixels_sad(a,stride*4,b,stride*4,width,height,PIXELS_NO_LIMIT);
+
+			pixels_compare(a,stride*4,b,stride*4,width,height,3,NULL,difference[s],&mismatches[s][0]);
+			pixels_gray_cells(a,stride*4,width,height,9,8,cells[s]);
+		}
+
+		assert(hash[0] == hash[1]);
+		assert(sad[0] == sad[1]);
+		assert(difference[0].count == difference[1].count);
+		assert((difference[0].left == difference[1].left) && (difference[0].right == difference[1].right));
+		assert((difference[0].top == difference[1].top) && (difference[0].bottom == difference[1].bottom));
+		assert(mismatches[0] == mismatches[1]);
+		assert(cells[0] == cells[1]);
+	}
+
+	pixels_use_simd(true);
+
+	std::cerr << "PASS" << std::endl; 
+}
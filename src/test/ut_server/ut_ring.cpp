@@ -0,0 +1,189 @@
+/*
+   Isabel
+   =========
+   Copyright (C) 2016  Nelson Gonçalves
+
+   License
+   -------
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Summary
+   -------
+
+   See the respective header file for details.
+*/
+
+#include "ut_ring.h"
+#include "isabelRing.h"
+
+#include <cassert>
+#include <iostream>
+
+/*-------------------- Test Cases Declaration -------------------------- */
+/* Drain the events in the order they were pushed.
+*/
+static void ring_drain_order(void);
+
+/* Overwrite the oldest events once the ring is full.
+*/
+static void ring_overwrite(void);
+
+/* Keep recording after draining, across the end of the ring.
+*/
+static void ring_wrap_around(void);
+
+/*-------------------- Test Cases Main -------------------------- */
+int ut_ring(void)
+{
+	std::cerr << "---------------------------" << std::endl; 
+	std::cerr << "Ring of recorded events    " << std::endl; 
+	std::cerr << "---------------------------" << std::endl; 
+
+	/* run all of the test cases */
+	ring_drain_order();
+	ring_overwrite();
+	ring_wrap_around();
+
+	return 0; 
+}
+
+/*-------------------- Test Cases Implementation ---------------------- */
+
+/* Build an event, identified by its instant.
+*/
+static T_USER_EVENT ring_event(uint32_t instant)
+{
+	T_USER_EVENT event = T_USER_EVENT();
+
+	event.instant = instant;
+	event.code 	  = 2*instant;
+
+	return event;
+}
+
+static void ring_drain_order(void)
+{
+	std::cerr << " - draining the events in order: "; 
+
+	T_EVENT_RING 			  ring;
+	std::vector<T_USER_EVENT> events;
+	unsigned int 			  dropped = 1;
+
+	ring_init(ring,8);
+
+	/* an empty ring has nothing to drain */
+	assert(0 == ring_drain(ring,events,dropped));
+	assert(events.empty());
+	assert(0 == dropped);
+
+	for(uint32_t i = 0; i < 5; i++)
+	{
+		ring_push(ring,ring_event(i));
+	}
+
+	assert(5 == ring_drain(ring,events,dropped));
+	assert(5 == events.size());
+	assert(0 == dropped);
+
+	for(uint32_t i = 0; i < 5; i++)
+	{
+		assert(i == events[i].instant);
+		assert(2*i == events[i].code);
+	}
+
+	/* the drained events are gone */
+	events.clear();
+	assert(0 == ring_drain(ring,events,dropped));
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void ring_overwrite(void)
+{
+	std::cerr << " - overwriting the oldest events: "; 
+
+	T_EVENT_RING 			  ring;
+	std::vector<T_USER_EVENT> events;
+	unsigned int 			  dropped;
+
+	ring_init(ring,4);
+
+	for(uint32_t i = 0; i < 11; i++)
+	{
+		ring_push(ring,ring_event(i));
+	}
+
+	/* only the newest events are kept */
+	assert(4 == ring_drain(ring,events,dropped));
+	assert(7 == dropped);
+
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		assert(7 + i == events[i].instant);
+	}
+
+	/* the count of dropped events restarts after each drain */
+	events.clear();
+	ring_push(ring,ring_event(20));
+
+	assert(1 == ring_drain(ring,events,dropped));
+	assert(0 == dropped);
+	assert(20 == events[0].instant);
+
+	std::cerr << "PASS" << std::endl; 
+}
+
+static void ring_wrap_around(void)
+{
+	std::cerr << " - recording across the end of the ring: "; 
+
+	T_EVENT_RING 			  ring;
+	std::vector<T_USER_EVENT> events;
+	unsigned int 			  dropped;
+	uint32_t 				  next = 0;
+
+	ring_init(ring,5);
+
+	/* drain at several fill levels, so the events are split across the end of the ring */
+	for(unsigned int round = 0; round < 20; round++)
+	{
+		unsigned int pushed = 1 + (round*3) % 5;
+
+		for(unsigned int p = 0; p < pushed; p++)
+		{
+			ring_push(ring,ring_event(next + p));
+		}
+
+		events.clear();
+		assert(pushed == ring_drain(ring,events,dropped));
+		assert(0 == dropped);
+
+		for(unsigned int p = 0; p < pushed; p++)
+		{
+			assert(next + p == events[p].instant);
+		}
+
+		next += pushed;
+	}
+
+	/* a new capacity empties the ring */
+	ring_push(ring,ring_event(0));
+	ring_init(ring,2);
+
+	events.clear();
+	assert(0 == ring_drain(ring,events,dropped));
+
+	std::cerr << "PASS" << std::endl; 
+}
@@ -8,9 +8,39 @@ INCLUDEPATH += ../../qjson ../../server /usr/include/google/protobuf
 LIBS        += -L /usr/lib -lprotobuf -lcairo -lX11
 
 HEADERS  	= ../../server/isabelSLIP.h \
-			  ut_slip.h	
+			  ../../server/isabelCompress.h \
+			  ../../server/isabelPixels.h \
+			  ../../server/isabelRing.h \
+			  ../../server/isabelJournal.h \
+			  ../../server/isabelPath.h \
+			  ../../server/isabelKeymap.h \
+			  ../../server/isabelGesture.h \
+			  ../../server/protocol.pb.h \
+			  ut_slip.h	\
+			  ut_compress.h \
+			  ut_pixels.h \
+			  ut_ring.h \
+			  ut_journal.h \
+			  ut_path.h \
+			  ut_keymap.h \
+			  ut_gesture.h
 
 SOURCES  	= ../../server/isabelSLIP.cpp \
+			  ../../server/isabelCompress.cpp \
+			  ../../server/isabelPixels.cpp \
+			  ../../server/isabelRing.cpp \
+			  ../../server/isabelJournal.cpp \
+			  ../../server/isabelPath.cpp \
+			  ../../server/isabelKeymap.cpp \
+			  ../../server/isabelGesture.cpp \
+			  ../../server/protocol.pb.cc \
 			  ut_slip.cpp \
+			  ut_compress.cpp \
+			  ut_pixels.cpp \
+			  ut_ring.cpp \
+			  ut_journal.cpp \
+			  ut_path.cpp \
+			  ut_keymap.cpp \
+			  ut_gesture.cpp \
 			  main.cpp
 				
@@ -47,6 +47,10 @@ static void slip_encdec_special(void);
 */
 static void slip_encdec_arbitrary(void);
 
+/* Find the packets in a stream of received bytes.
+*/
+static void slip_packet_split(void);
+
 /*-------------------- Test Cases Main -------------------------- */
 int ut_slip(void)
 {
@@ -58,6 +62,7 @@ int ut_slip(void)
 	slip_encdec_void();
 	slip_encdec_special();
 	slip_encdec_arbitrary();
+	slip_packet_split();
 
 	return 0; 
 }
@@ -144,3 +149,25 @@ static void slip_encdec_arbitrary(void)
 
 	std::cerr << "PASS" << std::endl; 
 }
+
+static void slip_packet_split(void)
+{
+	std::cerr << " - splitting a stream of packets: "; 
+
+	QByteArray first  = slip_encode(QByteArray("isabel\xc0"));
+	QByteArray second = slip_encode(QByteArray(""));
+	QByteArray stream = first + second;
+
+	/* nothing, or only part of a packet, was received */
+	assert(0 == slip_packet_size(QByteArray()));
+	assert(0 == slip_packet_size(first.left(first.size() - 1)));
+
+	/* the packets are found one after the other */
+	assert(first.size() == slip_packet_size(stream));
+
+	stream.remove(0,first.size());
+	assert(second.size() == slip_packet_size(stream));
+	assert(slip_decode(stream.left(second.size())).isEmpty());
+
+	std::cerr << "PASS" << std::endl; 
+}